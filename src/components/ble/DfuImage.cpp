@@ -0,0 +1,262 @@
+#include "components/ble/DfuImage.h"
+#include <algorithm>
+#include <cstring>
+#include "components/kvstore/KeyValueStore.h"
+#include "components/utility/Crc16.h"
+#include "drivers/SpiNorFlash.h"
+#include <nrf_log.h>
+
+using namespace Pinetime::Controllers;
+
+namespace {
+  // Written at the end of the slot : the bootloader swaps the image only if it finds it
+  constexpr uint32_t magicNumber[4] = {0xf395c277, 0x7fefd260, 0x0f505235, 0x8079b62c};
+}
+
+constexpr size_t DfuImage::bufferSize;
+
+void DfuImage::Init(size_t totalSize, uint16_t expectedCrc, Encodings encoding) {
+  this->encoding = encoding;
+  this->totalSize = totalSize;
+  this->expectedCrc = expectedCrc;
+  this->totalWriteIndex = 0;
+  this->crc = 0xFFFF;
+  this->readBackIndex = 0;
+  this->readBackCrc = 0xFFFF;
+  this->decoder.Reset();
+  this->patchState = PatchStates::Header;
+  this->patchFieldSize = 0;
+  this->failed = false;
+  this->ready = true;
+}
+
+void DfuImage::Append(const uint8_t* data, size_t size) {
+  if (encoding == Encodings::Raw) {
+    Write(data, size);
+    return;
+  }
+
+  // The input may be consumed before the end of a back-reference : the decoder runs until it has nothing left to write
+  while (ready && !failed && totalWriteIndex < totalSize) {
+    uint8_t output[64];
+    size_t produced;
+    if (encoding == Encodings::Delta) {
+      const size_t consumed = decoder.Decode(data, size, output, sizeof(output), produced);
+      if (consumed == 0 && produced == 0) {
+        break;
+      }
+      data += consumed;
+      size -= consumed;
+      Patch(output, produced);
+      continue;
+    }
+
+    // The decoder starts again at the end of each sector, where the compressed data of the next one begins
+    const size_t sectorEnd = std::min(totalSize, (totalWriteIndex / checkpointInterval + 1) * checkpointInterval);
+    const size_t consumed = decoder.Decode(data, size, output, std::min(sizeof(output), sectorEnd - totalWriteIndex), produced);
+    if (consumed == 0 && produced == 0) {
+      break;
+    }
+    data += consumed;
+    size -= consumed;
+    Write(output, produced);
+    if (totalWriteIndex == sectorEnd) {
+      decoder.Reset();
+    }
+  }
+}
+
+void DfuImage::Patch(uint8_t* data, size_t size) {
+  // See tools/dfu-compress.py for the format of the patch
+  while (!failed && (size > 0 || patchState == PatchStates::Copy) && totalWriteIndex < totalSize) {
+    switch (patchState) {
+      case PatchStates::Header:
+      case PatchStates::Record: {
+        // The fields are gathered from the decompressed data, that can end anywhere
+        const size_t fieldSize = (patchState == PatchStates::Header) ? 6 : 16;
+        const size_t length = std::min(size, fieldSize - patchFieldSize);
+        std::memcpy(patchField + patchFieldSize, data, length);
+        patchFieldSize += length;
+        data += length;
+        size -= length;
+        if (patchFieldSize < fieldSize) {
+          break;
+        }
+        patchFieldSize = 0;
+
+        if (patchState == PatchStates::Header) {
+          uint16_t runningCrc;
+          std::memcpy(&runningSize, patchField, sizeof(uint32_t));
+          std::memcpy(&runningCrc, patchField + sizeof(uint32_t), sizeof(uint16_t));
+          failed = runningSize > maxSize || Pinetime::Utility::Crc16(0xFFFF, runningImage, runningSize) != runningCrc;
+          patchState = PatchStates::Record;
+        } else {
+          std::memcpy(&runningIndex, patchField, sizeof(uint32_t));
+          std::memcpy(&copyLength, patchField + 4, sizeof(uint32_t));
+          std::memcpy(&diffLength, patchField + 8, sizeof(uint32_t));
+          std::memcpy(&extraLength, patchField + 12, sizeof(uint32_t));
+          failed = runningIndex > runningSize || copyLength > runningSize - runningIndex ||
+                   diffLength > runningSize - runningIndex - copyLength;
+          patchState = PatchStates::Copy;
+        }
+      } break;
+      case PatchStates::Copy: {
+        // The copies are read from the internal flash memory, without input
+        const size_t length = std::min<size_t>(copyLength, bufferSize);
+        Write(runningImage + runningIndex, length);
+        runningIndex += length;
+        copyLength -= length;
+        if (copyLength == 0) {
+          patchState = PatchStates::Diff;
+        }
+      } break;
+      case PatchStates::Diff: {
+        const size_t length = std::min<size_t>(size, diffLength);
+        for (size_t i = 0; i < length; i++) {
+          data[i] += runningImage[runningIndex + i];
+        }
+        Write(data, length);
+        runningIndex += length;
+        diffLength -= length;
+        data += length;
+        size -= length;
+        if (diffLength == 0) {
+          patchState = PatchStates::Extra;
+        }
+      } break;
+      case PatchStates::Extra: {
+        const size_t length = std::min<size_t>(size, extraLength);
+        Write(data, length);
+        extraLength -= length;
+        data += length;
+        size -= length;
+        if (extraLength == 0) {
+          patchState = PatchStates::Record;
+        }
+      } break;
+    }
+  }
+}
+
+void DfuImage::Write(const uint8_t* data, size_t size) {
+  if (!ready || totalWriteIndex >= totalSize)
+    return;
+  // Bytes beyond the announced size of the image are dropped
+  size = std::min(size, totalSize - totalWriteIndex);
+
+  while (size > 0) {
+    // A packet is split at the checkpoints, so that the CRC of a checkpoint covers the data before it
+    const size_t length = std::min(size, checkpointInterval - (totalWriteIndex % checkpointInterval));
+    // The write-behind queue of the flash driver gathers the packets into pages, whatever their size
+    spiNorFlash.WriteBehind(writeOffset + totalWriteIndex, data, length);
+    crc = Pinetime::Utility::Crc16(crc, data, length);
+    totalWriteIndex += length;
+    data += length;
+    size -= length;
+    if (totalWriteIndex % checkpointInterval == 0 && totalWriteIndex < totalSize) {
+      WriteCheckpoint();
+    }
+  }
+
+  if (totalWriteIndex == totalSize) {
+    if (totalSize < maxSize)
+      WriteMagicNumber();
+    // Reports the pages that failed to be programmed since the previous checkpoint, the magic number included
+    if (!spiNorFlash.Sync()) {
+      failed = true;
+    }
+  }
+
+  // The pages before the one being gathered are programmed (or being programmed) : at most one of them is read back
+  // per write, which is enough to keep up with the transfer since a write is smaller than a page
+  const size_t programmed = (totalWriteIndex == totalSize) ? totalSize : (totalWriteIndex & ~(bufferSize - 1));
+  if (readBack && readBackIndex < programmed) {
+    ReadBack(std::min(bufferSize, programmed - readBackIndex));
+  }
+}
+
+void DfuImage::ReadBack(size_t size) {
+  spiNorFlash.Read(writeOffset + readBackIndex, tempBuffer, size);
+  readBackCrc = Pinetime::Utility::Crc16(readBackCrc, tempBuffer, size);
+  readBackIndex += size;
+}
+
+bool DfuImage::ReadCheckpoint(size_t totalSize, Checkpoint& checkpoint) const {
+  return keyValueStore.Read(KeyValueStore::Keys::DfuCheckpoint, &checkpoint, sizeof(Checkpoint)) == sizeof(Checkpoint) &&
+         checkpoint.totalSize == totalSize && checkpoint.offset > 0 && checkpoint.offset < totalSize;
+}
+
+void DfuImage::WriteCheckpoint() {
+  // The checkpoint must not cover data that is still in the write-behind queue
+  if (!spiNorFlash.Sync()) {
+    failed = true;
+    return;
+  }
+  while (readBack && readBackIndex < totalWriteIndex) {
+    ReadBack(std::min(bufferSize, totalWriteIndex - readBackIndex));
+  }
+  if (readBack && readBackCrc != crc)
+    return;
+
+  Checkpoint checkpoint {static_cast<uint32_t>(totalSize), static_cast<uint32_t>(totalWriteIndex), expectedCrc, crc};
+  keyValueStore.Write(KeyValueStore::Keys::DfuCheckpoint, &checkpoint, sizeof(Checkpoint));
+}
+
+bool DfuImage::HasCheckpoint(size_t totalSize) const {
+  Checkpoint checkpoint;
+  return ReadCheckpoint(totalSize, checkpoint);
+}
+
+size_t DfuImage::ResumeOffset(size_t totalSize, uint16_t expectedCrc) const {
+  Checkpoint checkpoint;
+  if (!ReadCheckpoint(totalSize, checkpoint) || checkpoint.expectedCrc != expectedCrc)
+    return 0;
+  return checkpoint.offset;
+}
+
+bool DfuImage::Resume(size_t totalSize, uint16_t expectedCrc, Encodings encoding) {
+  Checkpoint checkpoint;
+  if (encoding == Encodings::Delta || !ReadCheckpoint(totalSize, checkpoint) || checkpoint.expectedCrc != expectedCrc)
+    return false;
+
+  // The checkpoints are at the end of a sector : the decoder starts with the compressed data of the next one
+  Init(totalSize, expectedCrc, encoding);
+  totalWriteIndex = checkpoint.offset;
+  crc = checkpoint.crc;
+  // The data before the checkpoint was read back before the checkpoint was written
+  readBackIndex = checkpoint.offset;
+  readBackCrc = checkpoint.crc;
+  return true;
+}
+
+void DfuImage::WriteMagicNumber() {
+  uint32_t offset = writeOffset + (maxSize - sizeof(magicNumber));
+  spiNorFlash.Write(offset, reinterpret_cast<const uint8_t*>(magicNumber), sizeof(magicNumber));
+}
+
+void DfuImage::Erase() {
+  keyValueStore.Delete(KeyValueStore::Keys::DfuCheckpoint);
+  spiNorFlash.EraseRange(writeOffset, maxSize);
+}
+
+bool DfuImage::Validate() {
+  if (!IsComplete())
+    return false;
+  // Valid or not, this transfer won't be resumed
+  keyValueStore.Delete(KeyValueStore::Keys::DfuCheckpoint);
+
+  while (readBack && readBackIndex < totalSize) {
+    ReadBack(std::min(bufferSize, totalSize - readBackIndex));
+  }
+  if (readBack && readBackCrc != crc) {
+    NRF_LOG_INFO("[DFU] Read back CRC : %u, received CRC : %u", readBackCrc, crc);
+    return false;
+  }
+  return crc == expectedCrc;
+}
+
+bool DfuImage::IsComplete() {
+  if (!ready)
+    return false;
+  return totalWriteIndex == totalSize;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "components/utility/HeatshrinkDecoder.h"
+
+namespace Pinetime {
+  namespace Drivers {
+    class SpiNorFlash;
+  }
+
+  namespace Controllers {
+    class KeyValueStore;
+
+    // The firmware image received by DfuService, written into the DFU slot of the external flash memory
+    class DfuImage {
+    public:
+      // runningImage is the firmware the patches apply to : the primary slot of MCUBoot in the internal flash memory
+      DfuImage(Pinetime::Drivers::SpiNorFlash& spiNorFlash,
+               Pinetime::Controllers::KeyValueStore& keyValueStore,
+               const uint8_t* runningImage = reinterpret_cast<const uint8_t*>(runningImageOffset))
+        : spiNorFlash {spiNorFlash}, keyValueStore {keyValueStore}, runningImage {runningImage} {
+      }
+
+      // The values are the ones of the optional byte of the Start DFU command
+      enum class Encodings : uint8_t { Raw = 0x00, Compressed = 0x01, Delta = 0x02 };
+
+      // totalSize and expectedCrc are those of the image, not of the compressed stream or the patch
+      void Init(size_t totalSize, uint16_t expectedCrc, Encodings encoding);
+      // Erases the image and its checkpoint
+      void Erase();
+
+      // The state of the transfer (size and CRC of the data written) is saved in a checkpoint each time a sector of
+      // the image is written. An interrupted transfer of the same image (same size and CRC) continues from there,
+      // without erasing the data already written.
+      bool HasCheckpoint(size_t totalSize) const;
+      // Returns the offset of the checkpoint of this image, 0 if there's none
+      size_t ResumeOffset(size_t totalSize, uint16_t expectedCrc) const;
+      // Continues the transfer from the checkpoint. Returns false if there's no checkpoint for this image, or if
+      // it's sent as a patch.
+      bool Resume(size_t totalSize, uint16_t expectedCrc, Encodings encoding);
+      size_t Offset() const {
+        return totalWriteIndex;
+      }
+
+      // Packets of any size are accepted : 20 bytes for the legacy companion apps, or up to the ATT MTU.
+      // The CRC is computed as the packets are received.
+      // A compressed image is decompressed as it's received, one sector at a time : each sector of the image is
+      // compressed on its own, so that a transfer can continue from a checkpoint (see tools/dfu-compress.py).
+      // A patch is decompressed as a single stream, and applied to the running firmware in the internal flash memory.
+      void Append(const uint8_t* data, size_t size);
+      // The patch doesn't apply to the running firmware, or the flash memory failed to program the image
+      bool HasFailed() const {
+        return failed;
+      }
+      // Compares the CRC of the received data. With DFU_READ_BACK, the image is also read back from the flash memory
+      // one page per packet during the transfer, and its CRC must match too.
+      bool Validate();
+      bool IsComplete();
+
+    private:
+      enum class PatchStates : uint8_t { Header, Record, Copy, Diff, Extra };
+
+      struct Checkpoint {
+        uint32_t totalSize;
+        uint32_t offset;
+        uint16_t expectedCrc;
+        // CRC of the data before offset
+        uint16_t crc;
+      };
+
+      Pinetime::Drivers::SpiNorFlash& spiNorFlash;
+      Pinetime::Controllers::KeyValueStore& keyValueStore;
+      const uint8_t* const runningImage;
+      // A page of the flash memory
+      static constexpr size_t bufferSize = 256;
+      // A sector of the flash memory
+      static constexpr size_t checkpointInterval = 4096;
+#ifdef DFU_READ_BACK
+      static constexpr bool readBack = true;
+#else
+      static constexpr bool readBack = false;
+#endif
+      bool ready = false;
+      bool failed = false;
+      Encodings encoding = Encodings::Raw;
+      size_t totalSize = 0;
+      size_t maxSize = 475136;
+      size_t totalWriteIndex = 0;
+      static constexpr size_t writeOffset = 0x40000;
+      // The primary slot of MCUBoot in the internal flash memory
+      static constexpr uint32_t runningImageOffset = 0x8000;
+      uint8_t tempBuffer[bufferSize];
+      uint16_t expectedCrc = 0;
+      uint16_t crc = 0xFFFF;
+      size_t readBackIndex = 0;
+      uint16_t readBackCrc = 0xFFFF;
+      Pinetime::Utility::HeatshrinkDecoder decoder;
+
+      // State of the patch : the size of the running firmware, and the record being applied
+      PatchStates patchState = PatchStates::Header;
+      uint8_t patchField[16];
+      size_t patchFieldSize = 0;
+      uint32_t runningSize = 0;
+      uint32_t runningIndex = 0;
+      uint32_t copyLength = 0;
+      uint32_t diffLength = 0;
+      uint32_t extraLength = 0;
+
+      void Write(const uint8_t* data, size_t size);
+      void Patch(uint8_t* data, size_t size);
+      void WriteMagicNumber();
+      void ReadBack(size_t size);
+      bool ReadCheckpoint(size_t totalSize, Checkpoint& checkpoint) const;
+      void WriteCheckpoint();
+    };
+  }
+}
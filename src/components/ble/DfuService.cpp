@@ -1,6 +1,8 @@
 #include "components/ble/DfuService.h"
+#include <algorithm>
 #include <cstring>
 #include "components/ble/BleController.h"
+#include "components/kvstore/KeyValueStore.h"
 #include "drivers/SpiNorFlash.h"
 #include "systemtask/SystemTask.h"
 #include <nrf_log.h>
@@ -29,10 +31,11 @@ void TimeoutTimerCallback(TimerHandle_t xTimer) {
 
 DfuService::DfuService(Pinetime::System::SystemTask& systemTask,
                        Pinetime::Controllers::Ble& bleController,
-                       Pinetime::Drivers::SpiNorFlash& spiNorFlash)
+                       Pinetime::Drivers::SpiNorFlash& spiNorFlash,
+                       Pinetime::Controllers::KeyValueStore& keyValueStore)
   : systemTask {systemTask},
     bleController {bleController},
-    dfuImage {spiNorFlash},
+    dfuImage {spiNorFlash, keyValueStore},
     characteristicDefinition {{
                                 .uuid = &packetCharacteristicUuid.u,
                                 .access_cb = DfuServiceCallback,
@@ -129,7 +132,11 @@ int DfuService::WritePacketHandler(uint16_t connectionHandle, os_mbuf* om) {
         vTaskDelay(50); // 50ms
       }
 
-      dfuImage.Erase();
+      // The same image may continue from its checkpoint : the erase waits for its CRC, in the init packet
+      eraseDeferred = dfuImage.HasCheckpoint(applicationSize);
+      if (!eraseDeferred) {
+        dfuImage.Erase();
+      }
 
       uint8_t data[] {16, 1, 1};
       notificationManager.Send(connectionHandle, controlPointCharacteristicHandle, data, 3);
@@ -160,12 +167,28 @@ int DfuService::WritePacketHandler(uint16_t connectionHandle, os_mbuf* om) {
     }
 
     case States::Data: {
+      // Packets larger than a link layer packet can be split in a chain of mbufs
+      const uint16_t packetSize = OS_MBUF_PKTLEN(om);
+      for (os_mbuf* fragment = om; fragment != nullptr; fragment = SLIST_NEXT(fragment, om_next)) {
+        dfuImage.Append(fragment->om_data, fragment->om_len);
+      }
+      if (dfuImage.HasFailed()) {
+        uint8_t data[3] {static_cast<uint8_t>(Opcodes::Response),
+                         static_cast<uint8_t>(Opcodes::ReceiveFirmwareImage),
+                         static_cast<uint8_t>(ErrorCodes::OperationFailed)};
+        NRF_LOG_INFO("[DFU] -> The image can't be written");
+        notificationManager.Send(connectionHandle, controlPointCharacteristicHandle, data, 3);
+        bleController.State(Pinetime::Controllers::Ble::FirmwareUpdateStates::Error);
+        Reset();
+        return 0;
+      }
       nbPacketReceived++;
-      dfuImage.Append(om->om_data, om->om_len);
-      bytesReceived += om->om_len;
-      bleController.FirmwareUpdateCurrentBytes(bytesReceived);
+      // Bytes of the compressed stream or of the patch, as counted by the companion app
+      bytesReceived += packetSize;
+      largestPacket = std::max(largestPacket, packetSize);
+      bleController.FirmwareUpdateCurrentBytes(dfuImage.Offset());
 
-      if ((nbPacketReceived % nbPacketsToNotify) == 0 && bytesReceived != applicationSize) {
+      if (nbPacketsToNotify != 0 && (nbPacketReceived % nbPacketsToNotify) == 0 && !dfuImage.IsComplete()) {
         uint8_t data[5] {static_cast<uint8_t>(Opcodes::PacketReceiptNotification),
                          static_cast<uint8_t>(bytesReceived & 0x000000FFu),
                          static_cast<uint8_t>(bytesReceived >> 8u),
@@ -179,6 +202,12 @@ int DfuService::WritePacketHandler(uint16_t connectionHandle, os_mbuf* om) {
                          static_cast<uint8_t>(Opcodes::ReceiveFirmwareImage),
                          static_cast<uint8_t>(ErrorCodes::NoError)};
         NRF_LOG_INFO("[DFU] -> Send packet notification : all bytes received!");
+        NRF_LOG_INFO("[DFU] -> %d bytes (image : %d bytes) in %d packets (up to %d bytes) in %d ms",
+                     bytesReceived,
+                     dfuImage.Offset(),
+                     nbPacketReceived,
+                     largestPacket,
+                     ((xTaskGetTickCount() - dataStartTime) * 1000) / configTICK_RATE_HZ);
         notificationManager.Send(connectionHandle, controlPointCharacteristicHandle, data, 3);
         state = States::Validate;
       }
@@ -206,8 +235,16 @@ int DfuService::ControlPointHandler(uint16_t connectionHandle, os_mbuf* om) {
         return 0;
       }
       auto imageType = static_cast<ImageTypes>(om->om_data[1]);
+      // The companion app can ask for a compressed transfer, or send a patch, in an optional third byte
+      auto imageEncoding = (OS_MBUF_PKTLEN(om) > 2) ? static_cast<DfuImage::Encodings>(om->om_data[2]) : DfuImage::Encodings::Raw;
+      if (imageEncoding != DfuImage::Encodings::Raw && imageEncoding != DfuImage::Encodings::Compressed &&
+          imageEncoding != DfuImage::Encodings::Delta) {
+        NRF_LOG_INFO("[DFU] -> Start DFU, encoding %d not supported!", imageEncoding);
+        return 0;
+      }
       if (imageType == ImageTypes::Application) {
-        NRF_LOG_INFO("[DFU] -> Start DFU, mode = Application");
+        NRF_LOG_INFO("[DFU] -> Start DFU, mode = Application, encoding = %d", imageEncoding);
+        encoding = imageEncoding;
         state = States::Start;
         bleController.StartFirmwareUpdate();
         bleController.State(Pinetime::Controllers::Ble::FirmwareUpdateStates::Running);
@@ -229,6 +266,12 @@ int DfuService::ControlPointHandler(uint16_t connectionHandle, os_mbuf* om) {
       NRF_LOG_INFO("[DFU] -> Init DFU parameters %s", isInitComplete ? " complete" : " not complete");
 
       if (isInitComplete) {
+        if (eraseDeferred && dfuImage.ResumeOffset(applicationSize, expectedCrc) == 0) {
+          NRF_LOG_INFO("[DFU] -> The checkpoint is for another image");
+          dfuImage.Erase();
+        }
+        eraseDeferred = false;
+
         uint8_t data[3] {static_cast<uint8_t>(Opcodes::Response),
                          static_cast<uint8_t>(Opcodes::InitDFUParameters),
                          (isInitComplete ? uint8_t {1} : uint8_t {0})};
@@ -237,6 +280,25 @@ int DfuService::ControlPointHandler(uint16_t connectionHandle, os_mbuf* om) {
       }
     }
       return 0;
+    case Opcodes::ReportReceivedImageSize: {
+      // Offset from which the image can be sent : the checkpoint before the transfer starts
+      uint32_t size = bytesReceived;
+      if (state == States::Init) {
+        // A patch is always sent from the beginning
+        size = (encoding == DfuImage::Encodings::Delta) ? 0 : dfuImage.ResumeOffset(applicationSize, expectedCrc);
+        resumeRequested = true;
+      }
+      NRF_LOG_INFO("[DFU] -> Report received image size : %d", size);
+      uint8_t data[7] {static_cast<uint8_t>(Opcodes::Response),
+                       static_cast<uint8_t>(Opcodes::ReportReceivedImageSize),
+                       static_cast<uint8_t>(ErrorCodes::NoError),
+                       static_cast<uint8_t>(size & 0x000000FFu),
+                       static_cast<uint8_t>(size >> 8u),
+                       static_cast<uint8_t>(size >> 16u),
+                       static_cast<uint8_t>(size >> 24u)};
+      notificationManager.Send(connectionHandle, controlPointCharacteristicHandle, data, 7);
+      return 0;
+    }
     case Opcodes::PacketReceiptNotificationRequest:
       nbPacketsToNotify = om->om_data[1];
       NRF_LOG_INFO("[DFU] -> Receive Packet Notification Request, nb packet = %d", nbPacketsToNotify);
@@ -246,9 +308,21 @@ int DfuService::ControlPointHandler(uint16_t connectionHandle, os_mbuf* om) {
         NRF_LOG_INFO("[DFU] -> Receive firmware image requested, but we are not in Start Init");
         return 0;
       }
-      // TODO the chunk size is dependent of the implementation of the host application...
-      dfuImage.Init(20, applicationSize, expectedCrc);
-      NRF_LOG_INFO("[DFU] -> Starting receive firmware");
+      if (eraseDeferred && dfuImage.ResumeOffset(applicationSize, expectedCrc) == 0) {
+        dfuImage.Erase();
+      }
+      eraseDeferred = false;
+      if (resumeRequested && dfuImage.Resume(applicationSize, expectedCrc, encoding)) {
+        NRF_LOG_INFO("[DFU] -> Resuming from %d", dfuImage.Offset());
+      } else {
+        // Without erase if the image has a checkpoint : the same data is written again
+        dfuImage.Init(applicationSize, expectedCrc, encoding);
+      }
+      // The compressed stream sent from a checkpoint starts with the sector of the checkpoint : it's counted from there
+      bytesReceived = (encoding == DfuImage::Encodings::Raw) ? dfuImage.Offset() : 0;
+      bleController.FirmwareUpdateCurrentBytes(dfuImage.Offset());
+      dataStartTime = xTaskGetTickCount();
+      NRF_LOG_INFO("[DFU] -> Starting receive firmware (ATT MTU %d)", ble_att_mtu(connectionHandle));
       state = States::Data;
       return 0;
     case Opcodes::ValidateFirmware: {
@@ -305,10 +379,14 @@ void DfuService::Reset() {
   nbPacketsToNotify = 0;
   nbPacketReceived = 0;
   bytesReceived = 0;
+  largestPacket = 0;
+  eraseDeferred = false;
+  resumeRequested = false;
   softdeviceSize = 0;
   bootloaderSize = 0;
   applicationSize = 0;
   expectedCrc = 0;
+  encoding = DfuImage::Encodings::Raw;
   notificationManager.Reset();
   bleController.StopFirmwareUpdate();
   systemTask.PushMessage(Pinetime::System::Messages::BleFirmwareUpdateFinished);
@@ -349,94 +427,3 @@ void DfuService::NotificationManager::Reset() {
   size = 0;
   xTimerStop(timer, 0);
 }
-
-void DfuService::DfuImage::Init(size_t chunkSize, size_t totalSize, uint16_t expectedCrc) {
-  if (chunkSize != 20)
-    return;
-  this->chunkSize = chunkSize;
-  this->totalSize = totalSize;
-  this->expectedCrc = expectedCrc;
-  this->ready = true;
-}
-
-void DfuService::DfuImage::Append(uint8_t* data, size_t size) {
-  if (!ready)
-    return;
-  ASSERT(size <= 20);
-
-  std::memcpy(tempBuffer + bufferWriteIndex, data, size);
-  bufferWriteIndex += size;
-
-  if (bufferWriteIndex == bufferSize) {
-    spiNorFlash.Write(writeOffset + totalWriteIndex, tempBuffer, bufferWriteIndex);
-    totalWriteIndex += bufferWriteIndex;
-    bufferWriteIndex = 0;
-  }
-
-  if (bufferWriteIndex > 0 && totalWriteIndex + bufferWriteIndex == totalSize) {
-    spiNorFlash.Write(writeOffset + totalWriteIndex, tempBuffer, bufferWriteIndex);
-    totalWriteIndex += bufferWriteIndex;
-    if (totalSize < maxSize)
-      WriteMagicNumber();
-  }
-}
-
-void DfuService::DfuImage::WriteMagicNumber() {
-  uint32_t magic[4] = {
-    // TODO When this variable is a static constexpr, the values written to the memory are not correct. Why?
-    0xf395c277,
-    0x7fefd260,
-    0x0f505235,
-    0x8079b62c,
-  };
-
-  uint32_t offset = writeOffset + (maxSize - (4 * sizeof(uint32_t)));
-  spiNorFlash.Write(offset, reinterpret_cast<const uint8_t*>(magic), 4 * sizeof(uint32_t));
-}
-
-void DfuService::DfuImage::Erase() {
-  for (size_t erased = 0; erased < maxSize; erased += 0x1000) {
-    spiNorFlash.SectorErase(writeOffset + erased);
-  }
-}
-
-bool DfuService::DfuImage::Validate() {
-  uint32_t chunkSize = 200;
-  size_t currentOffset = 0;
-  uint16_t crc = 0;
-
-  bool first = true;
-  while (currentOffset < totalSize) {
-    uint32_t readSize = (totalSize - currentOffset) > chunkSize ? chunkSize : (totalSize - currentOffset);
-
-    spiNorFlash.Read(writeOffset + currentOffset, tempBuffer, readSize);
-    if (first) {
-      crc = ComputeCrc(tempBuffer, readSize, NULL);
-      first = false;
-    } else
-      crc = ComputeCrc(tempBuffer, readSize, &crc);
-    currentOffset += readSize;
-  }
-
-  return (crc == expectedCrc);
-}
-
-uint16_t DfuService::DfuImage::ComputeCrc(uint8_t const* p_data, uint32_t size, uint16_t const* p_crc) {
-  uint16_t crc = (p_crc == NULL) ? 0xFFFF : *p_crc;
-
-  for (uint32_t i = 0; i < size; i++) {
-    crc = static_cast<uint8_t>(crc >> 8) | (crc << 8);
-    crc ^= p_data[i];
-    crc ^= static_cast<uint8_t>(crc & 0xFF) >> 4;
-    crc ^= (crc << 8) << 4;
-    crc ^= ((crc & 0xFF) << 4) << 1;
-  }
-
-  return crc;
-}
-
-bool DfuService::DfuImage::IsComplete() {
-  if (!ready)
-    return false;
-  return totalWriteIndex == totalSize;
-}
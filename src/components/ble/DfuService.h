@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <array>
+#include "components/ble/DfuImage.h"
 
 #define min // workaround: nimble's min/max macros conflict with libstdc++
 #define max
@@ -20,12 +21,14 @@ namespace Pinetime {
 
   namespace Controllers {
     class Ble;
+    class KeyValueStore;
 
     class DfuService {
     public:
       DfuService(Pinetime::System::SystemTask& systemTask,
                  Pinetime::Controllers::Ble& bleController,
-                 Pinetime::Drivers::SpiNorFlash& spiNorFlash);
+                 Pinetime::Drivers::SpiNorFlash& spiNorFlash,
+                 Pinetime::Controllers::KeyValueStore& keyValueStore);
       void Init();
       int OnServiceData(uint16_t connectionHandle, uint16_t attributeHandle, ble_gatt_access_ctxt* context);
       void OnTimeout();
@@ -49,34 +52,6 @@ namespace Pinetime {
         void Reset();
       };
 
-      class DfuImage {
-      public:
-        DfuImage(Pinetime::Drivers::SpiNorFlash& spiNorFlash) : spiNorFlash {spiNorFlash} {
-        }
-
-        void Init(size_t chunkSize, size_t totalSize, uint16_t expectedCrc);
-        void Erase();
-        void Append(uint8_t* data, size_t size);
-        bool Validate();
-        bool IsComplete();
-
-      private:
-        Pinetime::Drivers::SpiNorFlash& spiNorFlash;
-        static constexpr size_t bufferSize = 200;
-        bool ready = false;
-        size_t chunkSize = 0;
-        size_t totalSize = 0;
-        size_t maxSize = 475136;
-        size_t bufferWriteIndex = 0;
-        size_t totalWriteIndex = 0;
-        static constexpr size_t writeOffset = 0x40000;
-        uint8_t tempBuffer[bufferSize];
-        uint16_t expectedCrc = 0;
-
-        void WriteMagicNumber();
-        uint16_t ComputeCrc(uint8_t const* p_data, uint32_t size, uint16_t const* p_crc);
-      };
-
     private:
       Pinetime::System::SystemTask& systemTask;
       Pinetime::Controllers::Ble& bleController;
@@ -129,6 +104,7 @@ namespace Pinetime {
         ReceiveFirmwareImage = 0x03,
         ValidateFirmware = 0x04,
         ActivateImageAndReset = 0x05,
+        ReportReceivedImageSize = 0x07,
         PacketReceiptNotificationRequest = 0x08,
         Response = 0x10,
         PacketReceiptNotification = 0x11
@@ -146,11 +122,18 @@ namespace Pinetime {
       uint8_t nbPacketsToNotify = 0;
       uint32_t nbPacketReceived = 0;
       uint32_t bytesReceived = 0;
+      uint16_t largestPacket = 0;
+      TickType_t dataStartTime = 0;
 
       uint32_t softdeviceSize = 0;
       uint32_t bootloaderSize = 0;
       uint32_t applicationSize = 0;
       uint16_t expectedCrc = 0;
+      DfuImage::Encodings encoding = DfuImage::Encodings::Raw;
+      // The image area is erased once the init packet shows that the transfer can't continue from a checkpoint
+      bool eraseDeferred = false;
+      // Only the companion apps that asked for the received image size send the image from this offset
+      bool resumeRequested = false;
 
       int SendDfuRevision(os_mbuf* om) const;
       int WritePacketHandler(uint16_t connectionHandle, os_mbuf* om);
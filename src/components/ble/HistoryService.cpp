@@ -0,0 +1,108 @@
+#include "components/ble/HistoryService.h"
+#include <algorithm>
+#include <nrf_log.h>
+#include "components/timeseries/TimeSeries.h"
+#include "systemtask/SystemTask.h"
+
+using namespace Pinetime::Controllers;
+
+namespace {
+  // 0005yyxx-78fc-48fe-8e23-433b3a1942d0
+  constexpr ble_uuid128_t CharUuid(uint8_t x, uint8_t y) {
+    return ble_uuid128_t {.u = {.type = BLE_UUID_TYPE_128},
+                          .value = {0xd0, 0x42, 0x19, 0x3a, 0x3b, 0x43, 0x23, 0x8e, 0xfe, 0x48, 0xfc, 0x78, x, y, 0x05, 0x00}};
+  }
+
+  // 00050000-78fc-48fe-8e23-433b3a1942d0
+  constexpr ble_uuid128_t BaseUuid() {
+    return CharUuid(0x00, 0x00);
+  }
+
+  constexpr ble_uuid128_t historyServiceUuid {BaseUuid()};
+  constexpr ble_uuid128_t exportCharUuid {CharUuid(0x01, 0x00)};
+
+  int HistoryServiceCallback(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt* ctxt, void* arg) {
+    auto* historyService = static_cast<HistoryService*>(arg);
+    return historyService->OnExportRequested(conn_handle, attr_handle, ctxt);
+  }
+}
+
+HistoryService::HistoryService(Pinetime::System::SystemTask& system, Controllers::TimeSeries& timeSeries)
+  : system {system},
+    timeSeries {timeSeries},
+    characteristicDefinition {{.uuid = &exportCharUuid.u,
+                               .access_cb = HistoryServiceCallback,
+                               .arg = this,
+                               .flags = BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_NOTIFY,
+                               .val_handle = &exportHandle},
+                              {0}},
+    serviceDefinition {
+      {.type = BLE_GATT_SVC_TYPE_PRIMARY, .uuid = &historyServiceUuid.u, .characteristics = characteristicDefinition},
+      {0},
+    } {
+}
+
+void HistoryService::Init() {
+  int res = 0;
+  res = ble_gatts_count_cfg(serviceDefinition);
+  ASSERT(res == 0);
+
+  res = ble_gatts_add_svcs(serviceDefinition);
+  ASSERT(res == 0);
+}
+
+int HistoryService::OnExportRequested(uint16_t connectionHandle, uint16_t attributeHandle, ble_gatt_access_ctxt* context) {
+  if (attributeHandle != exportHandle || context->op != BLE_GATT_ACCESS_OP_WRITE_CHR) {
+    return 0;
+  }
+  uint32_t cursor;
+  if (OS_MBUF_PKTLEN(context->om) < sizeof(cursor)) {
+    return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+  }
+  os_mbuf_copydata(context->om, 0, sizeof(cursor), &cursor);
+  exportCursor = cursor;
+  exportConnectionHandle = connectionHandle;
+
+  if (!exporting) {
+    exporting = true;
+    system.PushMessage(Pinetime::System::Messages::StartFileTransfer);
+  }
+  system.PushMessage(Pinetime::System::Messages::ExportHistory);
+  return 0;
+}
+
+void HistoryService::SendExport() {
+  if (!exporting) {
+    return;
+  }
+  uint32_t cursor = exportCursor;
+  // A notification carries at most MTU - 3 bytes
+  size_t maxSamples = (ble_att_mtu(exportConnectionHandle) - 3 - sizeof(cursor)) / sizeof(ExportedSample);
+  TimeSeries::Sample samples[maxSamplesPerChunk];
+  size_t nbSamples = timeSeries.Export(cursor, samples, std::min(maxSamples, maxSamplesPerChunk));
+  NRF_LOG_INFO("[History] Export : %d samples, next cursor %d", nbSamples, cursor);
+
+  auto* om = ble_hs_mbuf_from_flat(&cursor, sizeof(cursor));
+  for (size_t i = 0; i < nbSamples; i++) {
+    ExportedSample sample {samples[i].time, static_cast<uint8_t>(samples[i].series), 0, samples[i].value};
+    os_mbuf_append(om, &sample, sizeof(sample));
+  }
+  ble_gattc_notify_custom(exportConnectionHandle, exportHandle, om);
+
+  if (nbSamples == 0) {
+    StopExport();
+  }
+}
+
+void HistoryService::UnsubscribeNotification(uint16_t attributeHandle) {
+  if (attributeHandle == exportHandle) {
+    StopExport();
+  }
+}
+
+void HistoryService::StopExport() {
+  if (exporting) {
+    exporting = false;
+    system.PushMessage(Pinetime::System::Messages::StopFileTransfer);
+  }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#define min // workaround: nimble's min/max macros conflict with libstdc++
+#define max
+#include <host/ble_gap.h>
+#undef max
+#undef min
+
+namespace Pinetime {
+  namespace System {
+    class SystemTask;
+  }
+
+  namespace Controllers {
+    class TimeSeries;
+
+    // Bulk export of the time series. The companion app writes a cursor (uint32_t, 0 for the oldest sample) to the
+    // export characteristic, and the watch notifies a chunk : the cursor of the next chunk (uint32_t) followed by as
+    // many samples as the MTU allows. The app writes the cursor of the next chunk to continue, an empty chunk means
+    // that all the samples are exported (its cursor can be stored to export only the new samples next time).
+    // The system doesn't go to sleep during an export : it ends with the empty chunk, or when the app unsubscribes
+    // from the export characteristic or disconnects.
+    // The chunks are read and notified by the system task (SendExport()), once the external flash memory is awake.
+    class HistoryService {
+    public:
+      HistoryService(Pinetime::System::SystemTask& system, Controllers::TimeSeries& timeSeries);
+      void Init();
+      int OnExportRequested(uint16_t connectionHandle, uint16_t attributeHandle, ble_gatt_access_ctxt* context);
+      void UnsubscribeNotification(uint16_t attributeHandle);
+      void StopExport();
+      // Notifies the chunk requested by the last write. Called by the system task.
+      void SendExport();
+
+    private:
+      using ExportedSample = struct __attribute__((packed)) {
+        uint32_t time;
+        uint8_t series;
+        uint8_t padding;
+        int16_t value;
+      };
+
+      static constexpr size_t maxSamplesPerChunk = 30;
+
+      Pinetime::System::SystemTask& system;
+      Controllers::TimeSeries& timeSeries;
+
+      struct ble_gatt_chr_def characteristicDefinition[2];
+      struct ble_gatt_svc_def serviceDefinition[2];
+
+      uint16_t exportHandle;
+      bool exporting = false;
+      uint16_t exportConnectionHandle = 0;
+      uint32_t exportCursor = 0;
+    };
+  }
+}
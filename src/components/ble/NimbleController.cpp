@@ -1,4 +1,5 @@
 #include "components/ble/NimbleController.h"
+#include <algorithm>
 #include <cstring>
 
 #include <hal/nrf_rtc.h>
@@ -23,6 +24,13 @@
 
 using namespace Pinetime::Controllers;
 
+namespace {
+  // The bond is stored as our keys, the keys of the peer, the number of CCCDs and the CCCDs (same layout as the
+  // /bond.dat file written by older versions)
+  constexpr size_t bondMaxSize =
+    (2 * sizeof(ble_store_value)) + sizeof(uint8_t) + (MYNEWT_VAL(BLE_STORE_MAX_CCCDS) * sizeof(ble_store_value_cccd));
+}
+
 NimbleController::NimbleController(Pinetime::System::SystemTask& systemTask,
                                    Ble& bleController,
                                    DateTime& dateTimeController,
@@ -31,13 +39,16 @@ NimbleController::NimbleController(Pinetime::System::SystemTask& systemTask,
                                    Pinetime::Drivers::SpiNorFlash& spiNorFlash,
                                    HeartRateController& heartRateController,
                                    MotionController& motionController,
-                                   FS& fs)
+                                   FS& fs,
+                                   KeyValueStore& keyValueStore,
+                                   TimeSeries& timeSeries)
   : systemTask {systemTask},
     bleController {bleController},
     dateTimeController {dateTimeController},
     spiNorFlash {spiNorFlash},
     fs {fs},
-    dfuService {systemTask, bleController, spiNorFlash},
+    keyValueStore {keyValueStore},
+    dfuService {systemTask, bleController, spiNorFlash, keyValueStore},
 
     currentTimeClient {dateTimeController},
     anService {systemTask, notificationManager},
@@ -51,6 +62,7 @@ NimbleController::NimbleController(Pinetime::System::SystemTask& systemTask,
     heartRateService {systemTask, heartRateController},
     motionService {systemTask, motionController},
     fsService {systemTask, fs},
+    historyService {systemTask, timeSeries},
     serviceDiscovery({&currentTimeClient, &alertNotificationClient}) {
 }
 
@@ -100,6 +112,7 @@ void NimbleController::Init() {
   heartRateService.Init();
   motionService.Init();
   fsService.Init();
+  historyService.Init();
 
   int rc;
   rc = ble_hs_util_ensure_addr(0);
@@ -206,6 +219,13 @@ int NimbleController::OnGAPEvent(ble_gap_event* event) {
       } else {
         connectionHandle = event->connect.conn_handle;
         bleController.Connect();
+        // Larger packets for the transfers (DFU, file system) : the 2M PHY if the central supports it, and the
+        // preferred ATT MTU. The controller starts the data length update by itself.
+        ble_gap_set_prefered_le_phy(connectionHandle,
+                                    BLE_GAP_LE_PHY_1M_MASK | BLE_GAP_LE_PHY_2M_MASK,
+                                    BLE_GAP_LE_PHY_1M_MASK | BLE_GAP_LE_PHY_2M_MASK,
+                                    BLE_GAP_LE_PHY_CODED_ANY);
+        ble_gattc_exchange_mtu(connectionHandle, nullptr, nullptr);
         systemTask.PushMessage(Pinetime::System::Messages::BleConnected);
         // Service discovery is deferred via systemtask
       }
@@ -222,6 +242,7 @@ int NimbleController::OnGAPEvent(ble_gap_event* event) {
 
       currentTimeClient.Reset();
       alertNotificationClient.Reset();
+      historyService.StopExport();
       connectionHandle = BLE_HS_CONN_HANDLE_NONE;
       if (bleController.IsConnected()) {
         bleController.Disconnect();
@@ -324,12 +345,14 @@ int NimbleController::OnGAPEvent(ble_gap_event* event) {
       if (event->subscribe.reason == BLE_GAP_SUBSCRIBE_REASON_TERM) {
         heartRateService.UnsubscribeNotification(event->subscribe.attr_handle);
         motionService.UnsubscribeNotification(event->subscribe.attr_handle);
+        historyService.UnsubscribeNotification(event->subscribe.attr_handle);
       } else if (event->subscribe.prev_notify == 0 && event->subscribe.cur_notify == 1) {
         heartRateService.SubscribeNotification(event->subscribe.attr_handle);
         motionService.SubscribeNotification(event->subscribe.attr_handle);
       } else if (event->subscribe.prev_notify == 1 && event->subscribe.cur_notify == 0) {
         heartRateService.UnsubscribeNotification(event->subscribe.attr_handle);
         motionService.UnsubscribeNotification(event->subscribe.attr_handle);
+        historyService.UnsubscribeNotification(event->subscribe.attr_handle);
       }
       break;
 
@@ -337,6 +360,13 @@ int NimbleController::OnGAPEvent(ble_gap_event* event) {
       NRF_LOG_INFO("MTU Update event; conn_handle=%d cid=%d mtu=%d", event->mtu.conn_handle, event->mtu.channel_id, event->mtu.value);
       break;
 
+    case BLE_GAP_EVENT_PHY_UPDATE_COMPLETE:
+      NRF_LOG_INFO("PHY Update event; status=%d tx=%d rx=%d",
+                   event->phy_updated.status,
+                   event->phy_updated.tx_phy,
+                   event->phy_updated.rx_phy);
+      break;
+
     case BLE_GAP_EVENT_REPEAT_PAIRING: {
       NRF_LOG_INFO("Pairing event : BLE_GAP_EVENT_REPEAT_PAIRING");
       /* We already have a bond with the peer, but it is attempting to
@@ -445,55 +475,58 @@ void NimbleController::PersistBond(struct ble_gap_conn_desc& desc) {
     key.cccd.peer_addr = desc.peer_id_addr;
     int peer_count = 0;
     ble_store_util_count(BLE_STORE_OBJ_TYPE_CCCD, &peer_count);
+    peer_count = std::min(peer_count, MYNEWT_VAL(BLE_STORE_MAX_CCCDS));
     for (int i = 0; i < peer_count; i++) {
-      key.cccd.idx = peer_count;
+      key.cccd.idx = i;
       ble_store_read_cccd(&key.cccd, &peer_cccd_set[i].cccd);
     }
 
-    /* Wakeup Spi and SpiNorFlash before accessing the file system
+    /* Wakeup Spi and SpiNorFlash before accessing the key-value store
      * This should be fixed in the FS driver
      */
     systemTask.PushMessage(Pinetime::System::Messages::GoToRunning);
     systemTask.PushMessage(Pinetime::System::Messages::DisableSleeping);
     vTaskDelay(10);
 
-    lfs_file_t file_p;
-
-    rc = fs.FileOpen(&file_p, "/bond.dat", LFS_O_WRONLY | LFS_O_CREAT);
-    if (rc == 0) {
-      fs.FileWrite(&file_p, reinterpret_cast<uint8_t*>(&our_sec.sec), sizeof our_sec);
-      fs.FileWrite(&file_p, reinterpret_cast<uint8_t*>(&peer_sec.sec), sizeof peer_sec);
-      fs.FileWrite(&file_p, reinterpret_cast<const uint8_t*>(&peer_count), 1);
-      for (int i = 0; i < peer_count; i++) {
-        fs.FileWrite(&file_p, reinterpret_cast<uint8_t*>(&peer_cccd_set[i].cccd), sizeof(struct ble_store_value_cccd));
-      }
-      fs.FileClose(&file_p);
+    uint8_t bond[bondMaxSize];
+    size_t bondSize = 0;
+    auto append = [&bond, &bondSize](const void* data, size_t size) {
+      memcpy(bond + bondSize, data, size);
+      bondSize += size;
+    };
+    uint8_t cccdCount = peer_count;
+    append(&our_sec.sec, sizeof our_sec);
+    append(&peer_sec.sec, sizeof peer_sec);
+    append(&cccdCount, sizeof cccdCount);
+    for (int i = 0; i < peer_count; i++) {
+      append(&peer_cccd_set[i].cccd, sizeof(struct ble_store_value_cccd));
     }
+    keyValueStore.Write(KeyValueStore::Keys::Bond, bond, bondSize);
     systemTask.PushMessage(Pinetime::System::Messages::EnableSleeping);
   }
 }
 
 void NimbleController::RestoreBond() {
-  lfs_file_t file_p;
-  union ble_store_value sec, cccd;
-  uint8_t peer_count = 0;
-
-  if (fs.FileOpen(&file_p, "/bond.dat", LFS_O_RDONLY) == 0) {
-    memset(&sec, 0, sizeof sec);
-    fs.FileRead(&file_p, reinterpret_cast<uint8_t*>(&sec.sec), sizeof sec);
-    ble_store_write_our_sec(&sec.sec);
-
-    memset(&sec, 0, sizeof sec);
-    fs.FileRead(&file_p, reinterpret_cast<uint8_t*>(&sec.sec), sizeof sec);
-    ble_store_write_peer_sec(&sec.sec);
-
-    fs.FileRead(&file_p, &peer_count, 1);
-    for (int i = 0; i < peer_count; i++) {
-      fs.FileRead(&file_p, reinterpret_cast<uint8_t*>(&cccd.cccd), sizeof(struct ble_store_value_cccd));
-      ble_store_write_cccd(&cccd.cccd);
-    }
+  uint8_t bond[bondMaxSize];
+  size_t bondSize = std::min(keyValueStore.Read(KeyValueStore::Keys::Bond, bond, sizeof bond), sizeof bond);
+  if (bondSize < (2 * sizeof(ble_store_value)) + sizeof(uint8_t)) {
+    return;
+  }
 
-    fs.FileClose(&file_p);
-    fs.FileDelete("/bond.dat");
+  union ble_store_value sec, cccd;
+  size_t offset = 0;
+  memcpy(&sec, bond + offset, sizeof sec);
+  offset += sizeof sec;
+  ble_store_write_our_sec(&sec.sec);
+
+  memcpy(&sec, bond + offset, sizeof sec);
+  offset += sizeof sec;
+  ble_store_write_peer_sec(&sec.sec);
+
+  uint8_t peer_count = bond[offset++];
+  for (int i = 0; i < peer_count && offset + sizeof(struct ble_store_value_cccd) <= bondSize; i++) {
+    memcpy(&cccd.cccd, bond + offset, sizeof(struct ble_store_value_cccd));
+    offset += sizeof(struct ble_store_value_cccd);
+    ble_store_write_cccd(&cccd.cccd);
   }
 }
@@ -16,6 +16,7 @@
 #include "components/ble/DfuService.h"
 #include "components/ble/FSService.h"
 #include "components/ble/HeartRateService.h"
+#include "components/ble/HistoryService.h"
 #include "components/ble/ImmediateAlertService.h"
 #include "components/ble/MusicService.h"
 #include "components/ble/NavigationService.h"
@@ -23,6 +24,7 @@
 #include "components/ble/MotionService.h"
 #include "components/ble/weather/WeatherService.h"
 #include "components/fs/FS.h"
+#include "components/kvstore/KeyValueStore.h"
 
 namespace Pinetime {
   namespace Drivers {
@@ -37,6 +39,7 @@ namespace Pinetime {
     class Ble;
     class DateTime;
     class NotificationManager;
+    class TimeSeries;
 
     class NimbleController {
 
@@ -49,7 +52,9 @@ namespace Pinetime {
                        Pinetime::Drivers::SpiNorFlash& spiNorFlash,
                        HeartRateController& heartRateController,
                        MotionController& motionController,
-                       FS& fs);
+                       FS& fs,
+                       KeyValueStore& keyValueStore,
+                       TimeSeries& timeSeries);
       void Init();
       void StartAdvertising();
       int OnGAPEvent(ble_gap_event* event);
@@ -71,6 +76,10 @@ namespace Pinetime {
         return weatherService;
       };
 
+      Pinetime::Controllers::HistoryService& history() {
+        return historyService;
+      };
+
       uint16_t connHandle();
       void NotifyBatteryLevel(uint8_t level);
 
@@ -91,6 +100,7 @@ namespace Pinetime {
       DateTime& dateTimeController;
       Pinetime::Drivers::SpiNorFlash& spiNorFlash;
       FS& fs;
+      KeyValueStore& keyValueStore;
       DfuService dfuService;
 
       DeviceInformationService deviceInformationService;
@@ -106,6 +116,7 @@ namespace Pinetime {
       HeartRateService heartRateService;
       MotionService motionService;
       FSService fsService;
+      HistoryService historyService;
       ServiceDiscovery serviceDiscovery;
 
       uint8_t addrType;
@@ -1,12 +1,16 @@
 #include "components/fs/FS.h"
+#include <algorithm>
 #include <cstring>
 #include <littlefs/lfs.h>
 #include <lvgl/lvgl.h>
+#include <libraries/log/nrf_log.h>
 
 using namespace Pinetime::Controllers;
 
 FS::FS(Pinetime::Drivers::SpiNorFlash& driver)
   : flashDriver {driver},
+    cache {driver},
+    resourcePack {*this},
     lfsConfig {
       .context = this,
       .read = SectorRead,
@@ -29,6 +33,7 @@ FS::FS(Pinetime::Drivers::SpiNorFlash& driver)
 }
 
 void FS::Init() {
+  TickType_t mountStartTime = xTaskGetTickCount();
 
   // try mount
   int err = lfs_mount(&lfs, &lfsConfig);
@@ -43,6 +48,14 @@ void FS::Init() {
     }
   }
 
+  const auto& statistics = cache.GetStatistics();
+  NRF_LOG_INFO("[FS] Mounted in %d ticks, cache : %d hits, %d misses, %d prefetches, %d bypasses",
+               xTaskGetTickCount() - mountStartTime,
+               statistics.hits,
+               statistics.misses,
+               statistics.prefetches,
+               statistics.bypasses);
+
 #ifndef PINETIME_IS_RECOVERY
   VerifyResource();
   LVGLFileSystemInit();
@@ -51,7 +64,26 @@ void FS::Init() {
 
 void FS::VerifyResource() {
   // validate the resource metadata
-  resourcesValid = true;
+  resourcesValid = resourcePack.Open();
+  if (resourcesValid) {
+    NRF_LOG_INFO("[FS] Resource pack : %d resources", resourcePack.NbResources());
+    resourcePack.Close();
+  } else {
+    NRF_LOG_INFO("[FS] No valid resource pack");
+  }
+}
+
+bool FS::ResourceExists(const char* path) {
+  if (resourcePack.Open()) {
+    ResourcePack::Resource resource;
+    bool found = resourcePack.Find(path, resource);
+    resourcePack.Close();
+    if (found) {
+      return true;
+    }
+  }
+  lfs_info info;
+  return Stat(path, &info) == LFS_ERR_OK;
 }
 
 int FS::FileOpen(lfs_file_t* file_p, const char* fileName, const int flags) {
@@ -70,6 +102,10 @@ int FS::FileWrite(lfs_file_t* file_p, const uint8_t* buff, uint32_t size) {
   return lfs_file_write(&lfs, file_p, buff, size);
 }
 
+int FS::FileSize(lfs_file_t* file_p) {
+  return lfs_file_size(&lfs, file_p);
+}
+
 int FS::FileSeek(lfs_file_t* file_p, uint32_t pos) {
   return lfs_file_seek(&lfs, file_p, pos, LFS_SEEK_SET);
 }
@@ -115,28 +151,32 @@ lfs_ssize_t FS::GetFSSize() {
     ----------- Interface between littlefs and SpiNorFlash -----------
 
 */
-int FS::SectorSync(const struct lfs_config* /*c*/) {
-  return 0;
+int FS::SectorSync(const struct lfs_config* c) {
+  Pinetime::Controllers::FS& lfs = *(static_cast<Pinetime::Controllers::FS*>(c->context));
+  return lfs.flashDriver.Sync() ? 0 : LFS_ERR_IO;
 }
 
 int FS::SectorErase(const struct lfs_config* c, lfs_block_t block) {
   Pinetime::Controllers::FS& lfs = *(static_cast<Pinetime::Controllers::FS*>(c->context));
   const size_t address = startAddress + (block * blockSize);
+  lfs.cache.Invalidate(address, blockSize);
   lfs.flashDriver.SectorErase(address);
-  return lfs.flashDriver.EraseFailed() ? -1 : 0;
+  return lfs.flashDriver.EraseFailed() ? LFS_ERR_IO : 0;
 }
 
 int FS::SectorProg(const struct lfs_config* c, lfs_block_t block, lfs_off_t off, const void* buffer, lfs_size_t size) {
   Pinetime::Controllers::FS& lfs = *(static_cast<Pinetime::Controllers::FS*>(c->context));
   const size_t address = startAddress + (block * blockSize) + off;
-  lfs.flashDriver.Write(address, (uint8_t*) buffer, size);
-  return lfs.flashDriver.ProgramFailed() ? -1 : 0;
+  // Programmed in the background, littlefs calls SectorSync() before relying on the data : the failures of the
+  // pages programmed since the previous sync are reported there
+  lfs.cache.Write(address, static_cast<const uint8_t*>(buffer), size);
+  return 0;
 }
 
 int FS::SectorRead(const struct lfs_config* c, lfs_block_t block, lfs_off_t off, void* buffer, lfs_size_t size) {
   Pinetime::Controllers::FS& lfs = *(static_cast<Pinetime::Controllers::FS*>(c->context));
   const size_t address = startAddress + (block * blockSize) + off;
-  lfs.flashDriver.Read(address, static_cast<uint8_t*>(buffer), size);
+  lfs.cache.Read(address, static_cast<uint8_t*>(buffer), size);
   return 0;
 }
 
@@ -147,12 +187,83 @@ int FS::SectorRead(const struct lfs_config* c, lfs_block_t block, lfs_off_t off,
 */
 
 namespace {
+  // The font and image loaders read a few bytes at a time (the glyph descriptions are read byte by byte) : the reads
+  // smaller than the buffer are served from it, and it's refilled by a single read of readAheadSize bytes
+  constexpr uint32_t readAheadSize = 128;
+
+  struct ReadAhead {
+    uint32_t start;
+    uint32_t length;
+    uint8_t data[readAheadSize];
+  };
+
+  // A file opened by LVGL. The littlefs file is only seeked when the next read isn't at its current position.
+  struct LvglFile {
+    lfs_file_t file;
+    uint32_t position;
+    uint32_t filePosition;
+    ReadAhead readAhead;
+  };
+
+  // Resources ("R:" paths) are read from the resource pack, or from the file of the same path if the pack doesn't
+  // contain them
+  struct ResourceFile {
+    bool inPack;
+    ResourcePack::Resource resource;
+    LvglFile lvglFile;
+  };
+
+  // Reads btr bytes at position from the buffer, or from source(offset, buffer, size) which returns the number of
+  // bytes read or a negative value on error.
+  template <typename Source>
+  lv_fs_res_t ReadAheadRead(LvglFile& file, uint8_t* buf, uint32_t btr, uint32_t* br, Source source) {
+    ReadAhead& readAhead = file.readAhead;
+    *br = 0;
+    while (btr > 0) {
+      if (file.position >= readAhead.start && file.position < readAhead.start + readAhead.length) {
+        uint32_t size = std::min(btr, readAhead.start + readAhead.length - file.position);
+        std::memcpy(buf, readAhead.data + (file.position - readAhead.start), size);
+        buf += size;
+        btr -= size;
+        file.position += size;
+        *br += size;
+        continue;
+      }
+
+      if (btr >= readAheadSize) {
+        int result = source(file.position, buf, btr);
+        if (result < 0) {
+          return LV_FS_RES_FS_ERR;
+        }
+        file.position += result;
+        *br += result;
+        break;
+      }
+
+      int result = source(file.position, readAhead.data, readAheadSize);
+      if (result < 0) {
+        return LV_FS_RES_FS_ERR;
+      }
+      readAhead.start = file.position;
+      readAhead.length = result;
+      if (result == 0) {
+        // End of the file
+        break;
+      }
+    }
+    return LV_FS_RES_OK;
+  }
+
   lv_fs_res_t lvglOpen(lv_fs_drv_t* drv, void* file_p, const char* path, lv_fs_mode_t /*mode*/) {
-    lfs_file_t* file = static_cast<lfs_file_t*>(file_p);
+    LvglFile* file = static_cast<LvglFile*>(file_p);
     FS* filesys = static_cast<FS*>(drv->user_data);
-    int res = filesys->FileOpen(file, path, LFS_O_RDONLY);
+    file->position = 0;
+    file->filePosition = 0;
+    file->readAhead.start = 0;
+    file->readAhead.length = 0;
+    int res = filesys->FileOpen(&file->file, path, LFS_O_RDONLY);
     if (res == 0) {
-      if (file->type == 0) {
+      if (file->file.type == 0) {
         return LV_FS_RES_FS_ERR;
       } else {
         return LV_FS_RES_OK;
@@ -163,24 +274,115 @@ namespace {
 
   lv_fs_res_t lvglClose(lv_fs_drv_t* drv, void* file_p) {
     FS* filesys = static_cast<FS*>(drv->user_data);
-    lfs_file_t* file = static_cast<lfs_file_t*>(file_p);
-    filesys->FileClose(file);
+    LvglFile* file = static_cast<LvglFile*>(file_p);
+    filesys->FileClose(&file->file);
 
     return LV_FS_RES_OK;
   }
 
   lv_fs_res_t lvglRead(lv_fs_drv_t* drv, void* file_p, void* buf, uint32_t btr, uint32_t* br) {
     FS* filesys = static_cast<FS*>(drv->user_data);
-    lfs_file_t* file = static_cast<lfs_file_t*>(file_p);
-    filesys->FileRead(file, static_cast<uint8_t*>(buf), btr);
-    *br = btr;
+    LvglFile* file = static_cast<LvglFile*>(file_p);
+    auto source = [filesys, file](uint32_t offset, uint8_t* buffer, uint32_t size) {
+      if (offset != file->filePosition) {
+        if (filesys->FileSeek(&file->file, offset) < 0) {
+          return -1;
+        }
+        file->filePosition = offset;
+      }
+      int result = filesys->FileRead(&file->file, buffer, size);
+      if (result > 0) {
+        file->filePosition += result;
+      }
+      return result;
+    };
+    return ReadAheadRead(*file, static_cast<uint8_t*>(buf), btr, br, source);
+  }
+
+  lv_fs_res_t lvglSeek(lv_fs_drv_t* /*drv*/, void* file_p, uint32_t pos) {
+    LvglFile* file = static_cast<LvglFile*>(file_p);
+    file->position = pos;
+    return LV_FS_RES_OK;
+  }
+
+  lv_fs_res_t lvglTell(lv_fs_drv_t* /*drv*/, void* file_p, uint32_t* pos_p) {
+    LvglFile* file = static_cast<LvglFile*>(file_p);
+    *pos_p = file->position;
+    return LV_FS_RES_OK;
+  }
+
+  lv_fs_res_t lvglSize(lv_fs_drv_t* drv, void* file_p, uint32_t* size_p) {
+    FS* filesys = static_cast<FS*>(drv->user_data);
+    LvglFile* file = static_cast<LvglFile*>(file_p);
+    int size = filesys->FileSize(&file->file);
+    if (size < 0) {
+      return LV_FS_RES_FS_ERR;
+    }
+    *size_p = size;
     return LV_FS_RES_OK;
   }
 
-  lv_fs_res_t lvglSeek(lv_fs_drv_t* drv, void* file_p, uint32_t pos) {
+  lv_fs_res_t lvglResourceOpen(lv_fs_drv_t* drv, void* file_p, const char* path, lv_fs_mode_t mode) {
+    ResourceFile* file = static_cast<ResourceFile*>(file_p);
     FS* filesys = static_cast<FS*>(drv->user_data);
-    lfs_file_t* file = static_cast<lfs_file_t*>(file_p);
-    filesys->FileSeek(file, pos);
+    ResourcePack& pack = filesys->GetResourcePack();
+    file->inPack = false;
+    if (pack.Open()) {
+      if (pack.Find(path, file->resource)) {
+        file->inPack = true;
+        file->lvglFile.position = 0;
+        file->lvglFile.readAhead.start = 0;
+        file->lvglFile.readAhead.length = 0;
+        return LV_FS_RES_OK;
+      }
+      pack.Close();
+    }
+    return lvglOpen(drv, &file->lvglFile, path, mode);
+  }
+
+  lv_fs_res_t lvglResourceClose(lv_fs_drv_t* drv, void* file_p) {
+    ResourceFile* file = static_cast<ResourceFile*>(file_p);
+    FS* filesys = static_cast<FS*>(drv->user_data);
+    if (!file->inPack) {
+      return lvglClose(drv, &file->lvglFile);
+    }
+    filesys->GetResourcePack().Close();
+    return LV_FS_RES_OK;
+  }
+
+  lv_fs_res_t lvglResourceRead(lv_fs_drv_t* drv, void* file_p, void* buf, uint32_t btr, uint32_t* br) {
+    ResourceFile* file = static_cast<ResourceFile*>(file_p);
+    FS* filesys = static_cast<FS*>(drv->user_data);
+    if (!file->inPack) {
+      return lvglRead(drv, &file->lvglFile, buf, btr, br);
+    }
+    const auto& resource = file->resource;
+    auto source = [filesys, &resource](uint32_t offset, uint8_t* buffer, uint32_t size) {
+      size = (offset < resource.size) ? std::min(size, resource.size - offset) : 0;
+      if (size > 0 && !filesys->GetResourcePack().Read(resource.offset + offset, buffer, size)) {
+        return -1;
+      }
+      return static_cast<int>(size);
+    };
+    return ReadAheadRead(file->lvglFile, static_cast<uint8_t*>(buf), btr, br, source);
+  }
+
+  lv_fs_res_t lvglResourceSeek(lv_fs_drv_t* drv, void* file_p, uint32_t pos) {
+    ResourceFile* file = static_cast<ResourceFile*>(file_p);
+    return lvglSeek(drv, &file->lvglFile, pos);
+  }
+
+  lv_fs_res_t lvglResourceTell(lv_fs_drv_t* drv, void* file_p, uint32_t* pos_p) {
+    ResourceFile* file = static_cast<ResourceFile*>(file_p);
+    return lvglTell(drv, &file->lvglFile, pos_p);
+  }
+
+  lv_fs_res_t lvglResourceSize(lv_fs_drv_t* drv, void* file_p, uint32_t* size_p) {
+    ResourceFile* file = static_cast<ResourceFile*>(file_p);
+    if (!file->inPack) {
+      return lvglSize(drv, &file->lvglFile, size_p);
+    }
+    *size_p = file->resource.size;
     return LV_FS_RES_OK;
   }
 }
@@ -190,14 +392,32 @@ void FS::LVGLFileSystemInit() {
   lv_fs_drv_t fs_drv;
   lv_fs_drv_init(&fs_drv);
 
-  fs_drv.file_size = sizeof(lfs_file_t);
+  fs_drv.file_size = sizeof(LvglFile);
   fs_drv.letter = 'F';
   fs_drv.open_cb = lvglOpen;
   fs_drv.close_cb = lvglClose;
   fs_drv.read_cb = lvglRead;
   fs_drv.seek_cb = lvglSeek;
+  fs_drv.tell_cb = lvglTell;
+  fs_drv.size_cb = lvglSize;
 
   fs_drv.user_data = this;
 
   lv_fs_drv_register(&fs_drv);
+
+  lv_fs_drv_t resource_drv;
+  lv_fs_drv_init(&resource_drv);
+
+  resource_drv.file_size = sizeof(ResourceFile);
+  resource_drv.letter = 'R';
+  resource_drv.open_cb = lvglResourceOpen;
+  resource_drv.close_cb = lvglResourceClose;
+  resource_drv.read_cb = lvglResourceRead;
+  resource_drv.seek_cb = lvglResourceSeek;
+  resource_drv.tell_cb = lvglResourceTell;
+  resource_drv.size_cb = lvglResourceSize;
+
+  resource_drv.user_data = this;
+
+  lv_fs_drv_register(&resource_drv);
 }
@@ -2,6 +2,8 @@
 
 #include <cstdint>
 #include "drivers/SpiNorFlash.h"
+#include "components/fs/FlashCache.h"
+#include "components/fs/ResourcePack.h"
 #include <littlefs/lfs.h>
 
 namespace Pinetime {
@@ -18,6 +20,7 @@ namespace Pinetime {
       int FileRead(lfs_file_t* file_p, uint8_t* buff, uint32_t size);
       int FileWrite(lfs_file_t* file_p, const uint8_t* buff, uint32_t size);
       int FileSeek(lfs_file_t* file_p, uint32_t pos);
+      int FileSize(lfs_file_t* file_p);
 
       int FileDelete(const char* fileName);
 
@@ -31,6 +34,16 @@ namespace Pinetime {
       int Rename(const char* oldPath, const char* newPath);
       int Stat(const char* path, lfs_info* info);
       void VerifyResource();
+      // True if the resource (font or image) is in the resource pack, or in a file (resources installed by older versions)
+      bool ResourceExists(const char* path);
+
+      ResourcePack& GetResourcePack() {
+        return resourcePack;
+      }
+
+      const FlashCache::Statistics& GetCacheStatistics() const {
+        return cache.GetStatistics();
+      }
 
       static size_t getSize() {
         return size;
@@ -42,6 +55,8 @@ namespace Pinetime {
 
     private:
       Pinetime::Drivers::SpiNorFlash& flashDriver;
+      FlashCache cache;
+      ResourcePack resourcePack;
 
       /*
        * External Flash MAP (4 MBytes)
@@ -0,0 +1,93 @@
+#include "components/fs/FlashCache.h"
+#include <algorithm>
+#include <cstring>
+#include "drivers/SpiNorFlash.h"
+
+using namespace Pinetime::Controllers;
+
+FlashCache::FlashCache(Pinetime::Drivers::SpiNorFlash& flashDriver) : flashDriver {flashDriver} {
+}
+
+void FlashCache::Read(uint32_t address, uint8_t* buffer, size_t size) {
+  if (size >= pageSize) {
+    // Received by DMA directly in the buffer of the caller. The cache is written through, so the flash memory
+    // is always up to date.
+    statistics.bypasses++;
+    flashDriver.Read(address, buffer, size);
+    return;
+  }
+
+  while (size > 0) {
+    uint32_t pageNumber = address / pageSize;
+    size_t offset = address % pageSize;
+    size_t toCopy = std::min(size, pageSize - offset);
+
+    Page* page = Find(pageNumber);
+    if (page != nullptr) {
+      statistics.hits++;
+    } else {
+      statistics.misses++;
+      page = &Load(pageNumber);
+      if (pageNumber == lastMissedPage + 1 && Find(pageNumber + 1) == nullptr) {
+        // Sequential reads (directory walks, file contents) : the next page will be needed soon
+        statistics.prefetches++;
+        Load(pageNumber + 1);
+      }
+      lastMissedPage = pageNumber;
+    }
+    page->lastUse = ++useCounter;
+
+    std::memcpy(buffer, page->data + offset, toCopy);
+    address += toCopy;
+    buffer += toCopy;
+    size -= toCopy;
+  }
+}
+
+void FlashCache::Write(uint32_t address, const uint8_t* buffer, size_t size) {
+  flashDriver.WriteBehind(address, buffer, size);
+
+  for (auto& page : pages) {
+    if (page.number == invalidPage) {
+      continue;
+    }
+    uint32_t pageStart = page.number * pageSize;
+    uint32_t start = std::max(address, pageStart);
+    uint32_t end = std::min(address + size, pageStart + pageSize);
+    // Programming can only clear bits
+    for (uint32_t i = start; i < end; i++) {
+      page.data[i - pageStart] &= buffer[i - address];
+    }
+  }
+}
+
+void FlashCache::Invalidate(uint32_t address, size_t size) {
+  uint32_t firstPage = address / pageSize;
+  uint32_t lastPage = (address + size - 1) / pageSize;
+  for (auto& page : pages) {
+    if (page.number != invalidPage && page.number >= firstPage && page.number <= lastPage) {
+      page.number = invalidPage;
+      page.lastUse = 0;
+    }
+  }
+}
+
+FlashCache::Page* FlashCache::Find(uint32_t pageNumber) {
+  for (auto& page : pages) {
+    if (page.number == pageNumber) {
+      return &page;
+    }
+  }
+  return nullptr;
+}
+
+FlashCache::Page& FlashCache::Load(uint32_t pageNumber) {
+  // Invalid pages are not used anymore (lastUse is 0) : they are evicted first
+  auto& page = *std::min_element(pages.begin(), pages.end(), [](const Page& a, const Page& b) {
+    return a.lastUse < b.lastUse;
+  });
+  page.number = pageNumber;
+  page.lastUse = ++useCounter;
+  flashDriver.Read(pageNumber * pageSize, page.data, pageSize);
+  return page;
+}
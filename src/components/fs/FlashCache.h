@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace Pinetime {
+  namespace Drivers {
+    class SpiNorFlash;
+  }
+
+  namespace Controllers {
+    // LRU cache of 256 bytes pages of the external flash memory, between littlefs and SpiNorFlash.
+    // littlefs reads metadata by 16 bytes : each miss reads the whole page instead, and the next one too when
+    // the pages are read sequentially. Large reads bypass the cache. Writes go to the write-behind queue of
+    // SpiNorFlash (which gathers consecutive writes) and update the cached pages, erases invalidate them.
+    class FlashCache {
+    public:
+      struct Statistics {
+        uint32_t hits = 0;
+        uint32_t misses = 0;
+        uint32_t prefetches = 0;
+        uint32_t bypasses = 0;
+      };
+
+      explicit FlashCache(Pinetime::Drivers::SpiNorFlash& flashDriver);
+      FlashCache(const FlashCache&) = delete;
+      FlashCache& operator=(const FlashCache&) = delete;
+      FlashCache(FlashCache&&) = delete;
+      FlashCache& operator=(FlashCache&&) = delete;
+
+      void Read(uint32_t address, uint8_t* buffer, size_t size);
+      void Write(uint32_t address, const uint8_t* buffer, size_t size);
+      void Invalidate(uint32_t address, size_t size);
+
+      const Statistics& GetStatistics() const {
+        return statistics;
+      }
+
+    private:
+      static constexpr size_t pageSize = 256;
+      static constexpr size_t nbPages = 4;
+      static constexpr uint32_t invalidPage = 0xffffffff;
+
+      struct Page {
+        uint32_t number = invalidPage;
+        uint32_t lastUse = 0;
+        uint8_t data[pageSize];
+      };
+
+      Page* Find(uint32_t pageNumber);
+      Page& Load(uint32_t pageNumber);
+
+      Pinetime::Drivers::SpiNorFlash& flashDriver;
+      std::array<Page, nbPages> pages;
+      uint32_t useCounter = 0;
+      uint32_t lastMissedPage = invalidPage;
+      Statistics statistics;
+    };
+  }
+}
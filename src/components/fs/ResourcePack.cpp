@@ -0,0 +1,100 @@
+#include "components/fs/ResourcePack.h"
+#include "components/fs/FS.h"
+#include "components/utility/Crc32.h"
+#include <cstring>
+
+using namespace Pinetime::Controllers;
+
+ResourcePack::ResourcePack(Pinetime::Controllers::FS& fs) : fs {fs} {
+}
+
+bool ResourcePack::Open() {
+  if (openCount == 0 && !Load()) {
+    return false;
+  }
+  openCount++;
+  return true;
+}
+
+void ResourcePack::Close() {
+  if (openCount > 0 && --openCount == 0) {
+    fs.FileClose(&file);
+  }
+}
+
+bool ResourcePack::Load() {
+  // The header is read again each time the file is opened : the pack may have been replaced in the meantime
+  lfs_info info;
+  if (fs.Stat(fileName, &info) != LFS_ERR_OK || fs.FileOpen(&file, fileName, LFS_O_RDONLY) != LFS_ERR_OK) {
+    return false;
+  }
+
+  bool valid = Read(0, reinterpret_cast<uint8_t*>(&header), sizeof(Header)) && header.magic == magic &&
+               header.version == version && header.packSize == info.size && header.nbBuckets > 0 &&
+               (header.nbBuckets & (header.nbBuckets - 1)) == 0 && header.nbResources < header.nbBuckets;
+  if (valid && !(checked && checkedSize == info.size && checkedCrc == header.directoryCrc)) {
+    valid = CheckDirectory();
+    checked = valid;
+    checkedSize = info.size;
+    checkedCrc = header.directoryCrc;
+  }
+
+  if (!valid) {
+    fs.FileClose(&file);
+    header = {};
+  }
+  return valid;
+}
+
+bool ResourcePack::CheckDirectory() {
+  const uint32_t dataOffset = sizeof(Header) + (header.nbBuckets * sizeof(Entry));
+  uint32_t crc = 0;
+  for (size_t bucket = 0; bucket < header.nbBuckets; bucket++) {
+    Entry entry;
+    if (!ReadEntry(bucket, entry)) {
+      return false;
+    }
+    crc = Pinetime::Utility::Crc32(crc, reinterpret_cast<const uint8_t*>(&entry), sizeof(Entry));
+    // Each resource must be in the pack (an offset of 0 is an empty bucket)
+    if (entry.offset != 0 &&
+        (entry.offset < dataOffset || entry.offset > header.packSize || entry.size > header.packSize - entry.offset)) {
+      return false;
+    }
+  }
+  return crc == header.directoryCrc;
+}
+
+bool ResourcePack::Find(const char* path, Resource& resource) {
+  // Open addressing : the entry is in the bucket of its hash, or in one of the next ones
+  const uint32_t hash = Hash(path);
+  const uint32_t pathCrc = Pinetime::Utility::Crc32(0, reinterpret_cast<const uint8_t*>(path), std::strlen(path));
+  const size_t mask = header.nbBuckets - 1;
+  for (size_t i = 0; i < header.nbBuckets; i++) {
+    Entry entry;
+    if (!ReadEntry((hash + i) & mask, entry) || entry.offset == 0) {
+      return false;
+    }
+    if (entry.hash == hash && entry.pathCrc == pathCrc) {
+      resource = {entry.offset, entry.size};
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ResourcePack::ReadEntry(size_t bucket, Entry& entry) {
+  return Read(sizeof(Header) + (bucket * sizeof(Entry)), reinterpret_cast<uint8_t*>(&entry), sizeof(Entry));
+}
+
+bool ResourcePack::Read(uint32_t offset, uint8_t* buffer, size_t size) {
+  return fs.FileSeek(&file, offset) >= 0 && fs.FileRead(&file, buffer, size) == static_cast<int>(size);
+}
+
+uint32_t ResourcePack::Hash(const char* path) {
+  // FNV-1a
+  uint32_t hash = 0x811c9dc5;
+  for (; *path != '\0'; path++) {
+    hash = (hash ^ static_cast<uint8_t>(*path)) * 0x01000193;
+  }
+  return hash;
+}
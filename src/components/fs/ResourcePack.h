@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <littlefs/lfs.h>
+
+namespace Pinetime {
+  namespace Controllers {
+    class FS;
+
+    // Read-only pack of the fonts and images, generated by generate-package.py (--pack) and uploaded as a single
+    // file in the file system.
+    //
+    // The pack starts with a header, followed by a hash table (the directory) that gives the offset and the size of
+    // each resource, and the resources. A resource is found by hashing its path and reading its entry in the
+    // directory : there's no directory walk in littlefs, and the resources are read from the pack file at absolute
+    // offsets. Each entry also holds the CRC32 of its path, so that 2 paths with the same hash can't be mixed up.
+    //
+    // The file is kept open while resources are open (Open() and Close() are counted). The directory is checked
+    // once : it's checked again only if the size of the file or the CRC of the directory in the header change.
+    class ResourcePack {
+    public:
+      struct Resource {
+        uint32_t offset;
+        uint32_t size;
+      };
+
+      static constexpr const char* fileName = "/resources.pack";
+
+      explicit ResourcePack(Pinetime::Controllers::FS& fs);
+      ResourcePack(const ResourcePack&) = delete;
+      ResourcePack& operator=(const ResourcePack&) = delete;
+      ResourcePack(ResourcePack&&) = delete;
+      ResourcePack& operator=(ResourcePack&&) = delete;
+
+      // Opens the pack file and checks its header and its directory. Returns false if there's no valid pack.
+      bool Open();
+      void Close();
+
+      // The pack must be open
+      bool Find(const char* path, Resource& resource);
+      bool Read(uint32_t offset, uint8_t* buffer, size_t size);
+
+      size_t NbResources() const {
+        return header.nbResources;
+      }
+
+    private:
+      static constexpr uint32_t magic = 0x31505249; // "IRP1"
+      static constexpr uint16_t version = 2;
+
+      struct Header {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t nbBuckets;
+        uint16_t nbResources;
+        uint16_t reserved;
+        uint32_t packSize;
+        uint32_t directoryCrc;
+      };
+
+      struct Entry {
+        uint32_t hash;
+        uint32_t pathCrc;
+        uint32_t offset;
+        uint32_t size;
+      };
+
+      bool Load();
+      bool CheckDirectory();
+      bool ReadEntry(size_t bucket, Entry& entry);
+      static uint32_t Hash(const char* path);
+
+      Pinetime::Controllers::FS& fs;
+      lfs_file_t file;
+      size_t openCount = 0;
+      Header header {};
+
+      // Pack of the last successful check of the directory
+      bool checked = false;
+      uint32_t checkedSize = 0;
+      uint32_t checkedCrc = 0;
+    };
+  }
+}
@@ -0,0 +1,297 @@
+#include "components/kvstore/KeyValueStore.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <libraries/log/nrf_log.h>
+#include "components/fs/FS.h"
+#include "components/utility/Crc32.h"
+
+using namespace Pinetime::Controllers;
+using Pinetime::Utility::Crc32;
+
+namespace {
+  constexpr uint32_t logMagic = 0x4b565302;
+  // Values are read and written by chunks to keep the stack usage low
+  constexpr size_t chunkSize = 32;
+  constexpr const char* logFileName = "/kvstore.dat";
+  // The compacted log, renamed to logFileName once it's complete
+  constexpr const char* compactedFileName = "/kvstore.tmp";
+  // Files written by older versions
+  constexpr const char* fileNames[] = {"/settings.dat", "/bond.dat", "/dfu.dat"};
+
+  bool ReadAt(FS& fs, lfs_file_t& file, uint32_t offset, void* data, size_t size) {
+    return fs.FileSeek(&file, offset) >= 0 && fs.FileRead(&file, static_cast<uint8_t*>(data), size) == static_cast<int>(size);
+  }
+
+  bool WriteData(FS& fs, lfs_file_t& file, const void* data, size_t size) {
+    return fs.FileWrite(&file, static_cast<const uint8_t*>(data), size) == static_cast<int>(size);
+  }
+}
+
+KeyValueStore::KeyValueStore(Pinetime::Controllers::FS& fs) : fs {fs} {
+}
+
+void KeyValueStore::Init() {
+  if (mutex == nullptr) {
+    mutex = xSemaphoreCreateMutex();
+    ASSERT(mutex != nullptr);
+  }
+
+  // A compaction was interrupted before the rename : the log is still complete
+  fs.FileDelete(compactedFileName);
+  LoadIndex();
+  for (size_t key = 0; key < nbKeys; key++) {
+    if (index[key].size == 0) {
+      ImportLegacyFile(static_cast<Keys>(key));
+    }
+  }
+  NRF_LOG_INFO("[KeyValueStore] %d bytes used", logSize);
+}
+
+void KeyValueStore::LoadIndex() {
+  lfs_file_t file;
+  if (fs.FileOpen(&file, logFileName, LFS_O_RDONLY) != LFS_ERR_OK) {
+    CreateLog();
+    return;
+  }
+  uint32_t magic;
+  const int fileSize = fs.FileSize(&file);
+  if (!ReadAt(fs, file, 0, &magic, sizeof(magic)) || magic != logMagic) {
+    fs.FileClose(&file);
+    CreateLog();
+    return;
+  }
+
+  size_t offset = sizeof(magic);
+  bool corrupted = false;
+  uint8_t chunk[chunkSize];
+  while (static_cast<int>(offset) < fileSize) {
+    RecordHeader header;
+    if (!ReadAt(fs, file, offset, &header, sizeof(RecordHeader)) || static_cast<int>(offset + RecordSize(header.size)) > fileSize) {
+      corrupted = true;
+      break;
+    }
+    uint32_t crc = Crc32(0, reinterpret_cast<const uint8_t*>(&header), offsetof(RecordHeader, crc));
+    for (size_t read = 0; read < header.size; read += chunkSize) {
+      size_t length = std::min(chunkSize, header.size - read);
+      if (fs.FileRead(&file, chunk, length) != static_cast<int>(length)) {
+        break;
+      }
+      crc = Crc32(crc, chunk, length);
+    }
+    if (crc != header.crc) {
+      corrupted = true;
+      break;
+    }
+    // The keys of a newer version (before a downgrade) are skipped, and dropped by the next compaction
+    if (header.key < nbKeys) {
+      index[header.key] = {static_cast<uint16_t>(offset + sizeof(RecordHeader)), header.size};
+    }
+    offset += RecordSize(header.size);
+  }
+  fs.FileClose(&file);
+  logSize = offset;
+
+  if (corrupted) {
+    // The records before are kept. Nothing is appended after the corrupted record : if the compaction fails, the next
+    // update starts with another one.
+    NRF_LOG_INFO("[KeyValueStore] Corrupted record at offset %d", offset);
+    logSize = maxLogSize;
+    Compact(0);
+  }
+}
+
+bool KeyValueStore::CreateLog() {
+  lfs_file_t file;
+  if (fs.FileOpen(&file, logFileName, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) != LFS_ERR_OK) {
+    return false;
+  }
+  const bool written = WriteData(fs, file, &logMagic, sizeof(logMagic));
+  if (fs.FileClose(&file) != LFS_ERR_OK || !written) {
+    return false;
+  }
+  index = {};
+  logSize = sizeof(logMagic);
+  return true;
+}
+
+size_t KeyValueStore::Read(Keys key, void* value, size_t size) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  const auto entry = index[static_cast<size_t>(key)];
+  bool read = false;
+  lfs_file_t file;
+  if (entry.size > 0 && fs.FileOpen(&file, logFileName, LFS_O_RDONLY) == LFS_ERR_OK) {
+    read = ReadAt(fs, file, entry.offset, value, std::min<size_t>(size, entry.size));
+    fs.FileClose(&file);
+  }
+  xSemaphoreGive(mutex);
+  return read ? entry.size : 0;
+}
+
+bool KeyValueStore::Write(Keys key, const void* value, size_t size) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  bool result = Equals(key, value, size);
+  if (!result) {
+    result = Append(key, size, [value](size_t offset, uint8_t* chunk, size_t chunkSize) {
+      std::memcpy(chunk, static_cast<const uint8_t*>(value) + offset, chunkSize);
+      return true;
+    });
+  }
+  xSemaphoreGive(mutex);
+  return result;
+}
+
+void KeyValueStore::Delete(Keys key) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (index[static_cast<size_t>(key)].size > 0) {
+    // A record without value
+    Append(key, 0, [](size_t /*offset*/, uint8_t* /*chunk*/, size_t /*chunkSize*/) {
+      return true;
+    });
+  }
+  xSemaphoreGive(mutex);
+}
+
+bool KeyValueStore::Equals(Keys key, const void* value, size_t size) {
+  const auto& entry = index[static_cast<size_t>(key)];
+  if (entry.size != size) {
+    return false;
+  }
+  lfs_file_t file;
+  if (fs.FileOpen(&file, logFileName, LFS_O_RDONLY) != LFS_ERR_OK) {
+    return false;
+  }
+  bool equals = true;
+  uint8_t chunk[chunkSize];
+  for (size_t offset = 0; offset < size && equals; offset += chunkSize) {
+    size_t length = std::min(chunkSize, size - offset);
+    equals = ReadAt(fs, file, entry.offset + offset, chunk, length) &&
+             std::memcmp(chunk, static_cast<const uint8_t*>(value) + offset, length) == 0;
+  }
+  fs.FileClose(&file);
+  return equals;
+}
+
+template <typename Source>
+bool KeyValueStore::Append(Keys key, size_t size, Source source) {
+  // source(offset, chunk, length) copies length bytes of the value, starting at offset, into chunk, and returns false
+  // if they can't be read. It's called twice for each chunk : to compute the CRC, and to write the value.
+  if (RecordSize(size) > maxLogSize - sizeof(logMagic)) {
+    return false;
+  }
+  if (logSize + RecordSize(size) > maxLogSize && !Compact(RecordSize(size))) {
+    return false;
+  }
+
+  RecordHeader header {static_cast<uint8_t>(key), 0xff, static_cast<uint16_t>(size), 0};
+  uint8_t chunk[chunkSize];
+  header.crc = Crc32(0, reinterpret_cast<const uint8_t*>(&header), offsetof(RecordHeader, crc));
+  for (size_t copied = 0; copied < size; copied += chunkSize) {
+    size_t length = std::min(chunkSize, size - copied);
+    if (!source(copied, chunk, length)) {
+      return false;
+    }
+    header.crc = Crc32(header.crc, chunk, length);
+  }
+
+  lfs_file_t file;
+  if (fs.FileOpen(&file, logFileName, LFS_O_WRONLY | LFS_O_APPEND) != LFS_ERR_OK) {
+    return false;
+  }
+  // Appended at the end of the file
+  const int recordOffset = fs.FileSize(&file);
+  bool written = recordOffset >= 0 && WriteData(fs, file, &header, sizeof(RecordHeader));
+  for (size_t copied = 0; copied < size && written; copied += chunkSize) {
+    size_t length = std::min(chunkSize, size - copied);
+    written = source(copied, chunk, length) && WriteData(fs, file, chunk, length);
+  }
+  // The record is committed when the file is closed
+  if (fs.FileClose(&file) != LFS_ERR_OK || !written) {
+    // The previous value is kept. A part of the record may have been committed : the next update starts with a
+    // compaction, which only copies the records of the index.
+    NRF_LOG_INFO("[KeyValueStore] Write failed at offset %d", logSize);
+    logSize = maxLogSize;
+    return false;
+  }
+
+  index[static_cast<size_t>(key)] = {static_cast<uint16_t>(recordOffset + sizeof(RecordHeader)), static_cast<uint16_t>(size)};
+  logSize = recordOffset + RecordSize(size);
+  return true;
+}
+
+bool KeyValueStore::Compact(size_t extraSize) {
+  size_t usedSize = sizeof(logMagic) + extraSize;
+  for (const auto& entry : index) {
+    if (entry.size > 0) {
+      usedSize += RecordSize(entry.size);
+    }
+  }
+  if (usedSize > maxLogSize) {
+    return false;
+  }
+
+  lfs_file_t log;
+  lfs_file_t compacted;
+  if (fs.FileOpen(&log, logFileName, LFS_O_RDONLY) != LFS_ERR_OK) {
+    return false;
+  }
+  if (fs.FileOpen(&compacted, compactedFileName, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) != LFS_ERR_OK) {
+    fs.FileClose(&log);
+    return false;
+  }
+
+  // The newest record of each key is copied with its header and CRC
+  std::array<IndexEntry, nbKeys> newIndex;
+  size_t offset = sizeof(logMagic);
+  uint8_t chunk[chunkSize];
+  bool written = WriteData(fs, compacted, &logMagic, sizeof(logMagic));
+  for (size_t key = 0; key < nbKeys && written; key++) {
+    const auto& entry = index[key];
+    if (entry.size == 0) {
+      continue;
+    }
+    uint32_t source = entry.offset - sizeof(RecordHeader);
+    size_t recordSize = RecordSize(entry.size);
+    for (size_t copied = 0; copied < recordSize && written; copied += chunkSize) {
+      size_t length = std::min(chunkSize, recordSize - copied);
+      written = ReadAt(fs, log, source + copied, chunk, length) && WriteData(fs, compacted, chunk, length);
+    }
+    newIndex[key] = {static_cast<uint16_t>(offset + sizeof(RecordHeader)), entry.size};
+    offset += recordSize;
+  }
+  fs.FileClose(&log);
+
+  // The new log replaces the old one when it's renamed. Until then, the old log and the index are kept.
+  if (fs.FileClose(&compacted) != LFS_ERR_OK || !written || fs.Rename(compactedFileName, logFileName) != LFS_ERR_OK) {
+    NRF_LOG_INFO("[KeyValueStore] Compaction failed");
+    fs.FileDelete(compactedFileName);
+    return false;
+  }
+
+  NRF_LOG_INFO("[KeyValueStore] Compacted from %d to %d bytes", logSize, offset);
+  logSize = offset;
+  index = newIndex;
+  return true;
+}
+
+void KeyValueStore::ImportLegacyFile(Keys key) {
+  const char* fileName = fileNames[static_cast<size_t>(key)];
+  lfs_info info;
+  if (fs.Stat(fileName, &info) != LFS_ERR_OK || info.size == 0) {
+    return;
+  }
+
+  lfs_file_t file;
+  if (fs.FileOpen(&file, fileName, LFS_O_RDONLY) != LFS_ERR_OK) {
+    return;
+  }
+  bool imported = Append(key, info.size, [this, &file](size_t offset, uint8_t* chunk, size_t length) {
+    return ReadAt(fs, file, offset, chunk, length);
+  });
+  fs.FileClose(&file);
+
+  if (imported) {
+    NRF_LOG_INFO("[KeyValueStore] Imported %s (%d bytes)", fileName, info.size);
+    fs.FileDelete(fileName);
+  }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <FreeRTOS.h>
+#include <semphr.h>
+
+namespace Pinetime {
+  namespace Controllers {
+    class FS;
+
+    // Small values (settings, bonds, DFU checkpoint) stored in a single log file.
+    //
+    // A value is updated by appending a record (key, length, CRC and data) to the log, and the RAM index points to the
+    // newest record of each key : a value is read in a single access, and an update appends a few bytes to the log
+    // instead of rewriting a file per value. When the log reaches maxLogSize, the newest record of each key is copied
+    // into a new log, which replaces the old one when it's renamed : an interrupted update or compaction leaves the
+    // previous values.
+    class KeyValueStore {
+    public:
+      enum class Keys : uint8_t { Settings, Bond, DfuCheckpoint };
+
+      explicit KeyValueStore(Pinetime::Controllers::FS& fs);
+      KeyValueStore(const KeyValueStore&) = delete;
+      KeyValueStore& operator=(const KeyValueStore&) = delete;
+      KeyValueStore(KeyValueStore&&) = delete;
+      KeyValueStore& operator=(KeyValueStore&&) = delete;
+
+      // Loads the index from the log, and imports the files written by older versions.
+      // The file system must be mounted.
+      void Init();
+
+      // Copies at most size bytes of the value of key into value.
+      // Returns the size of the value, 0 if there's no value for this key.
+      size_t Read(Keys key, void* value, size_t size);
+      // Nothing is written if the value didn't change
+      bool Write(Keys key, const void* value, size_t size);
+      void Delete(Keys key);
+
+    private:
+      static constexpr size_t maxLogSize = 4096;
+      static constexpr size_t nbKeys = 3;
+
+      struct RecordHeader {
+        uint8_t key;
+        uint8_t reserved;
+        uint16_t size;
+        uint32_t crc;
+      };
+
+      struct IndexEntry {
+        uint16_t offset = 0;
+        uint16_t size = 0;
+      };
+
+      static constexpr size_t RecordSize(size_t valueSize) {
+        return sizeof(RecordHeader) + valueSize;
+      }
+
+      void LoadIndex();
+      bool CreateLog();
+      template <typename Source>
+      bool Append(Keys key, size_t size, Source source);
+      bool Compact(size_t extraSize);
+      bool Equals(Keys key, const void* value, size_t size);
+      void ImportLegacyFile(Keys key);
+
+      Pinetime::Controllers::FS& fs;
+      SemaphoreHandle_t mutex = nullptr;
+
+      size_t logSize = 0;
+      std::array<IndexEntry, nbKeys> index;
+    };
+  }
+}
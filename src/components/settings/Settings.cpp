@@ -4,44 +4,35 @@
 
 using namespace Pinetime::Controllers;
 
-Settings::Settings(Pinetime::Controllers::FS& fs) : fs {fs} {
+Settings::Settings(Pinetime::Controllers::KeyValueStore& keyValueStore) : keyValueStore {keyValueStore} {
 }
 
 void Settings::Init() {
 
   // Load default settings from Flash
-  LoadSettingsFromFile();
+  LoadSettingsFromStore();
 }
 
 void Settings::SaveSettings() {
 
   // verify if is necessary to save
   if (settingsChanged) {
-    SaveSettingsToFile();
+    SaveSettingsToStore();
   }
   settingsChanged = false;
 }
 
-void Settings::LoadSettingsFromFile() {
+void Settings::LoadSettingsFromStore() {
   SettingsData bufferSettings;
-  lfs_file_t settingsFile;
 
-  if (fs.FileOpen(&settingsFile, "/settings.dat", LFS_O_RDONLY) != LFS_ERR_OK) {
+  if (keyValueStore.Read(KeyValueStore::Keys::Settings, &bufferSettings, sizeof(bufferSettings)) != sizeof(bufferSettings)) {
     return;
   }
-  fs.FileRead(&settingsFile, reinterpret_cast<uint8_t*>(&bufferSettings), sizeof(settings));
-  fs.FileClose(&settingsFile);
   if (bufferSettings.version == settingsVersion) {
     settings = bufferSettings;
   }
 }
 
-void Settings::SaveSettingsToFile() {
-  lfs_file_t settingsFile;
-
-  if (fs.FileOpen(&settingsFile, "/settings.dat", LFS_O_WRONLY | LFS_O_CREAT) != LFS_ERR_OK) {
-    return;
-  }
-  fs.FileWrite(&settingsFile, reinterpret_cast<uint8_t*>(&settings), sizeof(settings));
-  fs.FileClose(&settingsFile);
+void Settings::SaveSettingsToStore() {
+  keyValueStore.Write(KeyValueStore::Keys::Settings, &settings, sizeof(settings));
 }
@@ -3,6 +3,7 @@
 #include <bitset>
 #include "components/brightness/BrightnessController.h"
 #include "components/fs/FS.h"
+#include "components/kvstore/KeyValueStore.h"
 
 namespace Pinetime {
   namespace Controllers {
@@ -51,7 +52,7 @@ namespace Pinetime {
         int colorIndex = 0;
       };
 
-      Settings(Pinetime::Controllers::FS& fs);
+      Settings(Pinetime::Controllers::KeyValueStore& keyValueStore);
 
       Settings(const Settings&) = delete;
       Settings& operator=(const Settings&) = delete;
@@ -264,7 +265,7 @@ namespace Pinetime {
       };
 
     private:
-      Pinetime::Controllers::FS& fs;
+      Pinetime::Controllers::KeyValueStore& keyValueStore;
 
       static constexpr uint32_t settingsVersion = 0x0004;
 
@@ -299,8 +300,8 @@ namespace Pinetime {
        */
       bool bleRadioEnabled = true;
 
-      void LoadSettingsFromFile();
-      void SaveSettingsToFile();
+      void LoadSettingsFromStore();
+      void SaveSettingsToStore();
     };
   }
 }
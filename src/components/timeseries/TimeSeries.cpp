@@ -0,0 +1,334 @@
+#include "components/timeseries/TimeSeries.h"
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <libraries/log/nrf_log.h>
+#include "components/fs/FS.h"
+
+using namespace Pinetime::Controllers;
+
+namespace {
+  constexpr uint32_t segmentMagic = 0x54534802;
+  constexpr uint32_t maxRecordMinutes = 0x3fff;
+  // Time covered by a segment : the samples of a segment are less than maxRecordMinutes after its start
+  constexpr uint32_t segmentDuration = (maxRecordMinutes + 1) * 60;
+  // Records read at once when a segment is decoded
+  constexpr size_t recordsPerRead = 32;
+  constexpr const char* directory = "/history";
+
+  struct SegmentPath {
+    explicit SegmentPath(size_t segment) {
+      std::snprintf(path, sizeof(path), "%s/%u", directory, static_cast<unsigned>(segment));
+    }
+
+    char path[16];
+  };
+
+  uint32_t EncodeRecord(uint32_t minutes, uint8_t series, int16_t delta) {
+    return minutes | (static_cast<uint32_t>(series) << 14) | (static_cast<uint32_t>(static_cast<uint16_t>(delta)) << 16);
+  }
+
+  bool DecodeRecord(uint32_t record, uint32_t& minutes, uint8_t& series, int16_t& delta) {
+    minutes = record & maxRecordMinutes;
+    series = (record >> 14) & 0x03;
+    delta = static_cast<int16_t>(record >> 16);
+    return series < TimeSeries::nbSeries;
+  }
+
+  bool DeltaFits(int32_t delta) {
+    return delta >= std::numeric_limits<int16_t>::min() && delta <= std::numeric_limits<int16_t>::max();
+  }
+}
+
+TimeSeries::TimeSeries(Pinetime::Controllers::FS& fs) : fs {fs} {
+}
+
+void TimeSeries::Init() {
+  if (mutex == nullptr) {
+    mutex = xSemaphoreCreateMutex();
+    ASSERT(mutex != nullptr);
+  }
+
+  // Fails with LFS_ERR_EXIST after the first boot
+  fs.DirCreate(directory);
+  for (size_t segment = 0; segment < nbSegments; segment++) {
+    SegmentHeader header;
+    lfs_file_t file;
+    auto& info = segments[segment];
+    info.valid = false;
+    if (fs.FileOpen(&file, SegmentPath(segment).path, LFS_O_RDONLY) != LFS_ERR_OK) {
+      continue;
+    }
+    info.valid = fs.FileRead(&file, reinterpret_cast<uint8_t*>(&header), sizeof(SegmentHeader)) == sizeof(SegmentHeader) &&
+                 header.magic == segmentMagic;
+    fs.FileClose(&file);
+    info.sequence = header.sequence;
+    info.startTime = header.startTime;
+    if (info.valid && (!hasCurrentSegment || info.sequence > segments[currentSegment].sequence)) {
+      hasCurrentSegment = true;
+      currentSegment = segment;
+    }
+  }
+
+  if (hasCurrentSegment) {
+    // Find the end of the newest segment, and the last value of each series
+    currentRecords = DecodeSegment(currentSegment, [this](uint32_t /*record*/, const Sample& sample) {
+      lastValues[static_cast<size_t>(sample.series)] = sample.value;
+      return true;
+    });
+  }
+  NRF_LOG_INFO("[TimeSeries] Current segment %d, %d records", currentSegment, currentRecords);
+}
+
+void TimeSeries::Append(Series series, uint32_t time, int16_t value) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (queueLength == queueSize) {
+    // The oldest sample is dropped
+    std::copy(queue.begin() + 1, queue.end(), queue.begin());
+    queueLength--;
+  }
+  queue[queueLength++] = {time, series, value};
+  xSemaphoreGive(mutex);
+}
+
+bool TimeSeries::NeedsFlush() const {
+  return queueLength >= (queueSize * 3) / 4;
+}
+
+void TimeSeries::Flush() {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  size_t written = 0;
+  while (written < queueLength) {
+    if (!Fits(queue[written], lastValues, currentRecords) && !StartSegment(queue[written])) {
+      break;
+    }
+    size_t end = AppendRecords(written);
+    if (end == written) {
+      break;
+    }
+    written = end;
+  }
+  // The samples that couldn't be written stay in the queue, and are written by the next flush
+  std::copy(queue.begin() + written, queue.begin() + queueLength, queue.begin());
+  queueLength -= written;
+  xSemaphoreGive(mutex);
+}
+
+bool TimeSeries::Fits(const Sample& sample, const int16_t* values, size_t nbRecords) const {
+  if (!hasCurrentSegment || nbRecords == recordsPerSegment) {
+    return false;
+  }
+  uint32_t startTime = segments[currentSegment].startTime;
+  return sample.time >= startTime && (sample.time - startTime) / 60 <= maxRecordMinutes &&
+         DeltaFits(sample.value - values[static_cast<size_t>(sample.series)]);
+}
+
+bool TimeSeries::StartSegment(const Sample& sample) {
+  // The segments are used in turn : once all of them are used, the next one is the oldest one
+  uint32_t sequence = hasCurrentSegment ? segments[currentSegment].sequence + 1 : 0;
+  size_t segment = hasCurrentSegment ? (currentSegment + 1) % nbSegments : 0;
+
+  SegmentHeader header;
+  header.magic = segmentMagic;
+  header.sequence = sequence;
+  header.startTime = sample.time;
+  std::copy(std::begin(lastValues), std::end(lastValues), std::begin(header.baseValues));
+  header.reserved = 0xffff;
+  auto series = static_cast<size_t>(sample.series);
+  if (!DeltaFits(sample.value - lastValues[series])) {
+    // The new segment starts from this value
+    header.baseValues[series] = sample.value;
+  }
+
+  // The samples of the oldest segment are lost, even if the new one can't be written
+  segments[segment].valid = false;
+  lfs_file_t file;
+  if (fs.FileOpen(&file, SegmentPath(segment).path, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) != LFS_ERR_OK) {
+    return false;
+  }
+  bool written = fs.FileWrite(&file, reinterpret_cast<const uint8_t*>(&header), sizeof(SegmentHeader)) == sizeof(SegmentHeader);
+  if (fs.FileClose(&file) != LFS_ERR_OK || !written) {
+    return false;
+  }
+
+  segments[segment] = {true, sequence, sample.time};
+  hasCurrentSegment = true;
+  currentSegment = segment;
+  currentRecords = 0;
+  std::copy(std::begin(header.baseValues), std::end(header.baseValues), std::begin(lastValues));
+  return true;
+}
+
+size_t TimeSeries::AppendRecords(size_t first) {
+  // The samples that fit in the current segment are encoded, and written at once
+  int16_t values[nbSeries];
+  std::copy(std::begin(lastValues), std::end(lastValues), std::begin(values));
+  uint32_t records[queueSize];
+  size_t nbRecords = 0;
+  size_t end = first;
+  uint32_t startTime = segments[currentSegment].startTime;
+  while (end < queueLength && Fits(queue[end], values, currentRecords + nbRecords)) {
+    const Sample& sample = queue[end];
+    auto series = static_cast<size_t>(sample.series);
+    records[nbRecords++] = EncodeRecord((sample.time - startTime) / 60, series, static_cast<int16_t>(sample.value - values[series]));
+    values[series] = sample.value;
+    end++;
+  }
+  if (nbRecords == 0) {
+    return first;
+  }
+
+  lfs_file_t file;
+  if (fs.FileOpen(&file, SegmentPath(currentSegment).path, LFS_O_WRONLY | LFS_O_APPEND) != LFS_ERR_OK) {
+    return first;
+  }
+  const int size = static_cast<int>(nbRecords * recordSize);
+  bool written = fs.FileWrite(&file, reinterpret_cast<const uint8_t*>(records), size) == size;
+  // The records are committed when the file is closed
+  if (fs.FileClose(&file) != LFS_ERR_OK) {
+    return first;
+  }
+  if (!written) {
+    // A part of the records may have been committed : the samples are written again in a new segment
+    currentRecords = recordsPerSegment;
+    return first;
+  }
+
+  currentRecords += nbRecords;
+  std::copy(std::begin(values), std::end(values), std::begin(lastValues));
+  return end;
+}
+
+size_t TimeSeries::SegmentsInOrder(std::array<size_t, nbSegments>& order) const {
+  size_t nbValidSegments = 0;
+  for (size_t segment = 0; segment < nbSegments; segment++) {
+    if (segments[segment].valid) {
+      order[nbValidSegments++] = segment;
+    }
+  }
+  std::sort(order.begin(), order.begin() + nbValidSegments, [this](size_t a, size_t b) {
+    return segments[a].sequence < segments[b].sequence;
+  });
+  return nbValidSegments;
+}
+
+template <typename Visitor>
+size_t TimeSeries::DecodeSegment(size_t segment, Visitor visitor) {
+  // The values are stored as differences : a segment is always decoded from its first record.
+  // Returns the number of records of the segment, or the index of the record after the one that stopped the visit.
+  lfs_file_t file;
+  if (fs.FileOpen(&file, SegmentPath(segment).path, LFS_O_RDONLY) != LFS_ERR_OK) {
+    return 0;
+  }
+  SegmentHeader header;
+  if (fs.FileRead(&file, reinterpret_cast<uint8_t*>(&header), sizeof(SegmentHeader)) != sizeof(SegmentHeader)) {
+    fs.FileClose(&file);
+    return 0;
+  }
+  int16_t values[nbSeries];
+  std::copy(std::begin(header.baseValues), std::end(header.baseValues), std::begin(values));
+
+  uint32_t records[recordsPerRead];
+  size_t index = 0;
+  while (index < recordsPerSegment) {
+    int read = fs.FileRead(&file, reinterpret_cast<uint8_t*>(records), sizeof(records));
+    // A part of a record is ignored
+    size_t count = (read > 0) ? std::min(static_cast<size_t>(read) / recordSize, recordsPerSegment - index) : 0;
+    for (size_t i = 0; i < count; i++) {
+      uint32_t minutes;
+      uint8_t series;
+      int16_t delta;
+      if (!DecodeRecord(records[i], minutes, series, delta)) {
+        fs.FileClose(&file);
+        return index + i;
+      }
+      values[series] += delta;
+      if (!visitor(index + i, Sample {header.startTime + (minutes * 60), static_cast<Series>(series), values[series]})) {
+        fs.FileClose(&file);
+        return index + i + 1;
+      }
+    }
+    index += count;
+    if (count < recordsPerRead) {
+      break;
+    }
+  }
+  fs.FileClose(&file);
+  return index;
+}
+
+void TimeSeries::Aggregate(
+  Series series, uint32_t from, uint32_t bucketDuration, int32_t* buckets, size_t nbBuckets, Aggregation aggregation) {
+  ASSERT(nbBuckets <= maxBuckets);
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  uint16_t counts[maxBuckets] = {};
+  std::fill(buckets, buckets + nbBuckets, 0);
+  uint32_t to = from + (bucketDuration * nbBuckets);
+  auto accumulate = [&](const Sample& sample) {
+    if (sample.series != series || sample.time < from || sample.time >= to) {
+      return;
+    }
+    size_t bucket = (sample.time - from) / bucketDuration;
+    if (aggregation == Aggregation::Max) {
+      buckets[bucket] = std::max(buckets[bucket], static_cast<int32_t>(sample.value));
+    } else {
+      buckets[bucket] += sample.value;
+    }
+    counts[bucket]++;
+  };
+
+  for (size_t segment = 0; segment < nbSegments; segment++) {
+    // The start times of the segments don't always follow their order (the clock can be set back) : every segment
+    // that can overlap [from, to[ is read
+    const auto& info = segments[segment];
+    if (!info.valid || info.startTime >= to || (from > info.startTime && from - info.startTime >= segmentDuration)) {
+      continue;
+    }
+    DecodeSegment(segment, [&accumulate](uint32_t /*record*/, const Sample& sample) {
+      accumulate(sample);
+      return true;
+    });
+  }
+  // Samples that are not written yet
+  for (size_t i = 0; i < queueLength; i++) {
+    accumulate(queue[i]);
+  }
+
+  if (aggregation == Aggregation::Average) {
+    for (size_t bucket = 0; bucket < nbBuckets; bucket++) {
+      if (counts[bucket] > 0) {
+        buckets[bucket] /= counts[bucket];
+      }
+    }
+  }
+  xSemaphoreGive(mutex);
+}
+
+size_t TimeSeries::Export(uint32_t& cursor, Sample* samples, size_t maxSamples) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  size_t nbSamples = 0;
+  std::array<size_t, nbSegments> order;
+  size_t nbValidSegments = SegmentsInOrder(order);
+  for (size_t i = 0; i < nbValidSegments && nbSamples < maxSamples; i++) {
+    uint32_t sequence = segments[order[i]].sequence;
+    uint32_t cursorSequence = cursor >> positionRecordBits;
+    if (sequence < cursorSequence) {
+      continue;
+    }
+    uint32_t firstRecord = (sequence == cursorSequence) ? cursor & ((1U << positionRecordBits) - 1) : 0;
+
+    size_t end = DecodeSegment(order[i], [&](uint32_t record, const Sample& sample) {
+      if (record < firstRecord) {
+        return true;
+      }
+      samples[nbSamples++] = sample;
+      return nbSamples < maxSamples;
+    });
+    // The newest segment may still receive new records
+    bool segmentDone = end == recordsPerSegment && order[i] != currentSegment;
+    cursor = segmentDone ? (sequence + 1) << positionRecordBits : (sequence << positionRecordBits) | std::max<uint32_t>(end, firstRecord);
+  }
+  xSemaphoreGive(mutex);
+  return nbSamples;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <FreeRTOS.h>
+#include <semphr.h>
+
+namespace Pinetime {
+  namespace Controllers {
+    class FS;
+
+    // History of the steps, heart rate and battery level, stored in a ring of segment files.
+    //
+    // Each segment starts with a header (sequence number, start time and the last value of each series), followed by
+    // fixed size records of 4 bytes : the time since the start of the segment (in minutes), the series, and the
+    // difference between the value and the previous value of this series. When the newest segment is full, the oldest
+    // one is overwritten and becomes the newest one.
+    //
+    // The headers of the segments are kept in RAM to find the segments of a time range without reading them.
+    // New samples are queued in RAM and appended by Flush() : littlefs writes a batch of records, not each sample.
+    class TimeSeries {
+    public:
+      enum class Series : uint8_t { Steps, HeartRate, Battery };
+      enum class Aggregation : uint8_t { Sum, Average, Max };
+      static constexpr size_t nbSeries = 3;
+
+      struct Sample {
+        // Seconds since the epoch (local time)
+        uint32_t time;
+        Series series;
+        int16_t value;
+      };
+
+      static constexpr size_t maxBuckets = 24;
+
+      explicit TimeSeries(Pinetime::Controllers::FS& fs);
+      TimeSeries(const TimeSeries&) = delete;
+      TimeSeries& operator=(const TimeSeries&) = delete;
+      TimeSeries(TimeSeries&&) = delete;
+      TimeSeries& operator=(TimeSeries&&) = delete;
+
+      // Loads the headers of the segments. The file system must be mounted.
+      void Init();
+
+      void Append(Series series, uint32_t time, int16_t value);
+      // True when the queue is almost full : the flash memory should be woken up to flush it.
+      bool NeedsFlush() const;
+      // Writes the queued samples. Called by the system task only, while the flash memory is awake.
+      void Flush();
+
+      // Aggregates the samples of series in nbBuckets (at most maxBuckets) consecutive buckets of bucketDuration
+      // seconds, starting at from. Empty buckets are set to 0. The queued samples are included.
+      void Aggregate(Series series, uint32_t from, uint32_t bucketDuration, int32_t* buckets, size_t nbBuckets, Aggregation aggregation);
+
+      // Copies at most maxSamples samples, starting at position cursor (0 for the oldest sample), into samples.
+      // Returns the number of samples copied, and updates cursor to the position of the next sample.
+      // Only the samples written by Flush() are exported.
+      size_t Export(uint32_t& cursor, Sample* samples, size_t maxSamples);
+
+    private:
+      static constexpr size_t nbSegments = 14;
+      static constexpr size_t segmentSize = 4096;
+
+      struct SegmentHeader {
+        uint32_t magic;
+        uint32_t sequence;
+        uint32_t startTime;
+        int16_t baseValues[nbSeries];
+        uint16_t reserved;
+      };
+
+      static constexpr size_t recordSize = sizeof(uint32_t);
+      static constexpr size_t recordsPerSegment = (segmentSize - sizeof(SegmentHeader)) / recordSize;
+      // Export positions : the sequence number of the segment and the index of the record in the segment
+      static constexpr uint8_t positionRecordBits = 10;
+
+      struct SegmentInfo {
+        bool valid = false;
+        uint32_t sequence = 0;
+        uint32_t startTime = 0;
+      };
+
+      template <typename Visitor>
+      size_t DecodeSegment(size_t segment, Visitor visitor);
+      size_t SegmentsInOrder(std::array<size_t, nbSegments>& order) const;
+      bool Fits(const Sample& sample, const int16_t* values, size_t nbRecords) const;
+      bool StartSegment(const Sample& sample);
+      size_t AppendRecords(size_t first);
+
+      Pinetime::Controllers::FS& fs;
+      SemaphoreHandle_t mutex = nullptr;
+
+      std::array<SegmentInfo, nbSegments> segments;
+      bool hasCurrentSegment = false;
+      size_t currentSegment = 0;
+      size_t currentRecords = 0;
+      int16_t lastValues[nbSeries] = {};
+
+      static constexpr size_t queueSize = 32;
+      std::array<Sample, queueSize> queue;
+      size_t queueLength = 0;
+    };
+  }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Pinetime {
+  namespace Utility {
+    namespace Crc16Details {
+      struct Table {
+        constexpr Table() : values {} {
+          for (uint16_t i = 0; i < 256; i++) {
+            uint16_t value = i << 8;
+            for (uint8_t bit = 0; bit < 8; bit++) {
+              value = (value & 0x8000) ? (value << 1) ^ 0x1021 : (value << 1);
+            }
+            values[i] = value;
+          }
+        }
+
+        uint16_t values[256];
+      };
+
+      constexpr Table table {};
+    }
+
+    // CRC-16/CCITT-FALSE (same as crc16_compute() in the NRF SDK, used by the DFU), one byte per table lookup.
+    // Start with crc = 0xFFFF and pass the result of the previous call to compute it by chunks.
+    inline uint16_t Crc16(uint16_t crc, const uint8_t* data, size_t size) {
+      for (size_t i = 0; i < size; i++) {
+        crc = static_cast<uint16_t>(crc << 8) ^ Crc16Details::table.values[static_cast<uint8_t>(crc >> 8) ^ data[i]];
+      }
+      return crc;
+    }
+  }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Pinetime {
+  namespace Utility {
+    // CRC-32 (same as zlib.crc32()). Pass the result of the previous call as crc to compute it by chunks.
+    inline uint32_t Crc32(uint32_t crc, const uint8_t* data, size_t size) {
+      crc = ~crc;
+      for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+          crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+      }
+      return ~crc;
+    }
+  }
+}
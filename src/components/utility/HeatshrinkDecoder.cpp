@@ -0,0 +1,86 @@
+#include "components/utility/HeatshrinkDecoder.h"
+#include <cstring>
+
+using namespace Pinetime::Utility;
+
+void HeatshrinkDecoder::Reset() {
+  // The references before the start of the stream read zeros, as in the reference implementation
+  std::memset(window, 0, windowSize);
+  head = 0;
+  state = States::Tag;
+  bitMask = 0;
+  nbBits = 0;
+  bits = 0;
+}
+
+bool HeatshrinkDecoder::ReadBits(uint8_t count, const uint8_t*& input, const uint8_t* end) {
+  // The bits of a field are accumulated across the calls to Decode()
+  while (nbBits < count) {
+    if (bitMask == 0) {
+      if (input == end) {
+        return false;
+      }
+      currentByte = *input++;
+      bitMask = 0x80;
+    }
+    bits = (bits << 1) | ((currentByte & bitMask) ? 1 : 0);
+    bitMask >>= 1;
+    nbBits++;
+  }
+  return true;
+}
+
+uint8_t HeatshrinkDecoder::Push(uint8_t value) {
+  window[head] = value;
+  head = (head + 1) & (windowSize - 1);
+  return value;
+}
+
+size_t HeatshrinkDecoder::Decode(const uint8_t* input, size_t inputSize, uint8_t* output, size_t outputSize, size_t& produced) {
+  const uint8_t* const start = input;
+  const uint8_t* const end = input + inputSize;
+  produced = 0;
+
+  // No bit is read once the output is full : the stream can end right after its last byte of output
+  while (produced < outputSize) {
+    switch (state) {
+      case States::Tag:
+        if (!ReadBits(1, input, end)) {
+          return input - start;
+        }
+        state = (bits != 0) ? States::Literal : States::Distance;
+        break;
+      case States::Literal:
+        if (!ReadBits(8, input, end)) {
+          return input - start;
+        }
+        output[produced++] = Push(static_cast<uint8_t>(bits));
+        state = States::Tag;
+        break;
+      case States::Distance:
+        if (!ReadBits(windowBits, input, end)) {
+          return input - start;
+        }
+        distance = bits + 1;
+        state = States::Length;
+        break;
+      case States::Length:
+        if (!ReadBits(lookaheadBits, input, end)) {
+          return input - start;
+        }
+        length = bits + 1;
+        state = States::Copy;
+        break;
+      case States::Copy:
+        output[produced++] = Push(window[(head - distance) & (windowSize - 1)]);
+        if (--length == 0) {
+          state = States::Tag;
+        }
+        break;
+    }
+    // The field is complete
+    nbBits = 0;
+    bits = 0;
+  }
+  return input - start;
+}
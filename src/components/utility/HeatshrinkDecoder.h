@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Pinetime {
+  namespace Utility {
+    // Streaming decoder for the heatshrink format (LZSS) : a tag bit, then either a literal byte (tag 1), or the
+    // distance (windowBits) and the length (lookaheadBits) of a back-reference into the previous output (tag 0), both
+    // minus one. The bits are read MSB first.
+    //
+    // The input can be split anywhere, even inside a field, and the output is limited by the size of the buffer
+    // passed to each call : the memory used is the window only.
+    class HeatshrinkDecoder {
+    public:
+      static constexpr uint8_t windowBits = 9;
+      static constexpr uint8_t lookaheadBits = 4;
+
+      // Starts a new stream, at the next byte of the input : the bits left in the current byte are dropped
+      void Reset();
+
+      // Decodes the input until it's consumed or the output is full. Returns the number of bytes of input consumed,
+      // and the number of bytes written to output in produced.
+      size_t Decode(const uint8_t* input, size_t inputSize, uint8_t* output, size_t outputSize, size_t& produced);
+
+    private:
+      enum class States : uint8_t { Tag, Literal, Distance, Length, Copy };
+
+      static constexpr size_t windowSize = 1 << windowBits;
+
+      bool ReadBits(uint8_t count, const uint8_t*& input, const uint8_t* end);
+      uint8_t Push(uint8_t value);
+
+      uint8_t window[windowSize];
+      size_t head = 0;
+      States state = States::Tag;
+      uint8_t currentByte = 0;
+      uint8_t bitMask = 0;
+      uint8_t nbBits = 0;
+      uint16_t bits = 0;
+      uint16_t distance = 0;
+      uint8_t length = 0;
+    };
+  }
+}
@@ -20,11 +20,13 @@ namespace Pinetime {
       Paddle,
       Twos,
       HeartRate,
+      HeartRateHistory,
       Navigation,
       StopWatch,
       Metronome,
       Motion,
       Steps,
+      StepsHistory,
       Weather,
       PassKey,
       QuickSettings,
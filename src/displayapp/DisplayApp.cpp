@@ -27,6 +27,7 @@
 #include "displayapp/screens/FlashLight.h"
 #include "displayapp/screens/BatteryInfo.h"
 #include "displayapp/screens/Steps.h"
+#include "displayapp/screens/History.h"
 #include "displayapp/screens/PassKey.h"
 #include "displayapp/screens/Error.h"
 
@@ -161,7 +162,9 @@ void DisplayApp::Refresh() {
       if (!currentScreen->IsRunning()) {
         LoadPreviousScreen();
       }
+      lvgl.Profiler().StartFrame();
       queueTimeout = lv_task_handler();
+      lvgl.Profiler().EndFrame(currentApp);
       break;
     default:
       queueTimeout = portMAX_DELAY;
@@ -452,7 +455,8 @@ void DisplayApp::LoadScreen(Apps app, DisplayApp::FullRefreshDirections directio
                                                             bleController,
                                                             watchdog,
                                                             motionController,
-                                                            touchPanel);
+                                                            touchPanel,
+                                                            lvgl);
       break;
     case Apps::FlashLight:
       currentScreen = std::make_unique<Screens::FlashLight>(this, *systemTask, brightnessController);
@@ -487,6 +491,18 @@ void DisplayApp::LoadScreen(Apps app, DisplayApp::FullRefreshDirections directio
     case Apps::Steps:
       currentScreen = std::make_unique<Screens::Steps>(this, motionController, settingsController);
       break;
+    case Apps::StepsHistory:
+      currentScreen = std::make_unique<Screens::History>(this,
+                                                         systemTask->timeSeries(),
+                                                         dateTimeController,
+                                                         Controllers::TimeSeries::Series::Steps);
+      break;
+    case Apps::HeartRateHistory:
+      currentScreen = std::make_unique<Screens::History>(this,
+                                                         systemTask->timeSeries(),
+                                                         dateTimeController,
+                                                         Controllers::TimeSeries::Series::HeartRate);
+      break;
   }
   currentApp = app;
 }
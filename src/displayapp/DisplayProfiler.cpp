@@ -0,0 +1,101 @@
+#include "displayapp/DisplayProfiler.h"
+
+#ifdef DISPLAY_PROFILER
+  #include <nrf.h>
+  #include <algorithm>
+  #include <libraries/log/nrf_log.h>
+  #include "drivers/SpiMaster.h"
+
+using namespace Pinetime::Components;
+
+namespace {
+  // Wall clock time (the DWT cycle counter stops while the CPU sleeps, waiting for a transfer for example)
+  uint32_t NowUs() {
+    NRF_TIMER4->TASKS_CAPTURE[1] = 1;
+    return NRF_TIMER4->CC[1];
+  }
+
+  void Accumulate(uint32_t& average, uint32_t value) {
+    average = average - (average / 8) + (value / 8);
+  }
+}
+
+void DisplayProfiler::Init() {
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  NRF_TIMER4->TASKS_STOP = 1;
+  NRF_TIMER4->MODE = TIMER_MODE_MODE_Timer << TIMER_MODE_MODE_Pos;
+  NRF_TIMER4->BITMODE = TIMER_BITMODE_BITMODE_32Bit << TIMER_BITMODE_BITMODE_Pos;
+  NRF_TIMER4->PRESCALER = 4; // 16MHz / 2^4 = 1MHz
+  NRF_TIMER4->TASKS_CLEAR = 1;
+  NRF_TIMER4->TASKS_START = 1;
+}
+
+void DisplayProfiler::StartFrame() {
+  frameBlockedCycles = 0;
+  frameBlockedUs = 0;
+  frameFlushes = 0;
+  framePixels = 0;
+  frameStartSpiBusyUs = Drivers::SpiMaster::BusyTime();
+  frameStartCycles = DWT->CYCCNT;
+}
+
+void DisplayProfiler::EndFrame(Applications::Apps app) {
+  uint32_t cycles = DWT->CYCCNT - frameStartCycles;
+  if (frameFlushes == 0) {
+    // lv_task_handler() didn't refresh the display
+    return;
+  }
+
+  // The cycles spent by the other tasks while the display task was blocked are not part of the render time
+  uint32_t renderCycles = (cycles > frameBlockedCycles) ? cycles - frameBlockedCycles : 0;
+  auto& appStatistics = statistics[static_cast<size_t>(app)];
+  appStatistics.nbFrames++;
+  appStatistics.maxRenderCycles = std::max(appStatistics.maxRenderCycles, renderCycles);
+  Accumulate(appStatistics.renderCycles, renderCycles);
+  Accumulate(appStatistics.blockedUs, frameBlockedUs);
+  Accumulate(appStatistics.spiBusyUs, Drivers::SpiMaster::BusyTime() - frameStartSpiBusyUs);
+  Accumulate(appStatistics.flushes, frameFlushes);
+  Accumulate(appStatistics.pixels, framePixels);
+}
+
+void DisplayProfiler::StartWait() {
+  waitStartUs = NowUs();
+  waitStartCycles = DWT->CYCCNT;
+}
+
+void DisplayProfiler::EndWait() {
+  frameBlockedCycles += DWT->CYCCNT - waitStartCycles;
+  frameBlockedUs += NowUs() - waitStartUs;
+}
+
+void DisplayProfiler::OnFlush(uint32_t nbPixels) {
+  frameFlushes++;
+  framePixels += nbPixels;
+}
+
+const DisplayProfiler::Statistics& DisplayProfiler::Get(Applications::Apps app) const {
+  return statistics[static_cast<size_t>(app)];
+}
+
+void DisplayProfiler::Dump() const {
+  for (size_t i = 0; i < nbApps; i++) {
+    const auto& appStatistics = statistics[i];
+    if (appStatistics.nbFrames > 0) {
+      NRF_LOG_INFO("[Profiler] App %d : %d frames, render %d cycles (max %d)",
+                   i,
+                   appStatistics.nbFrames,
+                   appStatistics.renderCycles,
+                   appStatistics.maxRenderCycles);
+      NRF_LOG_INFO("[Profiler] App %d : blocked %dus, SPI busy %dus, %d flushes, %d pixels",
+                   i,
+                   appStatistics.blockedUs,
+                   appStatistics.spiBusyUs,
+                   appStatistics.flushes,
+                   appStatistics.pixels);
+    }
+  }
+}
+#endif
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "displayapp/Apps.h"
+
+namespace Pinetime {
+  namespace Components {
+    // Measures the display pipeline, for each app : render time of lv_task_handler() (DWT cycles), time blocked
+    // waiting for the display transfers and SPI busy time (TIMER4, 1MHz), flushes and pixels sent per frame.
+    // Enabled by the DISPLAY_PROFILER option, all the methods are empty otherwise.
+    class DisplayProfiler {
+    public:
+      // Rolling averages over the last frames (weight 1/8 for the newest frame)
+      struct Statistics {
+        uint32_t nbFrames = 0;
+        uint32_t renderCycles = 0;
+        uint32_t maxRenderCycles = 0;
+        uint32_t blockedUs = 0;
+        uint32_t spiBusyUs = 0;
+        uint32_t flushes = 0;
+        uint32_t pixels = 0;
+      };
+
+#ifdef DISPLAY_PROFILER
+      void Init();
+      void StartFrame();
+      void EndFrame(Applications::Apps app);
+      void StartWait();
+      void EndWait();
+      void OnFlush(uint32_t nbPixels);
+
+      const Statistics& Get(Applications::Apps app) const;
+      void Dump() const;
+
+    private:
+      static constexpr size_t nbApps = static_cast<size_t>(Applications::Apps::Error) + 1;
+      std::array<Statistics, nbApps> statistics;
+
+      uint32_t frameStartCycles = 0;
+      uint32_t frameStartSpiBusyUs = 0;
+      uint32_t waitStartCycles = 0;
+      uint32_t waitStartUs = 0;
+      uint32_t frameBlockedCycles = 0;
+      uint32_t frameBlockedUs = 0;
+      uint32_t frameFlushes = 0;
+      uint32_t framePixels = 0;
+#else
+      void Init() {
+      }
+
+      void StartFrame() {
+      }
+
+      void EndFrame(Applications::Apps /*app*/) {
+      }
+
+      void StartWait() {
+      }
+
+      void EndWait() {
+      }
+
+      void OnFlush(uint32_t /*nbPixels*/) {
+      }
+
+      void Dump() const {
+      }
+#endif
+    };
+  }
+}
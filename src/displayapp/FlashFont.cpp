@@ -0,0 +1,678 @@
+#include "displayapp/FlashFont.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <libraries/log/nrf_log.h>
+#include "components/utility/Crc32.h"
+
+using namespace Pinetime::Components;
+
+namespace {
+  constexpr size_t maxFonts = 4;
+  constexpr size_t maxPathLength = 32;
+  constexpr size_t nbCachedGlyphs = 24;
+  // LVGL draws a label in strips of a few lines, and each strip needs the bitmaps of all the glyphs of the label :
+  // the bitmap cache holds the largest bitmaps of this number of glyphs of each font in use (a time and its AM/PM).
+  constexpr size_t workingSetGlyphs = 6;
+  constexpr size_t crcChunkSize = 64;
+
+  constexpr uint8_t noFont = 0xff;
+  constexpr uint16_t noBitmap = 0xffff;
+
+  // "head" table of the binary format of lv_font_conv
+  struct Header {
+    uint32_t version;
+    uint16_t tablesCount;
+    uint16_t fontSize;
+    uint16_t ascent;
+    int16_t descent;
+    uint16_t typoAscent;
+    int16_t typoDescent;
+    uint16_t typoLineGap;
+    int16_t minY;
+    int16_t maxY;
+    uint16_t defaultAdvanceWidth;
+    uint16_t kerningScale;
+    uint8_t indexToLocFormat;
+    uint8_t glyphIdFormat;
+    uint8_t advanceWidthFormat;
+    uint8_t bitsPerPixel;
+    uint8_t xyBits;
+    uint8_t whBits;
+    uint8_t advanceWidthBits;
+    uint8_t compression;
+    uint8_t subpixels;
+    uint8_t padding;
+    int16_t underlinePosition;
+    uint16_t underlineThickness;
+  };
+
+  struct TableHeader {
+    uint32_t length;
+    char label[4];
+  };
+
+  struct CmapSubtable {
+    uint32_t dataOffset;
+    uint32_t rangeStart;
+    uint16_t rangeLength;
+    uint16_t glyphIdStart;
+    uint16_t entriesCount;
+    uint8_t format;
+    uint8_t padding;
+  };
+
+  enum CmapFormats : uint8_t { Format0Full, SparseFull, Format0Tiny, SparseTiny };
+  enum KernFormats : uint8_t { SortedPairs = 0, Classes = 3, NoKerning = 0xff };
+
+  struct Font {
+    lv_font_t font;
+    char path[maxPathLength];
+    uint8_t users;
+    bool fileOpen;
+    lv_fs_file_t file;
+    uint32_t fileSize;
+    uint32_t fileCrc;
+    Header header;
+    uint32_t cmapStart;
+    uint32_t nbCmaps;
+    uint32_t locaStart;
+    uint32_t nbGlyphs;
+    uint32_t glyfStart;
+    uint32_t kernStart;
+    uint8_t kernFormat;
+    // Number of pairs (SortedPairs), or length of the class maps (Classes)
+    uint32_t kernCount;
+    uint8_t kernColumns;
+    uint16_t maxBitmapSize;
+  };
+
+  struct Glyph {
+    uint8_t font = noFont;
+    uint32_t letter;
+    uint32_t glyphId;
+    uint32_t offset;
+    // 1/16 px
+    uint16_t advanceWidth;
+    uint16_t boxWidth;
+    uint16_t boxHeight;
+    int16_t offsetX;
+    int16_t offsetY;
+    uint16_t bitmapOffset = noBitmap;
+    uint16_t bitmapSize;
+    uint32_t lastUse;
+  };
+
+  std::array<Font, maxFonts> fonts;
+  std::array<Glyph, nbCachedGlyphs> glyphs;
+  // Allocated in the LVGL heap while fonts are in use, sized from their glyphs
+  uint8_t* bitmaps = nullptr;
+  size_t bitmapCacheSize = 0;
+  uint32_t useCounter = 0;
+
+  // Reads the bits of the glyph descriptions, most significant bit first
+  class BitReader {
+  public:
+    explicit BitReader(const uint8_t* data) : data {data} {
+    }
+
+    uint32_t Read(uint8_t nbBits) {
+      uint32_t value = 0;
+      for (uint8_t i = 0; i < nbBits; i++, position++) {
+        value = (value << 1) | ((data[position / 8] >> (7 - (position % 8))) & 1);
+      }
+      return value;
+    }
+
+    int32_t ReadSigned(uint8_t nbBits) {
+      uint32_t value = Read(nbBits);
+      if (nbBits > 0 && (value & (1u << (nbBits - 1))) != 0) {
+        value |= ~0u << nbBits;
+      }
+      return static_cast<int32_t>(value);
+    }
+
+  private:
+    const uint8_t* data;
+    uint32_t position = 0;
+  };
+
+  // Returns the number of bytes read
+  uint32_t ReadAt(Font& font, uint32_t offset, void* buffer, uint32_t size) {
+    uint32_t bytesRead = 0;
+    if (!font.fileOpen || lv_fs_seek(&font.file, offset) != LV_FS_RES_OK ||
+        lv_fs_read(&font.file, buffer, size, &bytesRead) != LV_FS_RES_OK) {
+      return 0;
+    }
+    return bytesRead;
+  }
+
+  bool Read(Font& font, uint32_t offset, void* buffer, uint32_t size) {
+    return ReadAt(font, offset, buffer, size) == size;
+  }
+
+  bool ReadTable(Font& font, uint32_t offset, const char* label, uint32_t& length) {
+    TableHeader table;
+    if (!Read(font, offset, &table, sizeof(TableHeader)) || std::memcmp(table.label, label, sizeof(table.label)) != 0 ||
+        table.length < sizeof(TableHeader)) {
+      return false;
+    }
+    length = table.length;
+    return true;
+  }
+
+  // The tables follow each other : head, cmap, loca, glyf and kern (optional)
+  bool LoadTables(Font& font) {
+    uint32_t length;
+    if (!ReadTable(font, 0, "head", length) || !Read(font, sizeof(TableHeader), &font.header, sizeof(Header))) {
+      return false;
+    }
+    const Header& header = font.header;
+    if (header.compression != 0 ||
+        (header.bitsPerPixel != 1 && header.bitsPerPixel != 2 && header.bitsPerPixel != 4 && header.bitsPerPixel != 8)) {
+      return false;
+    }
+
+    font.cmapStart = length;
+    if (!ReadTable(font, font.cmapStart, "cmap", length) || !Read(font, font.cmapStart + sizeof(TableHeader), &font.nbCmaps, 4)) {
+      return false;
+    }
+    font.locaStart = font.cmapStart + length;
+    if (!ReadTable(font, font.locaStart, "loca", length) || !Read(font, font.locaStart + sizeof(TableHeader), &font.nbGlyphs, 4)) {
+      return false;
+    }
+    font.glyfStart = font.locaStart + length;
+    if (!ReadTable(font, font.glyfStart, "glyf", length)) {
+      return false;
+    }
+
+    font.kernStart = font.glyfStart + length;
+    font.kernFormat = NoKerning;
+    if (font.kernStart < font.fileSize && ReadTable(font, font.kernStart, "kern", length)) {
+      uint8_t format;
+      Read(font, font.kernStart + sizeof(TableHeader), &format, 1);
+      const uint32_t data = font.kernStart + sizeof(TableHeader) + 4;
+      if (format == SortedPairs && Read(font, data, &font.kernCount, 4)) {
+        font.kernFormat = SortedPairs;
+      } else if (format == Classes) {
+        uint16_t mapLength;
+        uint8_t rows;
+        if (Read(font, data, &mapLength, 2) && Read(font, data + 2, &rows, 1) && Read(font, data + 3, &font.kernColumns, 1)) {
+          font.kernCount = mapLength;
+          font.kernFormat = Classes;
+        }
+      }
+    }
+    return true;
+  }
+
+  uint32_t FindGlyphId(Font& font, uint32_t letter) {
+    const uint32_t subtables = font.cmapStart + sizeof(TableHeader) + 4;
+    for (uint32_t i = 0; i < font.nbCmaps; i++) {
+      CmapSubtable cmap;
+      if (!Read(font, subtables + (i * sizeof(CmapSubtable)), &cmap, sizeof(CmapSubtable))) {
+        return 0;
+      }
+      // Same test as LVGL : code points before the range wrap around
+      const uint32_t index = letter - cmap.rangeStart;
+      if (index > cmap.rangeLength) {
+        continue;
+      }
+
+      const uint32_t data = font.cmapStart + cmap.dataOffset;
+      if (cmap.format == Format0Tiny) {
+        return cmap.glyphIdStart + index;
+      }
+      if (cmap.format == Format0Full) {
+        uint8_t glyphIdOffset;
+        return Read(font, data + index, &glyphIdOffset, 1) ? cmap.glyphIdStart + glyphIdOffset : 0;
+      }
+      if (cmap.format != SparseTiny && cmap.format != SparseFull) {
+        return 0;
+      }
+
+      // Binary search in the sorted list of the code points of the range
+      uint32_t low = 0;
+      uint32_t high = cmap.entriesCount;
+      while (low < high) {
+        const uint32_t middle = (low + high) / 2;
+        uint16_t codePoint;
+        if (!Read(font, data + (middle * 2), &codePoint, 2)) {
+          return 0;
+        }
+        if (codePoint == index) {
+          if (cmap.format == SparseTiny) {
+            return cmap.glyphIdStart + middle;
+          }
+          uint16_t glyphIdOffset;
+          return Read(font, data + (cmap.entriesCount * 2) + (middle * 2), &glyphIdOffset, 2) ? cmap.glyphIdStart + glyphIdOffset : 0;
+        }
+        if (codePoint < index) {
+          low = middle + 1;
+        } else {
+          high = middle;
+        }
+      }
+      return 0;
+    }
+    return 0;
+  }
+
+  int8_t KernValue(Font& font, uint32_t left, uint32_t right) {
+    int8_t value = 0;
+    const uint32_t data = font.kernStart + sizeof(TableHeader) + 4;
+    if (font.kernFormat == SortedPairs) {
+      // Pairs of glyph ids sorted by left then right id, followed by the values
+      const uint32_t idSize = (font.header.glyphIdFormat == 0) ? 1 : 2;
+      const uint32_t pairs = data + 4;
+      uint32_t low = 0;
+      uint32_t high = font.kernCount;
+      while (low < high) {
+        const uint32_t middle = (low + high) / 2;
+        uint8_t pair[4] = {};
+        if (!Read(font, pairs + (middle * 2 * idSize), pair, 2 * idSize)) {
+          return 0;
+        }
+        const uint32_t pairLeft = (idSize == 1) ? pair[0] : pair[0] | (pair[1] << 8);
+        const uint32_t pairRight = (idSize == 1) ? pair[1] : pair[2] | (pair[3] << 8);
+        if (pairLeft == left && pairRight == right) {
+          Read(font, pairs + (font.kernCount * 2 * idSize) + middle, &value, 1);
+          return value;
+        }
+        if (pairLeft < left || (pairLeft == left && pairRight < right)) {
+          low = middle + 1;
+        } else {
+          high = middle;
+        }
+      }
+    } else if (font.kernFormat == Classes && left < font.kernCount && right < font.kernCount) {
+      // Left and right class of each glyph, followed by the values of the pairs of classes (class 0 : no kerning)
+      const uint32_t maps = data + 4;
+      uint8_t leftClass = 0;
+      uint8_t rightClass = 0;
+      if (Read(font, maps + left, &leftClass, 1) && Read(font, maps + font.kernCount + right, &rightClass, 1) && leftClass > 0 &&
+          rightClass > 0) {
+        Read(font, maps + (2 * font.kernCount) + ((leftClass - 1) * font.kernColumns) + (rightClass - 1), &value, 1);
+      }
+    }
+    return value;
+  }
+
+  void DropBitmap(Glyph& glyph) {
+    glyph.bitmapOffset = noBitmap;
+    glyph.bitmapSize = 0;
+  }
+
+  void DropGlyphs(uint8_t fontIndex) {
+    for (auto& glyph : glyphs) {
+      if (glyph.font == fontIndex) {
+        DropBitmap(glyph);
+        glyph.font = noFont;
+      }
+    }
+  }
+
+  bool DecodeGlyph(Font& font, uint32_t glyphId, Glyph& glyph) {
+    if (glyphId == 0 || glyphId >= font.nbGlyphs) {
+      return false;
+    }
+    const uint32_t locaSize = (font.header.indexToLocFormat == 0) ? 2 : 4;
+    uint32_t offset = 0;
+    if (!Read(font, font.locaStart + sizeof(TableHeader) + 4 + (glyphId * locaSize), &offset, locaSize)) {
+      return false;
+    }
+
+    // The description (advance width, position and size) is followed by the bitmap, without padding
+    const Header& header = font.header;
+    const uint32_t nbBits = header.advanceWidthBits + (2 * header.xyBits) + (2 * header.whBits);
+    uint8_t description[12] = {};
+    if (nbBits > sizeof(description) * 8 || ReadAt(font, font.glyfStart + offset, description, sizeof(description)) < (nbBits + 7) / 8) {
+      return false;
+    }
+    BitReader reader {description};
+    uint32_t advanceWidth = (header.advanceWidthBits == 0) ? header.defaultAdvanceWidth : reader.Read(header.advanceWidthBits);
+    if (header.advanceWidthFormat == 0) {
+      advanceWidth <<= 4;
+    }
+    glyph.glyphId = glyphId;
+    glyph.offset = font.glyfStart + offset;
+    glyph.advanceWidth = advanceWidth;
+    glyph.offsetX = reader.ReadSigned(header.xyBits);
+    glyph.offsetY = reader.ReadSigned(header.xyBits);
+    glyph.boxWidth = reader.Read(header.whBits);
+    glyph.boxHeight = reader.Read(header.whBits);
+    DropBitmap(glyph);
+    return true;
+  }
+
+  // Size of the bitmap of the glyph in the file : it starts in the middle of a byte when the description isn't a
+  // multiple of 8 bits
+  uint32_t BitmapSizeToRead(const Font& font, const Glyph& glyph) {
+    const Header& header = font.header;
+    const uint32_t nbBits = header.advanceWidthBits + (2 * header.xyBits) + (2 * header.whBits);
+    return (((nbBits % 8) + (glyph.boxWidth * glyph.boxHeight * header.bitsPerPixel)) + 7) / 8;
+  }
+
+  void FindMaxBitmapSize(Font& font) {
+    font.maxBitmapSize = 0;
+    for (uint32_t glyphId = 1; glyphId < font.nbGlyphs; glyphId++) {
+      Glyph glyph;
+      if (DecodeGlyph(font, glyphId, glyph)) {
+        font.maxBitmapSize = std::max<uint32_t>(font.maxBitmapSize, BitmapSizeToRead(font, glyph));
+      }
+    }
+  }
+
+  Glyph* FindGlyph(uint8_t fontIndex, uint32_t letter) {
+    Glyph* leastRecentlyUsed = &glyphs[0];
+    for (auto& glyph : glyphs) {
+      if (glyph.font == fontIndex && glyph.letter == letter) {
+        glyph.lastUse = ++useCounter;
+        return &glyph;
+      }
+      if (glyph.font == noFont || (leastRecentlyUsed->font != noFont && glyph.lastUse < leastRecentlyUsed->lastUse)) {
+        leastRecentlyUsed = &glyph;
+      }
+    }
+
+    Font& font = fonts[fontIndex];
+    Glyph glyph;
+    if (!DecodeGlyph(font, FindGlyphId(font, letter), glyph)) {
+      return nullptr;
+    }
+    glyph.font = fontIndex;
+    glyph.letter = letter;
+    glyph.lastUse = ++useCounter;
+    *leastRecentlyUsed = glyph;
+    return leastRecentlyUsed;
+  }
+
+  // Makes room for size bytes at the end of the bitmap cache, evicting the least recently used bitmaps
+  // (except the one of keep) and moving the others to the beginning
+  bool AllocateBitmap(const Glyph& keep, uint32_t size, uint16_t& offset) {
+    if (size > bitmapCacheSize) {
+      return false;
+    }
+    auto end = [] {
+      size_t end = 0;
+      for (const auto& glyph : glyphs) {
+        if (glyph.bitmapOffset != noBitmap) {
+          end = std::max<size_t>(end, glyph.bitmapOffset + glyph.bitmapSize);
+        }
+      }
+      return end;
+    };
+    if (end() + size <= bitmapCacheSize) {
+      offset = end();
+      return true;
+    }
+
+    auto used = [] {
+      size_t used = 0;
+      for (const auto& glyph : glyphs) {
+        if (glyph.bitmapOffset != noBitmap) {
+          used += glyph.bitmapSize;
+        }
+      }
+      return used;
+    };
+    while (used() + size > bitmapCacheSize) {
+      Glyph* leastRecentlyUsed = nullptr;
+      for (auto& glyph : glyphs) {
+        if (glyph.bitmapOffset != noBitmap && &glyph != &keep && (leastRecentlyUsed == nullptr || glyph.lastUse < leastRecentlyUsed->lastUse)) {
+          leastRecentlyUsed = &glyph;
+        }
+      }
+      DropBitmap(*leastRecentlyUsed);
+    }
+
+    // Compaction, in the order of the offsets
+    uint16_t next = 0;
+    while (true) {
+      Glyph* first = nullptr;
+      for (auto& glyph : glyphs) {
+        if (glyph.bitmapOffset != noBitmap && glyph.bitmapOffset >= next && (first == nullptr || glyph.bitmapOffset < first->bitmapOffset)) {
+          first = &glyph;
+        }
+      }
+      if (first == nullptr) {
+        break;
+      }
+      std::memmove(bitmaps + next, bitmaps + first->bitmapOffset, first->bitmapSize);
+      first->bitmapOffset = next;
+      next += first->bitmapSize;
+    }
+    offset = next;
+    return true;
+  }
+
+  bool LoadBitmap(Font& font, Glyph& glyph) {
+    const Header& header = font.header;
+    const uint32_t nbBits = header.advanceWidthBits + (2 * header.xyBits) + (2 * header.whBits);
+    const uint32_t shift = nbBits % 8;
+    const uint32_t size = ((glyph.boxWidth * glyph.boxHeight * header.bitsPerPixel) + 7) / 8;
+    const uint32_t sizeToRead = BitmapSizeToRead(font, glyph);
+    uint16_t offset;
+    if (!AllocateBitmap(glyph, sizeToRead, offset)) {
+      return false;
+    }
+    uint8_t* bitmap = bitmaps + offset;
+    if (ReadAt(font, glyph.offset + (nbBits / 8), bitmap, sizeToRead) < sizeToRead) {
+      return false;
+    }
+    if (shift != 0) {
+      for (uint32_t i = 0; i < size; i++) {
+        uint8_t next = (i + 1 < sizeToRead) ? bitmap[i + 1] : 0;
+        bitmap[i] = (bitmap[i] << shift) | (next >> (8 - shift));
+      }
+    }
+    glyph.bitmapOffset = offset;
+    glyph.bitmapSize = sizeToRead;
+    return true;
+  }
+
+  uint8_t IndexOf(const lv_font_t* font) {
+    return static_cast<uint8_t>(static_cast<const Font*>(font->dsc) - fonts.data());
+  }
+
+  bool GetGlyphDsc(const lv_font_t* lvFont, lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letterNext) {
+    const uint8_t fontIndex = IndexOf(lvFont);
+    Font& font = fonts[fontIndex];
+    if (font.users == 0) {
+      return false;
+    }
+    bool isTab = false;
+    if (letter == '\t') {
+      letter = ' ';
+      isTab = true;
+    }
+    const Glyph* cachedGlyph = FindGlyph(fontIndex, letter);
+    if (cachedGlyph == nullptr) {
+      return false;
+    }
+    // The next glyph may replace this one in the cache
+    const Glyph glyph = *cachedGlyph;
+
+    int32_t kerning = 0;
+    if (letterNext != 0 && font.kernFormat != NoKerning) {
+      const Glyph* next = FindGlyph(fontIndex, letterNext);
+      if (next != nullptr) {
+        kerning = (KernValue(font, glyph.glyphId, next->glyphId) * font.header.kerningScale) >> 4;
+      }
+    }
+
+    // Same rounding as lv_font_get_glyph_dsc_fmt_txt()
+    int32_t advanceWidth = glyph.advanceWidth;
+    if (isTab) {
+      advanceWidth *= 2;
+    }
+    advanceWidth += kerning;
+    dsc->adv_w = (advanceWidth + (1 << 3)) >> 4;
+    dsc->box_w = isTab ? glyph.boxWidth * 2 : glyph.boxWidth;
+    dsc->box_h = glyph.boxHeight;
+    dsc->ofs_x = glyph.offsetX;
+    dsc->ofs_y = glyph.offsetY;
+    dsc->bpp = font.header.bitsPerPixel;
+    return true;
+  }
+
+  const uint8_t* GetGlyphBitmap(const lv_font_t* lvFont, uint32_t letter) {
+    const uint8_t fontIndex = IndexOf(lvFont);
+    Font& font = fonts[fontIndex];
+    if (font.users == 0) {
+      return nullptr;
+    }
+    if (letter == '\t') {
+      letter = ' ';
+    }
+    Glyph* glyph = FindGlyph(fontIndex, letter);
+    if (glyph == nullptr) {
+      return nullptr;
+    }
+    if (glyph->boxWidth == 0 || glyph->boxHeight == 0) {
+      static const uint8_t empty = 0;
+      return &empty;
+    }
+    if (glyph->bitmapOffset == noBitmap && !LoadBitmap(font, *glyph)) {
+      return nullptr;
+    }
+    return bitmaps + glyph->bitmapOffset;
+  }
+
+  uint32_t FileCrc(Font& font) {
+    uint8_t chunk[crcChunkSize];
+    uint32_t crc = 0;
+    for (uint32_t offset = 0; offset < font.fileSize; offset += crcChunkSize) {
+      const uint32_t size = std::min<uint32_t>(crcChunkSize, font.fileSize - offset);
+      if (!Read(font, offset, chunk, size)) {
+        return 0;
+      }
+      crc = Pinetime::Utility::Crc32(crc, chunk, size);
+    }
+    return crc;
+  }
+
+  bool Open(Font& font) {
+    if (lv_fs_open(&font.file, font.path, LV_FS_MODE_RD) != LV_FS_RES_OK) {
+      return false;
+    }
+    font.fileOpen = true;
+    const uint32_t previousSize = font.fileSize;
+    const uint32_t previousCrc = font.fileCrc;
+    font.fileSize = 0;
+    lv_fs_size(&font.file, &font.fileSize);
+    font.fileCrc = FileCrc(font);
+    if (font.fileSize != previousSize || font.fileCrc != previousCrc) {
+      // Not loaded yet, or replaced since it was
+      const uint8_t fontIndex = &font - fonts.data();
+      DropGlyphs(fontIndex);
+      if (!LoadTables(font)) {
+        lv_fs_close(&font.file);
+        font.fileOpen = false;
+        font.fileSize = 0;
+        return false;
+      }
+      FindMaxBitmapSize(font);
+      std::memset(&font.font, 0, sizeof(lv_font_t));
+      font.font.get_glyph_dsc = GetGlyphDsc;
+      font.font.get_glyph_bitmap = GetGlyphBitmap;
+      font.font.line_height = font.header.ascent - font.header.descent;
+      font.font.base_line = -font.header.descent;
+      font.font.subpx = font.header.subpixels;
+      font.font.underline_position = font.header.underlinePosition;
+      font.font.underline_thickness = font.header.underlineThickness;
+      font.font.dsc = &font;
+    }
+    return true;
+  }
+
+  // Grows the bitmap cache to the working set of the fonts in use. The bitmaps keep their offsets.
+  void GrowBitmapCache() {
+    size_t size = 0;
+    for (const auto& font : fonts) {
+      if (font.users > 0) {
+        size += font.maxBitmapSize * workingSetGlyphs;
+      }
+    }
+    if (size <= bitmapCacheSize) {
+      return;
+    }
+    auto* cache = static_cast<uint8_t*>((bitmaps == nullptr) ? lv_mem_alloc(size) : lv_mem_realloc(bitmaps, size));
+    if (cache != nullptr) {
+      bitmaps = cache;
+      bitmapCacheSize = size;
+    }
+  }
+
+  // The descriptions of the glyphs stay in the cache, their bitmaps are read again when a font is used again
+  void FreeBitmapCache() {
+    for (const auto& font : fonts) {
+      if (font.users > 0) {
+        return;
+      }
+    }
+    for (auto& glyph : glyphs) {
+      DropBitmap(glyph);
+    }
+    lv_mem_free(bitmaps);
+    bitmaps = nullptr;
+    bitmapCacheSize = 0;
+  }
+}
+
+lv_font_t* FlashFont::Acquire(const char* path) {
+  if (std::strlen(path) >= maxPathLength) {
+    return lv_font_load(path);
+  }
+
+  Font* font = nullptr;
+  for (auto& candidate : fonts) {
+    if (std::strcmp(candidate.path, path) == 0) {
+      font = &candidate;
+      break;
+    }
+  }
+  if (font == nullptr) {
+    // Replaces a font that is not used, its glyphs are dropped
+    for (auto& candidate : fonts) {
+      if (candidate.users == 0 && (font == nullptr || candidate.path[0] == '\0')) {
+        font = &candidate;
+      }
+    }
+    if (font == nullptr) {
+      return lv_font_load(path);
+    }
+    DropGlyphs(font - fonts.data());
+    std::strcpy(font->path, path);
+    font->fileSize = 0;
+    font->fileCrc = 0;
+    font->header = {};
+  }
+
+  if (font->users == 0 && !Open(*font)) {
+    font->path[0] = '\0';
+    if (font->header.compression != 0) {
+      NRF_LOG_INFO("[FlashFont] %s is compressed, loaded in RAM", path);
+      return lv_font_load(path);
+    }
+    return nullptr;
+  }
+  font->users++;
+  GrowBitmapCache();
+  return &font->font;
+}
+
+void FlashFont::Release(lv_font_t* lvFont) {
+  for (auto& font : fonts) {
+    if (&font.font == lvFont) {
+      if (font.users > 0 && --font.users == 0) {
+        // The glyphs stay in the cache
+        lv_fs_close(&font.file);
+        font.fileOpen = false;
+        FreeBitmapCache();
+      }
+      return;
+    }
+  }
+  lv_font_free(lvFont);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <lvgl/lvgl.h>
+
+namespace Pinetime {
+  namespace Components {
+    // Fonts in the binary format of lv_font_conv ("R:" or "F:" files), read from the external flash memory when a
+    // glyph is drawn instead of being parsed into the LVGL heap by lv_font_load().
+    //
+    // Only the header of a font and the position of its tables are kept in RAM. The description and the bitmap of a
+    // glyph are decoded when LVGL needs them, and kept in caches shared by all the fonts : the least recently used
+    // glyphs are evicted when they're full. The bitmap cache is allocated in the LVGL heap while fonts are in use,
+    // and sized from their largest glyphs. A released font keeps its slot and the descriptions of its glyphs, which
+    // are used again if the CRC of the file didn't change when the font is acquired again.
+    //
+    // Compressed fonts are loaded with lv_font_load().
+    namespace FlashFont {
+      // Returns the font of the file at path, or nullptr if it can't be read.
+      // Each font must be released when the objects that use it are deleted.
+      lv_font_t* Acquire(const char* path);
+      void Release(lv_font_t* font);
+    }
+  }
+}
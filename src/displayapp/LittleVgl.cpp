@@ -1,8 +1,11 @@
 #include "displayapp/LittleVgl.h"
 #include "displayapp/InfiniTimeTheme.h"
+#include "displayapp/LittleVglGpu.h"
 
 #include <FreeRTOS.h>
 #include <task.h>
+#include <algorithm>
+#include <cstring>
 #include "drivers/Cst816s.h"
 #include "drivers/St7789.h"
 
@@ -13,6 +16,148 @@ namespace {
     lv_theme_t* theme = lv_pinetime_theme_init();
     lv_theme_set_act(theme);
   }
+
+#ifdef DRIVER_DISPLAY_RGB444
+  // Converts 2 swapped RGB565 pixels (as stored by LVGL with LV_COLOR_16_SWAP) into 2 RGB444 pixels
+  // (0x0RGB in each half word).
+  inline uint32_t ToRgb444(uint32_t pixels) {
+    return ((pixels & 0x00f000f0U) << 4) | ((pixels & 0x00070007U) << 5) | ((pixels >> 11) & 0x00100010U) |
+           ((pixels >> 9) & 0x000f000fU);
+  }
+
+  // Packs 2 RGB444 pixels into 24 bits, in the order they are sent to the display
+  inline uint32_t PackRgb444(uint32_t pixels) {
+    return ((pixels & 0x0fffU) << 12) | ((pixels >> 16) & 0x0fffU);
+  }
+
+  // Converts the buffer in place from RGB565 to packed RGB444 and returns the new size in bytes.
+  // 8 pixels (4 words) are converted to 3 words at a time, the output never overtakes the input.
+  size_t ConvertToRgb444(uint8_t* buffer, size_t nbPixels) {
+    const uint8_t* in = buffer;
+    uint8_t* out = buffer;
+    size_t remaining = nbPixels;
+
+    while (remaining >= 8) {
+      uint32_t words[4];
+      std::memcpy(words, in, sizeof(words));
+      uint32_t p0 = PackRgb444(ToRgb444(words[0]));
+      uint32_t p1 = PackRgb444(ToRgb444(words[1]));
+      uint32_t p2 = PackRgb444(ToRgb444(words[2]));
+      uint32_t p3 = PackRgb444(ToRgb444(words[3]));
+      words[0] = __builtin_bswap32((p0 << 8) | (p1 >> 16));
+      words[1] = __builtin_bswap32((p1 << 16) | (p2 >> 8));
+      words[2] = __builtin_bswap32((p2 << 24) | p3);
+      std::memcpy(out, words, 3 * sizeof(uint32_t));
+      in += 16;
+      out += 12;
+      remaining -= 8;
+    }
+
+    while (remaining >= 2) {
+      uint32_t word;
+      std::memcpy(&word, in, sizeof(word));
+      uint32_t packed = PackRgb444(ToRgb444(word));
+      out[0] = packed >> 16;
+      out[1] = packed >> 8;
+      out[2] = packed;
+      in += 4;
+      out += 3;
+      remaining -= 2;
+    }
+
+    return out - buffer;
+  }
+#endif
+
+  bool Contains(const lv_area_t& outer, const lv_area_t& inner) {
+    return inner.x1 >= outer.x1 && inner.y1 >= outer.y1 && inner.x2 <= outer.x2 && inner.y2 <= outer.y2;
+  }
+
+  // True if the object, its shadow or its outline (extended by pad) is drawn on the area
+  bool IsDrawnOn(const lv_obj_t* obj, const lv_area_t& area) {
+    lv_area_t coords;
+    lv_obj_get_coords(obj, &coords);
+    const lv_coord_t pad = lv_obj_get_ext_draw_pad(obj);
+    return coords.x1 - pad <= area.x2 && coords.x2 + pad >= area.x1 && coords.y1 - pad <= area.y2 && coords.y2 + pad >= area.y1;
+  }
+
+  // The child of parent drawn on the area, nullptr if there is none. Sets several if more than one are.
+  lv_obj_t* ChildDrawnOn(lv_obj_t* parent, const lv_area_t& area, bool& several) {
+    lv_obj_t* found = nullptr;
+    several = false;
+    for (lv_obj_t* child = lv_obj_get_child(parent, nullptr); child != nullptr; child = lv_obj_get_child(parent, child)) {
+      if (lv_obj_get_hidden(child) || !IsDrawnOn(child, area)) {
+        continue;
+      }
+      if (found != nullptr) {
+        several = true;
+        return nullptr;
+      }
+      found = child;
+    }
+    return found;
+  }
+
+  // True if a plain object (same type as the screen) draws nothing but its background, of this color, on its main part
+  bool DrawsOnlyBackground(const lv_obj_t* obj, lv_design_cb_t plainDesign, lv_color_t color) {
+    return lv_obj_get_design_cb(obj) == plainDesign && lv_obj_get_style_bg_opa(obj, LV_OBJ_PART_MAIN) == LV_OPA_COVER &&
+           lv_obj_get_style_bg_grad_dir(obj, LV_OBJ_PART_MAIN) == LV_GRAD_DIR_NONE &&
+           lv_obj_get_style_bg_color(obj, LV_OBJ_PART_MAIN).full == color.full &&
+           lv_obj_get_style_border_width(obj, LV_OBJ_PART_MAIN) == 0 && lv_obj_get_style_outline_width(obj, LV_OBJ_PART_MAIN) == 0 &&
+           lv_obj_get_style_pattern_image(obj, LV_OBJ_PART_MAIN) == nullptr &&
+           lv_obj_get_style_value_str(obj, LV_OBJ_PART_MAIN) == nullptr;
+  }
+
+  // True if the area shows the background of a single object, of this color, and nothing else. The object is the one
+  // LVGL starts to draw from : it contains the area, and at each level of the tree down to it no other object is drawn
+  // on the area. The top and system layers must be empty there too.
+  bool IsSolidArea(lv_disp_t* disp, const lv_area_t& area, lv_color_t color) {
+    bool several;
+    // A screen is being loaded with an animation : 2 screens are drawn
+    if (lv_disp_get_scr_prev(disp) != nullptr || ChildDrawnOn(lv_disp_get_layer_top(disp), area, several) != nullptr || several ||
+        ChildDrawnOn(lv_disp_get_layer_sys(disp), area, several) != nullptr || several) {
+      return false;
+    }
+
+    lv_obj_t* obj = lv_disp_get_scr_act(disp);
+    const lv_design_cb_t plainDesign = lv_obj_get_design_cb(obj);
+    while (true) {
+      lv_obj_t* child = ChildDrawnOn(obj, area, several);
+      if (several) {
+        return false;
+      }
+      if (child == nullptr) {
+        return DrawsOnlyBackground(obj, plainDesign, color);
+      }
+      lv_area_t coords;
+      lv_obj_get_coords(child, &coords);
+      if (!Contains(coords, area)) {
+        return false;
+      }
+      obj = child;
+    }
+  }
+
+  constexpr size_t BufferSize(size_t nbPixels) {
+#ifdef DRIVER_DISPLAY_RGB444
+    return (nbPixels * 3) / 2;
+#else
+    return nbPixels * 2;
+#endif
+  }
+
+  // Time spent on each flush besides the pixels (address window, task notifications, context switches),
+  // expressed in bytes that could be sent on the bus during the same time.
+  constexpr uint32_t flushOverhead = 100;
+
+  // Cost of refreshing an area : LVGL renders and flushes it in as many parts as needed to fit in the draw buffer
+  uint32_t RefreshCost(const lv_area_t& area, uint32_t drawBufferSize) {
+    uint32_t width = lv_area_get_width(&area);
+    uint32_t height = lv_area_get_height(&area);
+    uint32_t linesPerFlush = std::max<uint32_t>(drawBufferSize / width, 1);
+    uint32_t nbFlushes = (height + linesPerFlush - 1) / linesPerFlush;
+    return BufferSize(width * height) + (nbFlushes * flushOverhead);
+  }
 }
 
 static void disp_flush(lv_disp_drv_t* disp_drv, const lv_area_t* area, lv_color_t* color_p) {
@@ -22,12 +167,41 @@ static void disp_flush(lv_disp_drv_t* disp_drv, const lv_area_t* area, lv_color_
 
 static void rounder(lv_disp_drv_t* disp_drv, lv_area_t* area) {
   auto* lvgl = static_cast<LittleVgl*>(disp_drv->user_data);
-  if (lvgl->GetFullRefresh()) {
+  // lv_refr_area() probes the rounding of the lines with a (0, 0, 0, y2) area during the refresh :
+  // it is only rounded, it isn't an invalidated area
+  const bool probe = (area->x1 == 0) && (area->x2 == 0) && (area->y1 == 0);
+  if (!probe && lvgl->GetFullRefresh()) {
     area->x1 = 0;
     area->x2 = LV_HOR_RES - 1;
     area->y1 = 0;
     area->y2 = LV_VER_RES - 1;
   }
+#ifdef DRIVER_DISPLAY_RGB444
+  // Pixels are sent by pairs in RGB444 mode, the width of the area must be even
+  area->x1 &= ~1;
+  area->x2 |= 1;
+#endif
+
+  // Align the areas on the lines of the draw buffer so that neighbour areas overlap and can be merged
+  area->y1 -= area->y1 % LittleVgl::nbWriteLines;
+  area->y2 += (LittleVgl::nbWriteLines - 1) - (area->y2 % LittleVgl::nbWriteLines);
+  if (area->y2 >= LV_VER_RES) {
+    area->y2 = LV_VER_RES - 1;
+  }
+
+  if (!probe) {
+    lvgl->CoalesceArea(area);
+  }
+}
+
+static void gpu_fill(lv_disp_drv_t* disp_drv, lv_color_t* dest_buf, lv_coord_t dest_width, const lv_area_t* fill_area, lv_color_t color) {
+  auto* lvgl = static_cast<LittleVgl*>(disp_drv->user_data);
+  lvgl->FillDrawBuffer(dest_buf, dest_width, fill_area, color);
+}
+
+static void monitor(lv_disp_drv_t* disp_drv, uint32_t time, uint32_t /*nbPixels*/) {
+  auto* lvgl = static_cast<LittleVgl*>(disp_drv->user_data);
+  lvgl->OnRefreshDone(time);
 }
 
 bool touchpad_read(lv_indev_drv_t* indev_drv, lv_indev_data_t* data) {
@@ -39,6 +213,7 @@ LittleVgl::LittleVgl(Pinetime::Drivers::St7789& lcd, Pinetime::Drivers::Cst816S&
 }
 
 void LittleVgl::Init() {
+  profiler.Init();
   lv_init();
   InitTheme();
   InitDisplay();
@@ -46,8 +221,11 @@ void LittleVgl::Init() {
 }
 
 void LittleVgl::InitDisplay() {
-  lv_disp_buf_init(&disp_buf_2, buf2_1, buf2_2, LV_HOR_RES_MAX * 4); /*Initialize the display buffer*/
-  lv_disp_drv_init(&disp_drv);                                       /*Basic initialization*/
+#ifdef DRIVER_DISPLAY_RGB444
+  lcd.SetColorFormat(Pinetime::Drivers::St7789::ColorFormats::Rgb444);
+#endif
+  lv_disp_buf_init(&disp_buf_2, buf2_1, buf2_2, LV_HOR_RES_MAX * nbWriteLines); /*Initialize the display buffer*/
+  lv_disp_drv_init(&disp_drv);                                                  /*Basic initialization*/
 
   /*Set up the functions to access to your display*/
 
@@ -61,6 +239,9 @@ void LittleVgl::InitDisplay() {
   disp_drv.buffer = &disp_buf_2;
   disp_drv.user_data = this;
   disp_drv.rounder_cb = rounder;
+  disp_drv.monitor_cb = monitor;
+  disp_drv.gpu_fill_cb = gpu_fill;
+  disp_drv.gpu_blend_cb = LittleVglGpu::Blend;
 
   /*Finally register the driver*/
   lv_disp_drv_register(&disp_drv);
@@ -94,12 +275,67 @@ void LittleVgl::SetFullRefresh(FullRefreshDirections direction) {
   fullRefresh = true;
 }
 
+void LittleVgl::CoalesceArea(lv_area_t* area) {
+  // The area is grown to cover the areas invalidated before it when a single bigger refresh is cheaper.
+  // LVGL then drops the areas it covers when it joins the invalidated areas.
+  const uint32_t drawBufferSize = disp_drv.buffer->size;
+  uint8_t i = 0;
+  while (i < nbPendingAreas) {
+    const lv_area_t& other = pendingAreas[i];
+    lv_area_t joined;
+    joined.x1 = std::min(area->x1, other.x1);
+    joined.y1 = std::min(area->y1, other.y1);
+    joined.x2 = std::max(area->x2, other.x2);
+    joined.y2 = std::max(area->y2, other.y2);
+    uint32_t separateCost = RefreshCost(*area, drawBufferSize) + RefreshCost(other, drawBufferSize);
+    if (RefreshCost(joined, drawBufferSize) <= separateCost) {
+      *area = joined;
+      pendingAreas[i] = pendingAreas[--nbPendingAreas];
+      statistics.nbCoalescedAreas++;
+      // The bigger area can now be worth merging with the areas already checked
+      i = 0;
+    } else {
+      i++;
+    }
+  }
+  if (nbPendingAreas < maxPendingAreas) {
+    pendingAreas[nbPendingAreas++] = *area;
+  }
+}
+
+void LittleVgl::OnRefreshDone(uint32_t time) {
+  nbPendingAreas = 0;
+
+  statistics.nbFrames++;
+  statistics.lastFrameFlushes = frameFlushes;
+  statistics.lastFrameBytes = frameBytes;
+  statistics.lastFrameTime = time;
+  statistics.maxFrameFlushes = std::max(statistics.maxFrameFlushes, frameFlushes);
+  frameFlushes = 0;
+  frameBytes = 0;
+}
+
+void LittleVgl::FillDrawBuffer(lv_color_t* dest_buf, lv_coord_t dest_width, const lv_area_t* fill_area, lv_color_t color) {
+  // The first fill of a part of an area is the background of the object LVGL starts to draw from. If it covers the
+  // whole draw buffer and nothing else will be drawn on it, the buffer is not filled : FlushDisplay() sends the
+  // area from the line buffer instead.
+  const lv_disp_buf_t* buffer = disp_drv.buffer;
+  if (dest_buf == buffer->buf_act && fill_area->x1 == 0 && fill_area->y1 == 0 && fill_area->x2 == dest_width - 1 &&
+      fill_area->y2 == lv_area_get_height(&buffer->area) - 1 && IsSolidArea(lv_disp_get_default(), buffer->area, color)) {
+    solidColorBuffer = true;
+    solidColorBufferColor = color;
+    return;
+  }
+  LittleVglGpu::Fill(&disp_drv, dest_buf, dest_width, fill_area, color);
+}
+
 void LittleVgl::FlushDisplay(const lv_area_t* area, lv_color_t* color_p) {
   uint16_t y1, y2, width, height = 0;
 
+  profiler.StartWait();
   ulTaskNotifyTake(pdTRUE, 200);
-  // Notification is still needed (even if there is a mutex on SPI) because of the DataCommand pin
-  // which cannot be set/clear during a transfer.
+  profiler.EndWait();
+  // Wait for the previous buffer to be sent (DrawBuffer() is asynchronous) before flushing the next one.
 
   if ((scrollDirection == LittleVgl::FullRefreshDirections::Down) && (area->y2 == visibleNbLines - 1)) {
     writeOffset = ((writeOffset + totalNbLines) - visibleNbLines) % totalNbLines;
@@ -148,6 +384,9 @@ void LittleVgl::FlushDisplay(const lv_area_t* area, lv_color_t* color_p) {
       lcd.VerticalScrollStartAddress(scrollOffset);
     }
   } else if (scrollDirection == FullRefreshDirections::Left or scrollDirection == FullRefreshDirections::LeftAnim) {
+    // Horizontal transitions are drawn column by column, without hardware scrolling : the ST7789 only scrolls
+    // along its gate lines, which MADCTL doesn't change (MV/MX/MY only change how the RAM is written).
+    // The screen is sent once, like for the vertical transitions.
     if (area->x2 == visibleNbLines - 1) {
       scrollDirection = FullRefreshDirections::None;
       lv_disp_set_direction(lv_disp_get_default(), 0);
@@ -159,20 +398,36 @@ void LittleVgl::FlushDisplay(const lv_area_t* area, lv_color_t* color_p) {
     }
   }
 
+  // Areas of a single color (black backgrounds, screen clears,...) were not rendered by FillDrawBuffer() : they are
+  // sent from a small line buffer instead of the draw buffer.
+  auto* data = reinterpret_cast<uint8_t*>(color_p);
+  const bool solidColor = solidColorBuffer;
+  solidColorBuffer = false;
+  if (solidColor) {
+    SetSolidColor(solidColorBufferColor);
+  }
+#ifdef DRIVER_DISPLAY_RGB444
+  else {
+    ConvertToRgb444(data, width * height);
+  }
+#endif
+
   if (y2 < y1) {
     height = totalNbLines - y1;
 
     if (height > 0) {
-      lcd.DrawBuffer(area->x1, y1, width, height, reinterpret_cast<const uint8_t*>(color_p), width * height * 2);
+      DrawArea(area->x1, y1, width, height, data, solidColor);
+      profiler.StartWait();
       ulTaskNotifyTake(pdTRUE, 100);
+      profiler.EndWait();
     }
 
-    uint16_t pixOffset = width * height;
+    size_t dataOffset = BufferSize(width * height);
     height = y2 + 1;
-    lcd.DrawBuffer(area->x1, 0, width, height, reinterpret_cast<const uint8_t*>(color_p + pixOffset), width * height * 2);
+    DrawArea(area->x1, 0, width, height, data + dataOffset, solidColor);
 
   } else {
-    lcd.DrawBuffer(area->x1, y1, width, height, reinterpret_cast<const uint8_t*>(color_p), width * height * 2);
+    DrawArea(area->x1, y1, width, height, data, solidColor);
   }
 
   // IMPORTANT!!!
@@ -180,6 +435,41 @@ void LittleVgl::FlushDisplay(const lv_area_t* area, lv_color_t* color_p) {
   lv_disp_flush_ready(&disp_drv);
 }
 
+void LittleVgl::SetSolidColor(lv_color_t color) {
+  if (solidColorLineValid && solidColorLineColor.full == color.full) {
+    return;
+  }
+  // FlushDisplay() waits for the previous transfer, the line buffer is not in use anymore
+#ifdef DRIVER_DISPLAY_RGB444
+  uint32_t packed = PackRgb444(ToRgb444((static_cast<uint32_t>(color.full) << 16) | color.full));
+  for (size_t i = 0; i < solidColorLineSize; i += 3) {
+    solidColorLine[i] = packed >> 16;
+    solidColorLine[i + 1] = packed >> 8;
+    solidColorLine[i + 2] = packed;
+  }
+#else
+  for (size_t i = 0; i < solidColorLineSize; i += 2) {
+    std::memcpy(&solidColorLine[i], &color.full, sizeof(color.full));
+  }
+#endif
+  solidColorLineColor = color;
+  solidColorLineValid = true;
+}
+
+void LittleVgl::DrawArea(uint16_t x, uint16_t y, uint16_t width, uint16_t height, const uint8_t* data, bool solidColor) {
+  statistics.nbFlushes++;
+  statistics.nbBytes += BufferSize(width * height);
+  frameFlushes++;
+  frameBytes += BufferSize(width * height);
+  profiler.OnFlush(width * height);
+
+  if (solidColor) {
+    lcd.FillArea(x, y, width, height, solidColorLine, solidColorLineSize, BufferSize(width * height));
+  } else {
+    lcd.DrawBuffer(x, y, width, height, data, BufferSize(width * height));
+  }
+}
+
 void LittleVgl::SetNewTouchPoint(uint16_t x, uint16_t y, bool contact) {
   tap_x = x;
   tap_y = y;
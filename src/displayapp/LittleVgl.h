@@ -1,6 +1,7 @@
 #pragma once
 
 #include <lvgl/lvgl.h>
+#include "displayapp/DisplayProfiler.h"
 
 namespace Pinetime {
   namespace Drivers {
@@ -12,6 +13,20 @@ namespace Pinetime {
     class LittleVgl {
     public:
       enum class FullRefreshDirections { None, Up, Down, Left, Right, LeftAnim, RightAnim };
+
+      struct Statistics {
+        uint32_t nbFrames = 0;
+        uint32_t nbFlushes = 0;
+        uint32_t nbBytes = 0;
+        uint32_t nbCoalescedAreas = 0;
+        uint32_t lastFrameFlushes = 0;
+        uint32_t lastFrameBytes = 0;
+        uint32_t lastFrameTime = 0;
+        uint32_t maxFrameFlushes = 0;
+      };
+
+      static constexpr uint8_t nbWriteLines = 4;
+
       LittleVgl(Pinetime::Drivers::St7789& lcd, Pinetime::Drivers::Cst816S& touchPanel);
 
       LittleVgl(const LittleVgl&) = delete;
@@ -22,9 +37,23 @@ namespace Pinetime {
       void Init();
 
       void FlushDisplay(const lv_area_t* area, lv_color_t* color_p);
+      // gpu_fill_cb of the display driver
+      void FillDrawBuffer(lv_color_t* dest_buf, lv_coord_t dest_width, const lv_area_t* fill_area, lv_color_t color);
       bool GetTouchPadInfo(lv_indev_data_t* ptr);
       void SetFullRefresh(FullRefreshDirections direction);
       void SetNewTouchPoint(uint16_t x, uint16_t y, bool contact);
+      // Called by the rounder on each invalidated area, merges it with the previous ones when that is cheaper
+      void CoalesceArea(lv_area_t* area);
+      // Called by LVGL at the end of each refresh (monitor callback), time in ms
+      void OnRefreshDone(uint32_t time);
+
+      const Statistics& GetStatistics() const {
+        return statistics;
+      }
+
+      DisplayProfiler& Profiler() {
+        return profiler;
+      }
 
       bool GetFullRefresh() {
         bool returnValue = fullRefresh;
@@ -37,18 +66,29 @@ namespace Pinetime {
     private:
       void InitDisplay();
       void InitTouchpad();
+      void SetSolidColor(lv_color_t color);
+      void DrawArea(uint16_t x, uint16_t y, uint16_t width, uint16_t height, const uint8_t* data, bool solidColor);
 
       Pinetime::Drivers::St7789& lcd;
       Pinetime::Drivers::Cst816S& touchPanel;
 
       lv_disp_buf_t disp_buf_2;
-      lv_color_t buf2_1[LV_HOR_RES_MAX * 4];
-      lv_color_t buf2_2[LV_HOR_RES_MAX * 4];
+      lv_color_t buf2_1[LV_HOR_RES_MAX * nbWriteLines];
+      lv_color_t buf2_2[LV_HOR_RES_MAX * nbWriteLines];
 
       lv_disp_drv_t disp_drv;
 
+      // Pattern sent for the areas filled with a single color. 240 bytes is a whole number
+      // of pixels in both RGB565 (2 bytes/pixel) and RGB444 (3 bytes/2 pixels).
+      static constexpr size_t solidColorLineSize = 240;
+      uint8_t solidColorLine[solidColorLineSize];
+      lv_color_t solidColorLineColor;
+      bool solidColorLineValid = false;
+      // The draw buffer was not rendered, the area is filled with this color
+      bool solidColorBuffer = false;
+      lv_color_t solidColorBufferColor;
+
       bool fullRefresh = false;
-      static constexpr uint8_t nbWriteLines = 4;
       static constexpr uint16_t totalNbLines = 320;
       static constexpr uint16_t visibleNbLines = 240;
 
@@ -60,6 +100,16 @@ namespace Pinetime {
       uint16_t writeOffset = 0;
       uint16_t scrollOffset = 0;
 
+      Statistics statistics;
+      DisplayProfiler profiler;
+      uint32_t frameFlushes = 0;
+      uint32_t frameBytes = 0;
+
+      // Areas invalidated since the last refresh, as grown by CoalesceArea()
+      static constexpr uint8_t maxPendingAreas = LV_INV_BUF_SIZE;
+      lv_area_t pendingAreas[maxPendingAreas];
+      uint8_t nbPendingAreas = 0;
+
       uint16_t tap_x = 0;
       uint16_t tap_y = 0;
       bool tapped = false;
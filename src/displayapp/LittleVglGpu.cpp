@@ -0,0 +1,91 @@
+#include "displayapp/LittleVglGpu.h"
+#include <nrf.h>
+#include <cstring>
+
+using namespace Pinetime::Components;
+
+namespace {
+  // Blends 2 pixels (LV_COLOR_16_SWAP) at once, each color component of both pixels is computed in a 16 bits lane.
+  // Same result as lv_color_mix(src, dest, mix) applied on each pixel.
+  inline uint32_t BlendPixels(uint32_t src, uint32_t dest, uint32_t mix) {
+    const uint32_t inverseMix = 255 - mix;
+    const uint32_t roundOffset = (LV_COLOR_MIX_ROUND_OFS << 16) | LV_COLOR_MIX_ROUND_OFS;
+    src = __REV16(src);
+    dest = __REV16(dest);
+
+    // Products fit in 16 bits (63 * 255 max), they don't overflow into the other lane
+    auto mixLanes = [mix, inverseMix, roundOffset](uint32_t s, uint32_t d) {
+      uint32_t value = __UADD16(__UADD16(s * mix, d * inverseMix), roundOffset);
+      // value / 255 for value < 65535, in each lane
+      value = __UADD16(__UADD16(value, 0x00010001U), (value >> 8) & 0x00ff00ffU);
+      return (value >> 8) & 0x00ff00ffU;
+    };
+
+    uint32_t red = mixLanes((src >> 11) & 0x001f001fU, (dest >> 11) & 0x001f001fU);
+    uint32_t green = mixLanes((src >> 5) & 0x003f003fU, (dest >> 5) & 0x003f003fU);
+    uint32_t blue = mixLanes(src & 0x001f001fU, dest & 0x001f001fU);
+    return __REV16((red << 11) | (green << 5) | blue);
+  }
+}
+
+void LittleVglGpu::Fill(lv_disp_drv_t* /*disp_drv*/,
+                        lv_color_t* dest_buf,
+                        lv_coord_t dest_width,
+                        const lv_area_t* fill_area,
+                        lv_color_t color) {
+  const uint32_t color32 = (static_cast<uint32_t>(color.full) << 16) | color.full;
+  const lv_coord_t width = lv_area_get_width(fill_area);
+
+  for (lv_coord_t y = fill_area->y1; y <= fill_area->y2; y++) {
+    lv_color_t* dest = dest_buf + (y * dest_width) + fill_area->x1;
+    lv_coord_t remaining = width;
+
+    if ((reinterpret_cast<uintptr_t>(dest) & 0x3) != 0) {
+      *dest++ = color;
+      remaining--;
+    }
+
+    auto* dest32 = reinterpret_cast<uint32_t*>(dest);
+    while (remaining >= 8) {
+      dest32[0] = color32;
+      dest32[1] = color32;
+      dest32[2] = color32;
+      dest32[3] = color32;
+      dest32 += 4;
+      remaining -= 8;
+    }
+    while (remaining >= 2) {
+      *dest32++ = color32;
+      remaining -= 2;
+    }
+
+    if (remaining > 0) {
+      *reinterpret_cast<lv_color_t*>(dest32) = color;
+    }
+  }
+}
+
+void LittleVglGpu::Blend(lv_disp_drv_t* /*disp_drv*/, lv_color_t* dest, const lv_color_t* src, uint32_t length, lv_opa_t opa) {
+  if ((reinterpret_cast<uintptr_t>(dest) & 0x3) != 0 && length > 0) {
+    *dest = lv_color_mix(*src, *dest, opa);
+    dest++;
+    src++;
+    length--;
+  }
+
+  // dest is word aligned, src may not be (unaligned loads are supported by the Cortex-M4)
+  auto* dest32 = reinterpret_cast<uint32_t*>(dest);
+  while (length >= 2) {
+    uint32_t src32;
+    std::memcpy(&src32, src, sizeof(src32));
+    *dest32 = BlendPixels(src32, *dest32, opa);
+    dest32++;
+    src += 2;
+    length -= 2;
+  }
+
+  if (length > 0) {
+    dest = reinterpret_cast<lv_color_t*>(dest32);
+    *dest = lv_color_mix(*src, *dest, opa);
+  }
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <lvgl/lvgl.h>
+
+namespace Pinetime {
+  namespace Components {
+    // The gpu_fill_cb and gpu_blend_cb callbacks of the LVGL display driver : the draw buffer is filled and blended
+    // 2 pixels (a 32 bits word) at a time, with the same result as the software rendering of LVGL.
+    namespace LittleVglGpu {
+      void Fill(lv_disp_drv_t* disp_drv, lv_color_t* dest_buf, lv_coord_t dest_width, const lv_area_t* fill_area, lv_color_t color);
+      void Blend(lv_disp_drv_t* disp_drv, lv_color_t* dest, const lv_color_t* src, uint32_t length, lv_opa_t opa);
+    }
+  }
+}
@@ -77,6 +77,14 @@ HeartRate::~HeartRate() {
   systemTask.PushMessage(Pinetime::System::Messages::EnableSleeping);
 }
 
+bool HeartRate::OnTouchEvent(Pinetime::Applications::TouchEvents event) {
+  if (event == TouchEvents::SwipeUp) {
+    app->StartApp(Apps::HeartRateHistory, DisplayApp::FullRefreshDirections::Up);
+    return true;
+  }
+  return false;
+}
+
 void HeartRate::Refresh() {
 
   auto state = heartRateController.State();
@@ -21,6 +21,7 @@ namespace Pinetime {
         ~HeartRate() override;
 
         void Refresh() override;
+        bool OnTouchEvent(TouchEvents event) override;
 
         void OnStartStopEvent(lv_event_t event);
 
@@ -0,0 +1,102 @@
+#include "displayapp/screens/History.h"
+#include <algorithm>
+#include <chrono>
+#include "components/datetime/DateTimeController.h"
+#include "displayapp/DisplayApp.h"
+#include "displayapp/InfiniTimeTheme.h"
+
+using namespace Pinetime::Applications::Screens;
+
+namespace {
+  constexpr uint32_t secondsPerHour = 60 * 60;
+  constexpr uint32_t secondsPerDay = 24 * secondsPerHour;
+  constexpr size_t daysPerWeek = 7;
+  // The columns are scaled to this range, the values don't fit in lv_coord_t
+  constexpr lv_coord_t chartRange = 100;
+}
+
+History::History(Pinetime::Applications::DisplayApp* app,
+                 Controllers::TimeSeries& timeSeries,
+                 Controllers::DateTime& dateTimeController,
+                 Controllers::TimeSeries::Series series)
+  : Screen(app), timeSeries {timeSeries}, dateTimeController {dateTimeController}, series {series} {
+  title = lv_label_create(lv_scr_act(), nullptr);
+  lv_obj_set_style_local_text_color(title, LV_LABEL_PART_MAIN, LV_STATE_DEFAULT, Colors::orange);
+  lv_label_set_text_static(title, (series == Controllers::TimeSeries::Series::Steps) ? "Steps" : "Heart rate");
+  lv_obj_align(title, nullptr, LV_ALIGN_IN_TOP_MID, 0, 5);
+
+  period = lv_label_create(lv_scr_act(), nullptr);
+  lv_obj_set_style_local_text_color(period, LV_LABEL_PART_MAIN, LV_STATE_DEFAULT, Colors::lightGray);
+
+  summary = lv_label_create(lv_scr_act(), nullptr);
+
+  chart = lv_chart_create(lv_scr_act(), nullptr);
+  lv_obj_set_size(chart, 240, 150);
+  lv_obj_align(chart, nullptr, LV_ALIGN_IN_BOTTOM_MID, 0, 0);
+  lv_obj_set_style_local_bg_opa(chart, LV_CHART_PART_BG, LV_STATE_DEFAULT, LV_OPA_TRANSP);
+  lv_obj_set_style_local_border_width(chart, LV_CHART_PART_BG, LV_STATE_DEFAULT, 0);
+  lv_obj_set_style_local_pad_inner(chart, LV_CHART_PART_SERIES, LV_STATE_DEFAULT, 2);
+  lv_chart_set_type(chart, LV_CHART_TYPE_COLUMN);
+  lv_chart_set_div_line_count(chart, 0, 0);
+  lv_chart_set_y_range(chart, LV_CHART_AXIS_PRIMARY_Y, 0, chartRange);
+  chartSeries = lv_chart_add_series(chart, (series == Controllers::TimeSeries::Series::Steps) ? Colors::blue : Colors::highlight);
+
+  Load(currentView);
+}
+
+History::~History() {
+  lv_obj_clean(lv_scr_act());
+}
+
+void History::Load(Views view) {
+  currentView = view;
+
+  auto now = std::chrono::duration_cast<std::chrono::seconds>(dateTimeController.CurrentDateTime().time_since_epoch()).count();
+  uint32_t today = now - (now % secondsPerDay);
+  uint32_t from = today;
+  uint32_t bucketDuration = secondsPerHour;
+  size_t nbBuckets = 24;
+  if (view == Views::Week) {
+    from = today - ((daysPerWeek - 1) * secondsPerDay);
+    bucketDuration = secondsPerDay;
+    nbBuckets = daysPerWeek;
+  }
+  lv_label_set_text_static(period, (view == Views::Day) ? "Today" : "7 days");
+
+  // Steps per hour or per day, mean heart rate
+  auto aggregation = (series == Controllers::TimeSeries::Series::Steps) ? Controllers::TimeSeries::Aggregation::Sum
+                                                                       : Controllers::TimeSeries::Aggregation::Average;
+  int32_t buckets[Controllers::TimeSeries::maxBuckets];
+  timeSeries.Aggregate(series, from, bucketDuration, buckets, nbBuckets, aggregation);
+  lv_obj_align(period, title, LV_ALIGN_OUT_BOTTOM_MID, 0, 5);
+
+  int32_t maxValue = *std::max_element(buckets, buckets + nbBuckets);
+  if (series == Controllers::TimeSeries::Series::Steps) {
+    int32_t total = 0;
+    for (size_t i = 0; i < nbBuckets; i++) {
+      total += buckets[i];
+    }
+    lv_label_set_text_fmt(summary, "Total %li", total);
+  } else {
+    lv_label_set_text_fmt(summary, "Max %li bpm", maxValue);
+  }
+  lv_obj_align(summary, period, LV_ALIGN_OUT_BOTTOM_MID, 0, 5);
+
+  lv_chart_set_point_count(chart, nbBuckets);
+  for (size_t i = 0; i < nbBuckets; i++) {
+    lv_coord_t value = (maxValue > 0) ? static_cast<lv_coord_t>((buckets[i] * chartRange) / maxValue) : 0;
+    lv_chart_set_point_id(chart, chartSeries, value, i);
+  }
+  lv_chart_refresh(chart);
+}
+
+bool History::OnTouchEvent(Pinetime::Applications::TouchEvents event) {
+  switch (event) {
+    case TouchEvents::SwipeLeft:
+    case TouchEvents::SwipeRight:
+      Load((currentView == Views::Day) ? Views::Week : Views::Day);
+      return true;
+    default:
+      return false;
+  }
+}
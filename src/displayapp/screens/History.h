@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <lvgl/lvgl.h>
+#include "displayapp/screens/Screen.h"
+#include "components/timeseries/TimeSeries.h"
+
+namespace Pinetime {
+  namespace Controllers {
+    class DateTime;
+  }
+
+  namespace Applications {
+    namespace Screens {
+
+      // Day (hourly) and week (daily) histories of a time series. Swipe left and right to switch between them.
+      class History : public Screen {
+      public:
+        History(DisplayApp* app,
+                Controllers::TimeSeries& timeSeries,
+                Controllers::DateTime& dateTimeController,
+                Controllers::TimeSeries::Series series);
+        ~History() override;
+
+        bool OnTouchEvent(TouchEvents event) override;
+
+      private:
+        enum class Views : uint8_t { Day, Week };
+        void Load(Views view);
+
+        Controllers::TimeSeries& timeSeries;
+        Controllers::DateTime& dateTimeController;
+        Controllers::TimeSeries::Series series;
+        Views currentView = Views::Day;
+
+        lv_obj_t* title;
+        lv_obj_t* period;
+        lv_obj_t* summary;
+        lv_obj_t* chart;
+        lv_chart_series_t* chartSeries;
+      };
+    }
+  }
+}
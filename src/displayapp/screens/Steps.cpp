@@ -74,6 +74,14 @@ Steps::~Steps() {
   lv_obj_clean(lv_scr_act());
 }
 
+bool Steps::OnTouchEvent(Pinetime::Applications::TouchEvents event) {
+  if (event == TouchEvents::SwipeUp) {
+    app->StartApp(Apps::StepsHistory, DisplayApp::FullRefreshDirections::Up);
+    return true;
+  }
+  return false;
+}
+
 void Steps::Refresh() {
   stepsCount = motionController.NbSteps();
   currentTripSteps = motionController.GetTripSteps();
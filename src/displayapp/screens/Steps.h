@@ -20,6 +20,7 @@ namespace Pinetime {
         ~Steps() override;
 
         void Refresh() override;
+        bool OnTouchEvent(TouchEvents event) override;
         void lapBtnEventHandler(lv_event_t event);
 
       private:
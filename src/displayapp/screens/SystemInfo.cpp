@@ -3,6 +3,7 @@
 #include "displayapp/screens/SystemInfo.h"
 #include <lvgl/lvgl.h>
 #include "displayapp/DisplayApp.h"
+#include "displayapp/LittleVgl.h"
 #include "displayapp/screens/Label.h"
 #include "Version.h"
 #include "BootloaderVersion.h"
@@ -37,7 +38,8 @@ SystemInfo::SystemInfo(Pinetime::Applications::DisplayApp* app,
                        Pinetime::Controllers::Ble& bleController,
                        Pinetime::Drivers::WatchdogView& watchdog,
                        Pinetime::Controllers::MotionController& motionController,
-                       Pinetime::Drivers::Cst816S& touchPanel)
+                       Pinetime::Drivers::Cst816S& touchPanel,
+                       Pinetime::Components::LittleVgl& lvgl)
   : Screen(app),
     dateTimeController {dateTimeController},
     batteryController {batteryController},
@@ -46,6 +48,7 @@ SystemInfo::SystemInfo(Pinetime::Applications::DisplayApp* app,
     watchdog {watchdog},
     motionController {motionController},
     touchPanel {touchPanel},
+    lvgl {lvgl},
     screens {app,
              0,
              {[this]() -> std::unique_ptr<Screen> {
@@ -62,6 +65,9 @@ SystemInfo::SystemInfo(Pinetime::Applications::DisplayApp* app,
               },
               [this]() -> std::unique_ptr<Screen> {
                 return CreateScreen5();
+              },
+              [this]() -> std::unique_ptr<Screen> {
+                return CreateScreen6();
               }},
              Screens::ScreenListModes::UpDown} {
 }
@@ -94,7 +100,7 @@ std::unique_ptr<Screen> SystemInfo::CreateScreen1() {
                         BootloaderVersion::VersionString());
   lv_label_set_align(label, LV_LABEL_ALIGN_CENTER);
   lv_obj_align(label, lv_scr_act(), LV_ALIGN_CENTER, 0, 0);
-  return std::make_unique<Screens::Label>(0, 5, app, label);
+  return std::make_unique<Screens::Label>(0, 6, app, label);
 }
 
 std::unique_ptr<Screen> SystemInfo::CreateScreen2() {
@@ -173,7 +179,7 @@ std::unique_ptr<Screen> SystemInfo::CreateScreen2() {
                         touchPanel.GetFwVersion(),
                         TARGET_DEVICE_NAME);
   lv_obj_align(label, lv_scr_act(), LV_ALIGN_CENTER, 0, 0);
-  return std::make_unique<Screens::Label>(1, 5, app, label);
+  return std::make_unique<Screens::Label>(1, 6, app, label);
 }
 
 std::unique_ptr<Screen> SystemInfo::CreateScreen3() {
@@ -204,7 +210,7 @@ std::unique_ptr<Screen> SystemInfo::CreateScreen3() {
                         mon.frag_pct,
                         static_cast<int>(mon.free_biggest_size));
   lv_obj_align(label, lv_scr_act(), LV_ALIGN_CENTER, 0, 0);
-  return std::make_unique<Screens::Label>(2, 5, app, label);
+  return std::make_unique<Screens::Label>(2, 6, app, label);
 }
 
 bool SystemInfo::sortById(const TaskStatus_t& lhs, const TaskStatus_t& rhs) {
@@ -265,10 +271,76 @@ std::unique_ptr<Screen> SystemInfo::CreateScreen4() {
     }
     lv_table_set_cell_value(infoTask, i + 1, 3, buffer);
   }
-  return std::make_unique<Screens::Label>(3, 5, app, infoTask);
+  return std::make_unique<Screens::Label>(3, 6, app, infoTask);
 }
 
 std::unique_ptr<Screen> SystemInfo::CreateScreen5() {
+#ifdef DISPLAY_PROFILER
+  // Average render time, time blocked waiting for the display and SPI busy time (ms) of each app
+  static constexpr uint8_t maxAppCount = 8;
+  lvgl.Profiler().Dump();
+
+  lv_obj_t* infoApps = lv_table_create(lv_scr_act(), nullptr);
+  lv_table_set_col_cnt(infoApps, 4);
+  lv_table_set_row_cnt(infoApps, 1);
+  lv_obj_set_style_local_pad_all(infoApps, LV_TABLE_PART_CELL1, LV_STATE_DEFAULT, 0);
+  lv_obj_set_style_local_border_color(infoApps, LV_TABLE_PART_CELL1, LV_STATE_DEFAULT, Colors::lightGray);
+
+  lv_table_set_cell_value(infoApps, 0, 0, "App");
+  lv_table_set_col_width(infoApps, 0, 45);
+  lv_table_set_cell_value(infoApps, 0, 1, "Rndr");
+  lv_table_set_col_width(infoApps, 1, 65);
+  lv_table_set_cell_value(infoApps, 0, 2, "Wait");
+  lv_table_set_col_width(infoApps, 2, 65);
+  lv_table_set_cell_value(infoApps, 0, 3, "SPI");
+  lv_table_set_col_width(infoApps, 3, 65);
+
+  uint8_t row = 1;
+  for (uint8_t appIndex = 0; appIndex <= static_cast<uint8_t>(Apps::Error) && row <= maxAppCount; appIndex++) {
+    const auto& appStatistics = lvgl.Profiler().Get(static_cast<Apps>(appIndex));
+    if (appStatistics.nbFrames == 0) {
+      continue;
+    }
+    char buffer[8] = {0};
+    lv_table_set_row_cnt(infoApps, row + 1);
+    sprintf(buffer, "%d", appIndex);
+    lv_table_set_cell_value(infoApps, row, 0, buffer);
+    sprintf(buffer, "%lu.%lu", appStatistics.renderCycles / 64000, (appStatistics.renderCycles / 6400) % 10);
+    lv_table_set_cell_value(infoApps, row, 1, buffer);
+    sprintf(buffer, "%lu.%lu", appStatistics.blockedUs / 1000, (appStatistics.blockedUs / 100) % 10);
+    lv_table_set_cell_value(infoApps, row, 2, buffer);
+    sprintf(buffer, "%lu.%lu", appStatistics.spiBusyUs / 1000, (appStatistics.spiBusyUs / 100) % 10);
+    lv_table_set_cell_value(infoApps, row, 3, buffer);
+    row++;
+  }
+  return std::make_unique<Screens::Label>(4, 6, app, infoApps);
+#else
+  const auto& statistics = lvgl.GetStatistics();
+  lv_obj_t* label = lv_label_create(lv_scr_act(), nullptr);
+  lv_label_set_recolor(label, true);
+  lv_label_set_text_fmt(label,
+                        "#808080 Display#\n"
+                        " #808080 frames# %lu\n"
+                        " #808080 flushes# %lu\n"
+                        " #808080 sent# %lukB\n"
+                        " #808080 merged# %lu\n"
+                        "#808080 Last frame#\n"
+                        " #808080 flushes# %lu\n"
+                        " #808080 sent# %luB\n"
+                        " #808080 time# %lums",
+                        statistics.nbFrames,
+                        statistics.nbFlushes,
+                        statistics.nbBytes / 1024,
+                        statistics.nbCoalescedAreas,
+                        statistics.lastFrameFlushes,
+                        statistics.lastFrameBytes,
+                        statistics.lastFrameTime);
+  lv_obj_align(label, lv_scr_act(), LV_ALIGN_CENTER, 0, 0);
+  return std::make_unique<Screens::Label>(4, 6, app, label);
+#endif
+}
+
+std::unique_ptr<Screen> SystemInfo::CreateScreen6() {
   lv_obj_t* label = lv_label_create(lv_scr_act(), nullptr);
   lv_label_set_recolor(label, true);
   lv_label_set_text_static(label,
@@ -282,5 +354,5 @@ std::unique_ptr<Screen> SystemInfo::CreateScreen5() {
                            "#FFFF00 InfiniTime#");
   lv_label_set_align(label, LV_LABEL_ALIGN_CENTER);
   lv_obj_align(label, lv_scr_act(), LV_ALIGN_CENTER, 0, 0);
-  return std::make_unique<Screens::Label>(4, 5, app, label);
+  return std::make_unique<Screens::Label>(5, 6, app, label);
 }
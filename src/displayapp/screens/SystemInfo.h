@@ -16,6 +16,10 @@ namespace Pinetime {
     class WatchdogView;
   }
 
+  namespace Components {
+    class LittleVgl;
+  }
+
   namespace Applications {
     class DisplayApp;
 
@@ -29,7 +33,8 @@ namespace Pinetime {
                             Pinetime::Controllers::Ble& bleController,
                             Pinetime::Drivers::WatchdogView& watchdog,
                             Pinetime::Controllers::MotionController& motionController,
-                            Pinetime::Drivers::Cst816S& touchPanel);
+                            Pinetime::Drivers::Cst816S& touchPanel,
+                            Pinetime::Components::LittleVgl& lvgl);
         ~SystemInfo() override;
         bool OnTouchEvent(TouchEvents event) override;
 
@@ -41,8 +46,9 @@ namespace Pinetime {
         Pinetime::Drivers::WatchdogView& watchdog;
         Pinetime::Controllers::MotionController& motionController;
         Pinetime::Drivers::Cst816S& touchPanel;
+        Pinetime::Components::LittleVgl& lvgl;
 
-        ScreenList<5> screens;
+        ScreenList<6> screens;
 
         static bool sortById(const TaskStatus_t& lhs, const TaskStatus_t& rhs);
 
@@ -51,6 +57,7 @@ namespace Pinetime {
         std::unique_ptr<Screen> CreateScreen3();
         std::unique_ptr<Screen> CreateScreen4();
         std::unique_ptr<Screen> CreateScreen5();
+        std::unique_ptr<Screen> CreateScreen6();
       };
     }
   }
@@ -7,6 +7,7 @@
 #include "displayapp/screens/BleIcon.h"
 #include "displayapp/screens/NotificationIcon.h"
 #include "displayapp/screens/Symbols.h"
+#include "displayapp/FlashFont.h"
 #include "components/battery/BatteryController.h"
 #include "components/ble/BleController.h"
 #include "components/ble/NotificationManager.h"
@@ -34,20 +35,16 @@ WatchFaceCasioStyleG7710::WatchFaceCasioStyleG7710(DisplayApp* app,
     heartRateController {heartRateController},
     motionController {motionController} {
 
-  lfs_file f = {};
-  if (filesystem.FileOpen(&f, "/fonts/lv_font_dots_40.bin", LFS_O_RDONLY) >= 0) {
-    filesystem.FileClose(&f);
-    font_dot40 = lv_font_load("F:/fonts/lv_font_dots_40.bin");
+  if (filesystem.ResourceExists("/fonts/lv_font_dots_40.bin")) {
+    font_dot40 = Components::FlashFont::Acquire("R:/fonts/lv_font_dots_40.bin");
   }
 
-  if (filesystem.FileOpen(&f, "/fonts/7segments_40.bin", LFS_O_RDONLY) >= 0) {
-    filesystem.FileClose(&f);
-    font_segment40 = lv_font_load("F:/fonts/7segments_40.bin");
+  if (filesystem.ResourceExists("/fonts/7segments_40.bin")) {
+    font_segment40 = Components::FlashFont::Acquire("R:/fonts/7segments_40.bin");
   }
 
-  if (filesystem.FileOpen(&f, "/fonts/7segments_115.bin", LFS_O_RDONLY) >= 0) {
-    filesystem.FileClose(&f);
-    font_segment115 = lv_font_load("F:/fonts/7segments_115.bin");
+  if (filesystem.ResourceExists("/fonts/7segments_115.bin")) {
+    font_segment115 = Components::FlashFont::Acquire("R:/fonts/7segments_115.bin");
   }
 
   label_battery_vallue = lv_label_create(lv_scr_act(), nullptr);
@@ -177,22 +174,23 @@ WatchFaceCasioStyleG7710::WatchFaceCasioStyleG7710(DisplayApp* app,
 WatchFaceCasioStyleG7710::~WatchFaceCasioStyleG7710() {
   lv_task_del(taskRefresh);
 
+  // The fonts are released once the labels that use them are deleted
+  lv_obj_clean(lv_scr_act());
+
   lv_style_reset(&style_line);
   lv_style_reset(&style_border);
 
   if (font_dot40 != nullptr) {
-    lv_font_free(font_dot40);
+    Components::FlashFont::Release(font_dot40);
   }
 
   if (font_segment40 != nullptr) {
-    lv_font_free(font_segment40);
+    Components::FlashFont::Release(font_segment40);
   }
 
   if (font_segment115 != nullptr) {
-    lv_font_free(font_segment115);
+    Components::FlashFont::Release(font_segment115);
   }
-
-  lv_obj_clean(lv_scr_act());
 }
 
 void WatchFaceCasioStyleG7710::Refresh() {
@@ -335,22 +333,6 @@ void WatchFaceCasioStyleG7710::Refresh() {
 }
 
 bool WatchFaceCasioStyleG7710::IsAvailable(Pinetime::Controllers::FS& filesystem) {
-  lfs_file file = {};
-
-  if (filesystem.FileOpen(&file, "/fonts/lv_font_dots_40.bin", LFS_O_RDONLY) < 0) {
-    return false;
-  }
-
-  filesystem.FileClose(&file);
-  if (filesystem.FileOpen(&file, "/fonts/7segments_40.bin", LFS_O_RDONLY) < 0) {
-    return false;
-  }
-
-  filesystem.FileClose(&file);
-  if (filesystem.FileOpen(&file, "/fonts/7segments_115.bin", LFS_O_RDONLY) < 0) {
-    return false;
-  }
-
-  filesystem.FileClose(&file);
-  return true;
+  return filesystem.ResourceExists("/fonts/lv_font_dots_40.bin") && filesystem.ResourceExists("/fonts/7segments_40.bin") &&
+         filesystem.ResourceExists("/fonts/7segments_115.bin");
 }
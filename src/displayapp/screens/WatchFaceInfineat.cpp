@@ -4,6 +4,7 @@
 #include <lvgl/lvgl.h>
 #include <cstdio>
 #include "displayapp/screens/Symbols.h"
+#include "displayapp/FlashFont.h"
 #include "displayapp/screens/BleIcon.h"
 #include "components/settings/Settings.h"
 #include "components/battery/BatteryController.h"
@@ -36,15 +37,12 @@ WatchFaceInfineat::WatchFaceInfineat(DisplayApp* app,
     notificationManager {notificationManager},
     settingsController {settingsController},
     motionController {motionController} {
-  lfs_file f = {};
-  if (filesystem.FileOpen(&f, "/fonts/teko.bin", LFS_O_RDONLY) >= 0) {
-    filesystem.FileClose(&f);
-    font_teko = lv_font_load("F:/fonts/teko.bin");
+  if (filesystem.ResourceExists("/fonts/teko.bin")) {
+    font_teko = Components::FlashFont::Acquire("R:/fonts/teko.bin");
   }
 
-  if (filesystem.FileOpen(&f, "/fonts/bebas.bin", LFS_O_RDONLY) >= 0) {
-    filesystem.FileClose(&f);
-    font_bebas = lv_font_load("F:/fonts/bebas.bin");
+  if (filesystem.ResourceExists("/fonts/bebas.bin")) {
+    font_bebas = Components::FlashFont::Acquire("R:/fonts/bebas.bin");
   }
 
   // Side Cover
@@ -71,7 +69,7 @@ WatchFaceInfineat::WatchFaceInfineat(DisplayApp* app,
   }
 
   logoPine = lv_img_create(lv_scr_act(), nullptr);
-  lv_img_set_src(logoPine, "F:/images/pine_small.bin");
+  lv_img_set_src(logoPine, "R:/images/pine_small.bin");
   lv_obj_set_pos(logoPine, 15, 106);
 
   lineBattery = lv_line_create(lv_scr_act(), nullptr);
@@ -212,14 +210,15 @@ WatchFaceInfineat::WatchFaceInfineat(DisplayApp* app,
 WatchFaceInfineat::~WatchFaceInfineat() {
   lv_task_del(taskRefresh);
 
+  // The fonts are released once the labels that use them are deleted
+  lv_obj_clean(lv_scr_act());
+
   if (font_bebas != nullptr) {
-    lv_font_free(font_bebas);
+    Components::FlashFont::Release(font_bebas);
   }
   if (font_teko != nullptr) {
-    lv_font_free(font_teko);
+    Components::FlashFont::Release(font_teko);
   }
-
-  lv_obj_clean(lv_scr_act());
 }
 
 bool WatchFaceInfineat::OnTouchEvent(Pinetime::Applications::TouchEvents event) {
@@ -442,22 +441,6 @@ void WatchFaceInfineat::ToggleBatteryIndicatorColor(bool showSideCover) {
 }
 
 bool WatchFaceInfineat::IsAvailable(Pinetime::Controllers::FS& filesystem) {
-  lfs_file file = {};
-
-  if (filesystem.FileOpen(&file, "/fonts/teko.bin", LFS_O_RDONLY) < 0) {
-    return false;
-  }
-
-  filesystem.FileClose(&file);
-  if (filesystem.FileOpen(&file, "/fonts/bebas.bin", LFS_O_RDONLY) < 0) {
-    return false;
-  }
-
-  filesystem.FileClose(&file);
-  if (filesystem.FileOpen(&file, "/images/pine_small.bin", LFS_O_RDONLY) < 0) {
-    return false;
-  }
-
-  filesystem.FileClose(&file);
-  return true;
+  return filesystem.ResourceExists("/fonts/teko.bin") && filesystem.ResourceExists("/fonts/bebas.bin") &&
+         filesystem.ResourceExists("/images/pine_small.bin");
 }
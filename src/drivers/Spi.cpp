@@ -4,17 +4,26 @@
 
 using namespace Pinetime::Drivers;
 
-Spi::Spi(SpiMaster& spiMaster, uint8_t pinCsn) : spiMaster {spiMaster}, pinCsn {pinCsn} {
+Spi::Spi(SpiMaster& spiMaster, uint8_t pinCsn, SpiMaster::Priority priority)
+  : spiMaster {spiMaster}, pinCsn {pinCsn}, priority {priority} {
   nrf_gpio_cfg_output(pinCsn);
   nrf_gpio_pin_set(pinCsn);
 }
 
 bool Spi::Write(const uint8_t* data, size_t size) {
-  return spiMaster.Write(pinCsn, data, size);
+  SpiMaster::Transaction transaction;
+  transaction.txData = data;
+  transaction.txDataSize = size;
+  return Transfer(transaction);
 }
 
 bool Spi::Read(uint8_t* cmd, size_t cmdSize, uint8_t* data, size_t dataSize) {
-  return spiMaster.Read(pinCsn, cmd, cmdSize, data, dataSize);
+  SpiMaster::Transaction transaction;
+  transaction.command = cmd;
+  transaction.commandSize = cmdSize;
+  transaction.rxData = data;
+  transaction.rxDataSize = dataSize;
+  return Transfer(transaction);
 }
 
 void Spi::Sleep() {
@@ -23,10 +32,64 @@ void Spi::Sleep() {
 }
 
 bool Spi::WriteCmdAndBuffer(const uint8_t* cmd, size_t cmdSize, const uint8_t* data, size_t dataSize) {
-  return spiMaster.WriteCmdAndBuffer(pinCsn, cmd, cmdSize, data, dataSize);
+  SpiMaster::Transaction transaction;
+  transaction.command = cmd;
+  transaction.commandSize = cmdSize;
+  transaction.txData = data;
+  transaction.txDataSize = dataSize;
+  return Transfer(transaction);
+}
+
+bool Spi::Transfer(SpiMaster::Transaction& transaction) {
+  if (!Start(transaction)) {
+    return false;
+  }
+  WaitCompleted();
+  return true;
+}
+
+bool Spi::Start(SpiMaster::Transaction& transaction) {
+  // Several tasks may share this device : only one of them can wait for transferCompleted at a time
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  transaction.taskToNotify = nullptr;
+  transaction.completedSemaphore = transferCompleted;
+  if (!Queue(transaction)) {
+    xSemaphoreGive(mutex);
+    return false;
+  }
+  return true;
+}
+
+void Spi::WaitCompleted() {
+  xSemaphoreTake(transferCompleted, portMAX_DELAY);
+  xSemaphoreGive(mutex);
+}
+
+bool Spi::Submit(SpiMaster::Transaction& transaction) {
+  // A task that started a transaction holds the mutex until it's completed : the transaction isn't queued between
+  // the transactions of another task
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  bool result = Queue(transaction);
+  xSemaphoreGive(mutex);
+  return result;
+}
+
+bool Spi::Queue(SpiMaster::Transaction& transaction) {
+  transaction.pinCsn = pinCsn;
+  transaction.priority = priority;
+  return spiMaster.Submit(transaction);
 }
 
 bool Spi::Init() {
+  if (mutex == nullptr) {
+    mutex = xSemaphoreCreateMutex();
+    ASSERT(mutex != nullptr);
+  }
+  if (transferCompleted == nullptr) {
+    transferCompleted = xSemaphoreCreateBinary();
+    ASSERT(transferCompleted != nullptr);
+  }
+
   nrf_gpio_pin_set(pinCsn); /* disable Set slave select (inactive high) */
   return true;
 }
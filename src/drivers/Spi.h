@@ -7,7 +7,7 @@ namespace Pinetime {
   namespace Drivers {
     class Spi {
     public:
-      Spi(SpiMaster& spiMaster, uint8_t pinCsn);
+      Spi(SpiMaster& spiMaster, uint8_t pinCsn, SpiMaster::Priority priority);
       Spi(const Spi&) = delete;
       Spi& operator=(const Spi&) = delete;
       Spi(Spi&&) = delete;
@@ -17,12 +17,26 @@ namespace Pinetime {
       bool Write(const uint8_t* data, size_t size);
       bool Read(uint8_t* cmd, size_t cmdSize, uint8_t* data, size_t dataSize);
       bool WriteCmdAndBuffer(const uint8_t* cmd, size_t cmdSize, const uint8_t* data, size_t dataSize);
+      // Sends the transaction and waits until it's completed
+      bool Transfer(SpiMaster::Transaction& transaction);
+      // Starts the transaction and returns immediately. WaitCompleted() must then be called by the same task,
+      // the other tasks can't use this device in the meantime.
+      bool Start(SpiMaster::Transaction& transaction);
+      void WaitCompleted();
+      // Queues the transaction and returns immediately. The caller is responsible for the completion notification.
+      // Waits while another task has a transaction in progress on this device (Start() to WaitCompleted()).
+      bool Submit(SpiMaster::Transaction& transaction);
       void Sleep();
       void Wakeup();
 
     private:
+      bool Queue(SpiMaster::Transaction& transaction);
+
       SpiMaster& spiMaster;
       uint8_t pinCsn;
+      SpiMaster::Priority priority;
+      SemaphoreHandle_t mutex = nullptr;
+      SemaphoreHandle_t transferCompleted = nullptr;
     };
   }
 }
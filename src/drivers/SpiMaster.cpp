@@ -6,15 +6,41 @@
 
 using namespace Pinetime::Drivers;
 
+namespace {
+  // EasyDMA can't transfer more than 255 bytes at once (MAXCNT is 8 bits wide)
+  constexpr size_t maxTransferSize = 255;
+  // Transfers shorter than this are not worth being split in equal parts for an ArrayList transfer
+  constexpr size_t minChainedTransferSize = 192;
+
+  // Large buffers are sent as a chain of equal sized EasyDMA transfers (ArrayList) :
+  //  - chainRestartPpiChannel restarts the SPIM on each END event,
+  //  - chainCountPpiChannel counts the END events in TIMER3,
+  //  - chainStopPpiChannel disables chainRestartPpiChannel (via chainPpiGroup) when the last transfer is started.
+  // TIMER3 CC[1] fires a single interrupt once the last transfer of the chain is done.
+  // PPI channels 4 and 5 are used by NimBLE.
+  constexpr uint8_t chainRestartPpiChannel = 1;
+  constexpr uint8_t chainCountPpiChannel = 2;
+  constexpr uint8_t chainStopPpiChannel = 3;
+  constexpr uint8_t chainPpiGroup = 0;
+  // FTPAN-58 workaround : SCK toggles trigger a GPIOTE event, and the PPI channel stops the SPIM on this event
+  constexpr uint8_t ftpan58PpiChannel = 0;
+  constexpr uint8_t ftpan58GpioteChannel = 0;
+
+#ifdef DISPLAY_PROFILER
+  volatile uint32_t busyTime = 0;
+  uint32_t transactionStartTime = 0;
+
+  uint32_t NowUs() {
+    NRF_TIMER4->TASKS_CAPTURE[0] = 1;
+    return NRF_TIMER4->CC[0];
+  }
+#endif
+}
+
 SpiMaster::SpiMaster(const SpiMaster::SpiModule spi, const SpiMaster::Parameters& params) : spi {spi}, params {params} {
 }
 
 bool SpiMaster::Init() {
-  if (mutex == nullptr) {
-    mutex = xSemaphoreCreateBinary();
-    ASSERT(mutex != nullptr);
-  }
-
   /* Configure GPIO pins used for pselsck, pselmosi, pselmiso and pselss for SPI0 */
   nrf_gpio_pin_set(params.pinSCK);
   nrf_gpio_cfg_output(params.pinSCK);
@@ -90,63 +116,107 @@ bool SpiMaster::Init() {
   NRFX_IRQ_PRIORITY_SET(SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQn, 2);
   NRFX_IRQ_ENABLE(SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQn);
 
-  xSemaphoreGive(mutex);
+  NRF_TIMER3->TASKS_STOP = 1;
+  NRF_TIMER3->MODE = TIMER_MODE_MODE_Counter << TIMER_MODE_MODE_Pos;
+  NRF_TIMER3->BITMODE = TIMER_BITMODE_BITMODE_16Bit << TIMER_BITMODE_BITMODE_Pos;
+  NRF_TIMER3->INTENCLR = 0xffffffff;
+  NRFX_IRQ_PRIORITY_SET(TIMER3_IRQn, 2);
+  NRFX_IRQ_ENABLE(TIMER3_IRQn);
+
   return true;
 }
 
-void SpiMaster::SetupWorkaroundForFtpan58(NRF_SPIM_Type* spim, uint32_t ppi_channel, uint32_t gpiote_channel) {
-  // Create an event when SCK toggles.
-  NRF_GPIOTE->CONFIG[gpiote_channel] = (GPIOTE_CONFIG_MODE_Event << GPIOTE_CONFIG_MODE_Pos) | (spim->PSEL.SCK << GPIOTE_CONFIG_PSEL_Pos) |
-                                       (GPIOTE_CONFIG_POLARITY_Toggle << GPIOTE_CONFIG_POLARITY_Pos);
+size_t SpiMaster::ChainedTransferSize(size_t size) {
+  // All the transfers of an ArrayList must have the same size : find the largest one that divides the buffer.
+  // Buffers sent to the display are made of full lines, so this usually succeeds in a few iterations.
+  // Flash reads (blocks of 2^n bytes) don't have such a divisor : 255 bytes transfers are chained then.
+  for (size_t transferSize = maxTransferSize; transferSize >= minChainedTransferSize; transferSize--) {
+    if ((size % transferSize) == 0) {
+      return transferSize;
+    }
+  }
+  // Otherwise, the remaining bytes will be sent by ContinueTransfer() once the chain is done
+  return maxTransferSize;
+}
+
+void SpiMaster::SetupChainedTransfer(size_t nbTransfers) {
+  NRF_TIMER3->TASKS_STOP = 1;
+  NRF_TIMER3->TASKS_CLEAR = 1;
+  NRF_TIMER3->CC[0] = nbTransfers - 1;
+  NRF_TIMER3->CC[1] = nbTransfers;
+  NRF_TIMER3->EVENTS_COMPARE[0] = 0;
+  NRF_TIMER3->EVENTS_COMPARE[1] = 0;
+  NRF_TIMER3->INTENSET = TIMER_INTENSET_COMPARE1_Msk;
+  NRF_TIMER3->TASKS_START = 1;
+
+  NRF_PPI->CH[chainRestartPpiChannel].EEP = (uint32_t) &spiBaseAddress->EVENTS_END;
+  NRF_PPI->CH[chainRestartPpiChannel].TEP = (uint32_t) &spiBaseAddress->TASKS_START;
+  NRF_PPI->CH[chainCountPpiChannel].EEP = (uint32_t) &spiBaseAddress->EVENTS_END;
+  NRF_PPI->CH[chainCountPpiChannel].TEP = (uint32_t) &NRF_TIMER3->TASKS_COUNT;
+  NRF_PPI->CH[chainStopPpiChannel].EEP = (uint32_t) &NRF_TIMER3->EVENTS_COMPARE[0];
+  NRF_PPI->CH[chainStopPpiChannel].TEP = (uint32_t) &NRF_PPI->TASKS_CHG[chainPpiGroup].DIS;
+  NRF_PPI->CHG[chainPpiGroup] = 1U << chainRestartPpiChannel;
+  NRF_PPI->CHENSET = (1U << chainRestartPpiChannel) | (1U << chainCountPpiChannel) | (1U << chainStopPpiChannel);
+
+  // The intermediate END and STARTED events must not wake the CPU up
+  spiBaseAddress->INTENCLR = (1 << 6);
+  spiBaseAddress->INTENCLR = (1 << 19);
+}
+
+void SpiMaster::DisableChainedTransfer() {
+  NRF_TIMER3->TASKS_STOP = 1;
+  NRF_TIMER3->INTENCLR = TIMER_INTENCLR_COMPARE1_Msk;
+  NRF_PPI->CHENCLR = (1U << chainRestartPpiChannel) | (1U << chainCountPpiChannel) | (1U << chainStopPpiChannel);
+  NRF_PPI->CHG[chainPpiGroup] = 0;
 
-  // Stop the spim instance when SCK toggles.
-  NRF_PPI->CH[ppi_channel].EEP = (uint32_t) &NRF_GPIOTE->EVENTS_IN[gpiote_channel];
-  NRF_PPI->CH[ppi_channel].TEP = (uint32_t) &spim->TASKS_STOP;
-  NRF_PPI->CHENSET = 1U << ppi_channel;
+  spiBaseAddress->TXD.LIST = 0;
+  spiBaseAddress->RXD.LIST = 0;
   spiBaseAddress->EVENTS_END = 0;
+  spiBaseAddress->EVENTS_STARTED = 0;
+  spiBaseAddress->INTENSET = (1 << 6);
+  spiBaseAddress->INTENSET = (1 << 19);
+}
 
-  // Disable IRQ
-  spim->INTENCLR = (1 << 6);
-  spim->INTENCLR = (1 << 1);
-  spim->INTENCLR = (1 << 19);
+void SpiMaster::SetupWorkaroundForFtpan58() {
+  // Create an event when SCK toggles.
+  NRF_GPIOTE->CONFIG[ftpan58GpioteChannel] = (GPIOTE_CONFIG_MODE_Event << GPIOTE_CONFIG_MODE_Pos) |
+                                             (spiBaseAddress->PSEL.SCK << GPIOTE_CONFIG_PSEL_Pos) |
+                                             (GPIOTE_CONFIG_POLARITY_Toggle << GPIOTE_CONFIG_POLARITY_Pos);
+
+  // Stop the spim instance when SCK toggles : the byte in progress is completed, and END is generated as usual
+  NRF_PPI->CH[ftpan58PpiChannel].EEP = (uint32_t) &NRF_GPIOTE->EVENTS_IN[ftpan58GpioteChannel];
+  NRF_PPI->CH[ftpan58PpiChannel].TEP = (uint32_t) &spiBaseAddress->TASKS_STOP;
+  NRF_PPI->CHENSET = 1U << ftpan58PpiChannel;
+  ftpan58WorkaroundEnabled = true;
 }
 
-void SpiMaster::DisableWorkaroundForFtpan58(NRF_SPIM_Type* spim, uint32_t ppi_channel, uint32_t gpiote_channel) {
-  NRF_GPIOTE->CONFIG[gpiote_channel] = 0;
-  NRF_PPI->CH[ppi_channel].EEP = 0;
-  NRF_PPI->CH[ppi_channel].TEP = 0;
-  NRF_PPI->CHENSET = ppi_channel;
-  spiBaseAddress->EVENTS_END = 0;
-  spim->INTENSET = (1 << 6);
-  spim->INTENSET = (1 << 1);
-  spim->INTENSET = (1 << 19);
+void SpiMaster::DisableWorkaroundForFtpan58() {
+  NRF_PPI->CHENCLR = 1U << ftpan58PpiChannel;
+  NRF_PPI->CH[ftpan58PpiChannel].EEP = 0;
+  NRF_PPI->CH[ftpan58PpiChannel].TEP = 0;
+  NRF_GPIOTE->CONFIG[ftpan58GpioteChannel] = 0;
+  ftpan58WorkaroundEnabled = false;
+}
+
+void SpiMaster::OnChainedTransferEndEvent() {
+  DisableChainedTransfer();
+  OnEndEvent();
 }
 
 void SpiMaster::OnEndEvent() {
-  if (currentBufferAddr == 0) {
+  if (ftpan58WorkaroundEnabled) {
+    DisableWorkaroundForFtpan58();
+  }
+  if (currentTransaction == nullptr) {
     return;
   }
 
-  auto s = currentBufferSize;
-  if (s > 0) {
-    auto currentSize = std::min((size_t) 255, s);
-    PrepareTx(currentBufferAddr, currentSize);
-    currentBufferAddr += currentSize;
-    currentBufferSize -= currentSize;
-
-    spiBaseAddress->TASKS_START = 1;
-  } else {
-    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-    if (taskToNotify != nullptr) {
-      vTaskNotifyGiveFromISR(taskToNotify, &xHigherPriorityTaskWoken);
-      portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
-    }
-
-    nrf_gpio_pin_set(this->pinCsn);
-    currentBufferAddr = 0;
-    BaseType_t xHigherPriorityTaskWoken2 = pdFALSE;
-    xSemaphoreGiveFromISR(mutex, &xHigherPriorityTaskWoken2);
-    portYIELD_FROM_ISR(xHigherPriorityTaskWoken | xHigherPriorityTaskWoken2);
+  if (currentBufferSize > 0) {
+    ContinueTransfer();
+  } else if (currentPhase == Phases::Command && currentCommandOffset < currentTransaction->commandSize) {
+    StartCommandSegment();
+  } else if (!StartNextPhase()) {
+    EndTransaction();
   }
 }
 
@@ -173,75 +243,200 @@ void SpiMaster::PrepareRx(const volatile uint32_t bufferAddress, const volatile
   spiBaseAddress->EVENTS_END = 0;
 }
 
-bool SpiMaster::Write(uint8_t pinCsn, const uint8_t* data, size_t size) {
-  if (data == nullptr)
+bool SpiMaster::Submit(Transaction& transaction) {
+  if (transaction.commandSize == 0 && transaction.txDataSize == 0 && transaction.rxDataSize == 0) {
     return false;
-  auto ok = xSemaphoreTake(mutex, portMAX_DELAY);
-  ASSERT(ok == true);
-  taskToNotify = xTaskGetCurrentTaskHandle();
+  }
+  if (transaction.txDataPatternSize > maxTransferSize) {
+    return false;
+  }
 
-  this->pinCsn = pinCsn;
+  // The SPIM interrupt is masked in this critical section : the queue and the current transaction
+  // can safely be modified, and the first transfer can be started before OnEndEvent() runs.
+  taskENTER_CRITICAL();
+  Enqueue(transaction);
+  if (currentTransaction == nullptr) {
+    currentTransaction = Dequeue();
+    StartTransaction();
+  }
+  taskEXIT_CRITICAL();
+  return true;
+}
 
-  if (size == 1) {
-    SetupWorkaroundForFtpan58(spiBaseAddress, 0, 0);
-  } else {
-    DisableWorkaroundForFtpan58(spiBaseAddress, 0, 0);
+void SpiMaster::Enqueue(Transaction& transaction) {
+  // Keep the queue sorted by priority, and in submission order for a given priority
+  transaction.next = nullptr;
+  Transaction** position = &pendingTransactions;
+  while (*position != nullptr && (*position)->priority >= transaction.priority) {
+    position = &((*position)->next);
   }
+  transaction.next = *position;
+  *position = &transaction;
+}
 
-  nrf_gpio_pin_clear(this->pinCsn);
+SpiMaster::Transaction* SpiMaster::Dequeue() {
+  Transaction* transaction = pendingTransactions;
+  if (transaction != nullptr) {
+    pendingTransactions = transaction->next;
+    transaction->next = nullptr;
+  }
+  return transaction;
+}
 
-  currentBufferAddr = (uint32_t) data;
-  currentBufferSize = size;
+void SpiMaster::StartTransaction() {
+#ifdef DISPLAY_PROFILER
+  transactionStartTime = NowUs();
+#endif
+  currentPhase = Phases::None;
+  currentPatternSize = 0;
+  nrf_gpio_pin_clear(currentTransaction->pinCsn);
+  StartNextPhase();
+}
 
-  auto currentSize = std::min((size_t) 255, (size_t) currentBufferSize);
-  PrepareTx(currentBufferAddr, currentSize);
-  currentBufferSize -= currentSize;
-  currentBufferAddr += currentSize;
-  spiBaseAddress->TASKS_START = 1;
+bool SpiMaster::StartNextPhase() {
+  const Transaction& transaction = *currentTransaction;
 
-  if (size == 1) {
-    while (spiBaseAddress->EVENTS_END == 0)
-      ;
-    nrf_gpio_pin_set(this->pinCsn);
-    currentBufferAddr = 0;
-    xSemaphoreGive(mutex);
+  if (currentPhase < Phases::Command && transaction.commandSize > 0) {
+    currentPhase = Phases::Command;
+    currentCommandOffset = 0;
+    StartCommandSegment();
+    return true;
   }
 
-  return true;
+  if (currentPhase < Phases::TxData && transaction.txDataSize > 0) {
+    currentPhase = Phases::TxData;
+    if (transaction.pinDataCommand != pinNotConnected) {
+      nrf_gpio_pin_set(transaction.pinDataCommand);
+    }
+    currentPatternSize = transaction.txDataPatternSize;
+    StartTransfer((uint32_t) transaction.txData, transaction.txDataSize);
+    return true;
+  }
+
+  if (currentPhase < Phases::RxData && transaction.rxDataSize > 0) {
+    currentPhase = Phases::RxData;
+    currentPatternSize = 0;
+    StartTransfer((uint32_t) transaction.rxData, transaction.rxDataSize);
+    return true;
+  }
+
+  return false;
 }
 
-bool SpiMaster::Read(uint8_t pinCsn, uint8_t* cmd, size_t cmdSize, uint8_t* data, size_t dataSize) {
-  xSemaphoreTake(mutex, portMAX_DELAY);
+void SpiMaster::StartCommandSegment() {
+  const Transaction& transaction = *currentTransaction;
+  size_t offset = currentCommandOffset;
+  size_t size = transaction.commandSize - offset;
+
+  if (transaction.pinDataCommand != pinNotConnected) {
+    // Send all the consecutive command bytes (or parameters) at once
+    auto isParameter = [&transaction](size_t index) {
+      return index < maxCommandWithParametersSize && ((transaction.commandParametersMask >> index) & 1U) != 0;
+    };
+    bool parameter = isParameter(offset);
+    size = 1;
+    while ((offset + size) < transaction.commandSize && isParameter(offset + size) == parameter) {
+      size++;
+    }
 
-  taskToNotify = nullptr;
+    if (parameter) {
+      nrf_gpio_pin_set(transaction.pinDataCommand);
+    } else {
+      nrf_gpio_pin_clear(transaction.pinDataCommand);
+    }
+  }
 
-  this->pinCsn = pinCsn;
-  DisableWorkaroundForFtpan58(spiBaseAddress, 0, 0);
-  spiBaseAddress->INTENCLR = (1 << 6);
-  spiBaseAddress->INTENCLR = (1 << 1);
-  spiBaseAddress->INTENCLR = (1 << 19);
+  currentCommandOffset = offset + size;
+  StartTransfer((uint32_t) (transaction.command + offset), size);
+}
 
-  nrf_gpio_pin_clear(this->pinCsn);
+void SpiMaster::StartTransfer(uint32_t bufferAddress, size_t size) {
+  currentBufferAddr = bufferAddress;
+  currentBufferSize = size;
 
-  currentBufferAddr = 0;
-  currentBufferSize = 0;
+  size_t transferSize = 0;
+  size_t nbTransfers = 0;
+  if (currentPatternSize > 0) {
+    transferSize = currentPatternSize;
+    nbTransfers = size / transferSize;
+  } else if (size > maxTransferSize) {
+    transferSize = ChainedTransferSize(size);
+    nbTransfers = size / transferSize;
+  }
 
-  PrepareTx((uint32_t) cmd, cmdSize);
-  spiBaseAddress->TASKS_START = 1;
-  while (spiBaseAddress->EVENTS_END == 0)
-    ;
+  if (nbTransfers > 1) {
+    // The whole chain is sent (or received) without CPU intervention, OnChainedTransferEndEvent() is called at the end
+    if (currentPhase == Phases::RxData) {
+      PrepareRx(currentBufferAddr, transferSize);
+      spiBaseAddress->RXD.LIST = SPIM_RXD_LIST_LIST_ArrayList << SPIM_RXD_LIST_LIST_Pos;
+      currentBufferAddr += nbTransfers * transferSize;
+    } else {
+      PrepareTx(currentBufferAddr, transferSize);
+      if (currentPatternSize == 0) {
+        spiBaseAddress->TXD.LIST = SPIM_TXD_LIST_LIST_ArrayList << SPIM_TXD_LIST_LIST_Pos;
+        currentBufferAddr += nbTransfers * transferSize;
+      }
+    }
+    // Without ArrayList, the pattern is sent again from the same address at each restart
+    SetupChainedTransfer(nbTransfers);
+    currentBufferSize -= nbTransfers * transferSize;
+    spiBaseAddress->TASKS_START = 1;
+  } else {
+    ContinueTransfer();
+  }
+}
+
+void SpiMaster::ContinueTransfer() {
+  auto currentSize = std::min((currentPatternSize > 0) ? (size_t) currentPatternSize : maxTransferSize, (size_t) currentBufferSize);
+  if (currentPhase == Phases::RxData) {
+    PrepareRx(currentBufferAddr, currentSize);
+    // FTPAN-58 : an extra byte is clocked out when RXD.MAXCNT == 1 and TXD.MAXCNT <= 1 (a single byte read, such as
+    // the status register of the flash memory). Writes are not affected.
+    if (currentSize == 1) {
+      SetupWorkaroundForFtpan58();
+    }
+  } else {
+    PrepareTx(currentBufferAddr, currentSize);
+  }
+  if (currentPatternSize == 0) {
+    currentBufferAddr += currentSize;
+  }
+  currentBufferSize -= currentSize;
 
-  PrepareRx((uint32_t) data, dataSize);
   spiBaseAddress->TASKS_START = 1;
+}
 
-  while (spiBaseAddress->EVENTS_END == 0)
-    ;
-  nrf_gpio_pin_set(this->pinCsn);
+void SpiMaster::EndTransaction() {
+  // Called from the SPIM interrupt : tasks can't modify the queue at the same time
+  Transaction* transaction = currentTransaction;
+  nrf_gpio_pin_set(transaction->pinCsn);
+#ifdef DISPLAY_PROFILER
+  busyTime += NowUs() - transactionStartTime;
+#endif
+  TaskHandle_t taskToNotify = transaction->taskToNotify;
+  SemaphoreHandle_t completedSemaphore = transaction->completedSemaphore;
+
+  // The transaction may be reused as soon as its owner is notified : start the next one first
+  currentTransaction = Dequeue();
+  if (currentTransaction != nullptr) {
+    StartTransaction();
+  }
 
-  xSemaphoreGive(mutex);
+  BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+  if (taskToNotify != nullptr) {
+    vTaskNotifyGiveFromISR(taskToNotify, &xHigherPriorityTaskWoken);
+  }
+  if (completedSemaphore != nullptr) {
+    xSemaphoreGiveFromISR(completedSemaphore, &xHigherPriorityTaskWoken);
+  }
+  portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
 
-  return true;
+#ifdef DISPLAY_PROFILER
+uint32_t SpiMaster::BusyTime() {
+  return busyTime;
 }
+#endif
 
 void SpiMaster::Sleep() {
   while (spiBaseAddress->ENABLE != 0) {
@@ -258,36 +453,3 @@ void SpiMaster::Wakeup() {
   Init();
   NRF_LOG_INFO("[SPIMASTER] Wakeup");
 }
-
-bool SpiMaster::WriteCmdAndBuffer(uint8_t pinCsn, const uint8_t* cmd, size_t cmdSize, const uint8_t* data, size_t dataSize) {
-  xSemaphoreTake(mutex, portMAX_DELAY);
-
-  taskToNotify = nullptr;
-
-  this->pinCsn = pinCsn;
-  DisableWorkaroundForFtpan58(spiBaseAddress, 0, 0);
-  spiBaseAddress->INTENCLR = (1 << 6);
-  spiBaseAddress->INTENCLR = (1 << 1);
-  spiBaseAddress->INTENCLR = (1 << 19);
-
-  nrf_gpio_pin_clear(this->pinCsn);
-
-  currentBufferAddr = 0;
-  currentBufferSize = 0;
-
-  PrepareTx((uint32_t) cmd, cmdSize);
-  spiBaseAddress->TASKS_START = 1;
-  while (spiBaseAddress->EVENTS_END == 0)
-    ;
-
-  PrepareTx((uint32_t) data, dataSize);
-  spiBaseAddress->TASKS_START = 1;
-
-  while (spiBaseAddress->EVENTS_END == 0)
-    ;
-  nrf_gpio_pin_set(this->pinCsn);
-
-  xSemaphoreGive(mutex);
-
-  return true;
-}
@@ -14,6 +14,8 @@ namespace Pinetime {
       enum class BitOrder : uint8_t { Msb_Lsb, Lsb_Msb };
       enum class Modes : uint8_t { Mode0, Mode1, Mode2, Mode3 };
       enum class Frequencies : uint8_t { Freq8Mhz };
+      // When several transactions are waiting for the bus, the ones with the highest priority are started first.
+      enum class Priority : uint8_t { Low, Normal, High };
 
       struct Parameters {
         BitOrder bitOrder;
@@ -24,6 +26,36 @@ namespace Pinetime {
         uint8_t pinMISO;
       };
 
+      static constexpr uint8_t pinNotConnected = 0xff;
+      static constexpr size_t maxCommandWithParametersSize = 32;
+
+      // A transaction is sent with CS asserted from start to end :
+      // the command is sent first, then txData, then rxData is received.
+      // If pinDataCommand is connected, it is cleared while the command is sent and set while txData is sent.
+      // The command can also embed parameters (bit n of commandParametersMask set means that the byte n of the command
+      // is a parameter) : pinDataCommand is then switched at each boundary between command bytes and parameters,
+      // so that a sequence of commands and parameters is sent in a single transaction.
+      // If txDataPatternSize is not 0, txData is a pattern of txDataPatternSize bytes (at most 255) that is sent
+      // repeatedly until txDataSize bytes are sent : large areas of a single color are sent from a small buffer.
+      // The transaction must stay valid until it's completed, and then taskToNotify is notified and/or
+      // completedSemaphore is given (from the SPIM interrupt).
+      struct Transaction {
+        uint8_t pinCsn = pinNotConnected;
+        uint8_t pinDataCommand = pinNotConnected;
+        Priority priority = Priority::Normal;
+        const uint8_t* command = nullptr;
+        size_t commandSize = 0;
+        uint32_t commandParametersMask = 0;
+        const uint8_t* txData = nullptr;
+        size_t txDataSize = 0;
+        size_t txDataPatternSize = 0;
+        uint8_t* rxData = nullptr;
+        size_t rxDataSize = 0;
+        TaskHandle_t taskToNotify = nullptr;
+        SemaphoreHandle_t completedSemaphore = nullptr;
+        Transaction* next = nullptr;
+      };
+
       SpiMaster(const SpiModule spi, const Parameters& params);
       SpiMaster(const SpiMaster&) = delete;
       SpiMaster& operator=(const SpiMaster&) = delete;
@@ -31,33 +63,54 @@ namespace Pinetime {
       SpiMaster& operator=(SpiMaster&&) = delete;
 
       bool Init();
-      bool Write(uint8_t pinCsn, const uint8_t* data, size_t size);
-      bool Read(uint8_t pinCsn, uint8_t* cmd, size_t cmdSize, uint8_t* data, size_t dataSize);
-
-      bool WriteCmdAndBuffer(uint8_t pinCsn, const uint8_t* cmd, size_t cmdSize, const uint8_t* data, size_t dataSize);
+      // Queues the transaction and returns immediately
+      bool Submit(Transaction& transaction);
 
       void OnStartedEvent();
       void OnEndEvent();
+      void OnChainedTransferEndEvent();
 
       void Sleep();
       void Wakeup();
 
+#ifdef DISPLAY_PROFILER
+      // Time during which a transaction was in progress, in µs (TIMER4 is started by the display profiler)
+      static uint32_t BusyTime();
+#endif
+
     private:
-      void SetupWorkaroundForFtpan58(NRF_SPIM_Type* spim, uint32_t ppi_channel, uint32_t gpiote_channel);
-      void DisableWorkaroundForFtpan58(NRF_SPIM_Type* spim, uint32_t ppi_channel, uint32_t gpiote_channel);
+      enum class Phases : uint8_t { None, Command, TxData, RxData };
+
       void PrepareTx(const volatile uint32_t bufferAddress, const volatile size_t size);
       void PrepareRx(const volatile uint32_t bufferAddress, const volatile size_t size);
+      void SetupChainedTransfer(size_t nbTransfers);
+      void DisableChainedTransfer();
+      static size_t ChainedTransferSize(size_t size);
+      void SetupWorkaroundForFtpan58();
+      void DisableWorkaroundForFtpan58();
+
+      void Enqueue(Transaction& transaction);
+      Transaction* Dequeue();
+      void StartTransaction();
+      bool StartNextPhase();
+      void StartCommandSegment();
+      void StartTransfer(uint32_t bufferAddress, size_t size);
+      void ContinueTransfer();
+      void EndTransaction();
 
       NRF_SPIM_Type* spiBaseAddress;
-      uint8_t pinCsn;
 
       SpiMaster::SpiModule spi;
       SpiMaster::Parameters params;
 
+      Transaction* pendingTransactions = nullptr;
+      Transaction* volatile currentTransaction = nullptr;
+      volatile Phases currentPhase = Phases::None;
+      volatile size_t currentCommandOffset = 0;
       volatile uint32_t currentBufferAddr = 0;
       volatile size_t currentBufferSize = 0;
-      volatile TaskHandle_t taskToNotify;
-      SemaphoreHandle_t mutex = nullptr;
+      volatile size_t currentPatternSize = 0;
+      volatile bool ftpan58WorkaroundEnabled = false;
     };
   }
 }
@@ -1,4 +1,6 @@
 #include "drivers/SpiNorFlash.h"
+#include <algorithm>
+#include <cstring>
 #include <hal/nrf_gpio.h>
 #include <libraries/delay/nrf_delay.h>
 #include <libraries/log/nrf_log.h>
@@ -6,10 +8,23 @@
 
 using namespace Pinetime::Drivers;
 
+namespace {
+  // The status register is polled quickly (without yielding) a few times when a short operation is late,
+  // and then more and more slowly, up to maxPollDelay ticks.
+  constexpr uint32_t busyPollIntervalUs = 100;
+  constexpr uint8_t maxBusyPolls = 8;
+  constexpr TickType_t maxPollDelay = 16;
+}
+
 SpiNorFlash::SpiNorFlash(Spi& spi) : spi {spi} {
 }
 
 void SpiNorFlash::Init() {
+  if (mutex == nullptr) {
+    mutex = xSemaphoreCreateRecursiveMutex();
+    ASSERT(mutex != nullptr);
+  }
+  spi.Init();
   device_id = ReadIdentificaion();
   NRF_LOG_INFO("[SpiNorFlash] Manufacturer : %d, Memory type : %d, memory density : %d",
                device_id.manufacturer,
@@ -21,8 +36,12 @@ void SpiNorFlash::Uninit() {
 }
 
 void SpiNorFlash::Sleep() {
+  // The pending writes would be lost in deep power-down mode
+  xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+  Sync();
   auto cmd = static_cast<uint8_t>(Commands::DeepPowerDown);
   spi.Write(&cmd, sizeof(uint8_t));
+  xSemaphoreGiveRecursive(mutex);
   NRF_LOG_INFO("[SpiNorFlash] Sleep")
 }
 
@@ -71,12 +90,43 @@ uint8_t SpiNorFlash::ReadConfigurationRegister() {
 }
 
 void SpiNorFlash::Read(uint32_t address, uint8_t* buffer, size_t size) {
-  static constexpr uint8_t cmdSize = 4;
-  uint8_t cmd[cmdSize] = {static_cast<uint8_t>(Commands::Read),
-                          static_cast<uint8_t>(address >> 16U),
-                          static_cast<uint8_t>(address >> 8U),
-                          static_cast<uint8_t>(address)};
-  spi.Read(reinterpret_cast<uint8_t*>(&cmd), cmdSize, buffer, size);
+  StartRead(address, buffer, size);
+  WaitRead();
+}
+
+void SpiNorFlash::StartRead(uint32_t address, uint8_t* buffer, size_t size) {
+  // The mutex is released by WaitRead() : the pending writes can't be modified until then
+  xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+  // The pending writes are programmed first only if they are in the range that is read : the data written behind
+  // can be read back without breaking the page being gathered
+  if (writeBufferSize > 0 && address < writeBufferAddress + writeBufferSize && writeBufferAddress < address + size) {
+    ProgramWriteBuffer();
+  }
+  WaitWhileBusy();
+
+  // The command and the transaction must stay valid until the end of the transfer
+  readCommand[0] = static_cast<uint8_t>(Commands::Read);
+  readCommand[1] = static_cast<uint8_t>(address >> 16U);
+  readCommand[2] = static_cast<uint8_t>(address >> 8U);
+  readCommand[3] = static_cast<uint8_t>(address);
+
+  readTransaction = {};
+  readTransaction.command = readCommand;
+  readTransaction.commandSize = readCommandSize;
+  readTransaction.rxData = buffer;
+  readTransaction.rxDataSize = size;
+  readPending = spi.Start(readTransaction);
+  if (!readPending) {
+    xSemaphoreGiveRecursive(mutex);
+  }
+}
+
+void SpiNorFlash::WaitRead() {
+  if (readPending) {
+    spi.WaitCompleted();
+    readPending = false;
+    xSemaphoreGiveRecursive(mutex);
+  }
 }
 
 void SpiNorFlash::WriteEnable() {
@@ -85,20 +135,56 @@ void SpiNorFlash::WriteEnable() {
 }
 
 void SpiNorFlash::SectorErase(uint32_t sectorAddress) {
+  Erase(Commands::SectorErase, sectorAddress, sectorEraseTimeUs);
+}
+
+void SpiNorFlash::BlockErase32K(uint32_t blockAddress) {
+  Erase(Commands::BlockErase32K, blockAddress, block32KEraseTimeUs);
+}
+
+void SpiNorFlash::BlockErase64K(uint32_t blockAddress) {
+  Erase(Commands::BlockErase64K, blockAddress, block64KEraseTimeUs);
+}
+
+size_t SpiNorFlash::EraseLargestBlock(uint32_t address, size_t size) {
+  // Erasing a 64KB block takes about a third of the time needed to erase its 16 sectors
+  if ((address % block64KSize) == 0 && size >= block64KSize) {
+    BlockErase64K(address);
+    return block64KSize;
+  }
+  if ((address % block32KSize) == 0 && size >= block32KSize) {
+    BlockErase32K(address);
+    return block32KSize;
+  }
+  SectorErase(address);
+  return sectorSize;
+}
+
+void SpiNorFlash::EraseRange(uint32_t address, size_t size) {
+  while (size > 0) {
+    size_t erased = std::min(EraseLargestBlock(address, size), size);
+    address += erased;
+    size -= erased;
+  }
+}
+
+void SpiNorFlash::Erase(Commands command, uint32_t address, uint32_t expectedDurationUs) {
   static constexpr uint8_t cmdSize = 4;
-  uint8_t cmd[cmdSize] = {static_cast<uint8_t>(Commands::SectorErase),
-                          static_cast<uint8_t>(sectorAddress >> 16U),
-                          static_cast<uint8_t>(sectorAddress >> 8U),
-                          static_cast<uint8_t>(sectorAddress)};
+  uint8_t cmd[cmdSize] = {static_cast<uint8_t>(command),
+                          static_cast<uint8_t>(address >> 16U),
+                          static_cast<uint8_t>(address >> 8U),
+                          static_cast<uint8_t>(address)};
 
-  WriteEnable();
-  while (!WriteEnabled())
-    vTaskDelay(1);
+  xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+  ProgramWriteBuffer();
+  WaitWhileBusy();
 
+  // The write enable latch is set as soon as the command is completed
+  WriteEnable();
   spi.Read(reinterpret_cast<uint8_t*>(&cmd), cmdSize, nullptr, 0);
-
-  while (WriteInProgress())
-    vTaskDelay(1);
+  SetBusy(expectedDurationUs);
+  WaitWhileBusy();
+  xSemaphoreGiveRecursive(mutex);
 }
 
 uint8_t SpiNorFlash::ReadSecurityRegister() {
@@ -117,31 +203,104 @@ bool SpiNorFlash::EraseFailed() {
 }
 
 void SpiNorFlash::Write(uint32_t address, const uint8_t* buffer, size_t size) {
+  xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+  WriteBehind(address, buffer, size);
+  // The failures are kept for the next Sync() : the caller may have written other data behind before
+  ProgramWriteBuffer();
+  WaitWhileBusy();
+  xSemaphoreGiveRecursive(mutex);
+}
+
+void SpiNorFlash::WriteBehind(uint32_t address, const uint8_t* buffer, size_t size) {
+  xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+  while (size > 0) {
+    if (writeBufferSize > 0 && address != writeBufferAddress + writeBufferSize) {
+      ProgramWriteBuffer();
+    }
+    if (writeBufferSize == 0) {
+      writeBufferAddress = address;
+    }
+
+    // A page program can't cross a page boundary
+    uint32_t pageLimit = (writeBufferAddress & ~(pageSize - 1u)) + pageSize;
+    size_t toCopy = std::min(size, static_cast<size_t>(pageLimit - address));
+    std::memcpy(writeBuffer + writeBufferSize, buffer, toCopy);
+    writeBufferSize += toCopy;
+    address += toCopy;
+    buffer += toCopy;
+    size -= toCopy;
+
+    if (address == pageLimit) {
+      ProgramWriteBuffer();
+    }
+  }
+  xSemaphoreGiveRecursive(mutex);
+}
+
+bool SpiNorFlash::Sync() {
+  xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+  ProgramWriteBuffer();
+  WaitWhileBusy();
+  bool failed = programFailed;
+  programFailed = false;
+  xSemaphoreGiveRecursive(mutex);
+  return !failed;
+}
+
+void SpiNorFlash::ProgramWriteBuffer() {
+  if (writeBufferSize == 0) {
+    return;
+  }
+
   static constexpr uint8_t cmdSize = 4;
+  uint8_t cmd[cmdSize] = {static_cast<uint8_t>(Commands::PageProgram),
+                          static_cast<uint8_t>(writeBufferAddress >> 16U),
+                          static_cast<uint8_t>(writeBufferAddress >> 8U),
+                          static_cast<uint8_t>(writeBufferAddress)};
 
-  size_t len = size;
-  uint32_t addr = address;
-  const uint8_t* b = buffer;
-  while (len > 0) {
-    uint32_t pageLimit = (addr & ~(pageSize - 1u)) + pageSize;
-    uint32_t toWrite = pageLimit - addr > len ? len : pageLimit - addr;
+  WaitWhileBusy();
+  WriteEnable();
+  spi.WriteCmdAndBuffer(cmd, cmdSize, writeBuffer, writeBufferSize);
+  // The data is transferred : the page is programmed by the flash memory while the buffer is filled again
+  writeBufferSize = 0;
+  SetBusy(pageProgramTimeUs);
+  programming = true;
+}
 
-    uint8_t cmd[cmdSize] = {static_cast<uint8_t>(Commands::PageProgram),
-                            static_cast<uint8_t>(addr >> 16U),
-                            static_cast<uint8_t>(addr >> 8U),
-                            static_cast<uint8_t>(addr)};
+void SpiNorFlash::SetBusy(uint32_t expectedDurationUs) {
+  busy = true;
+  busyStartTime = xTaskGetTickCount();
+  busyDuration = (expectedDurationUs * configTICK_RATE_HZ) / 1000000;
+}
 
-    WriteEnable();
-    while (!WriteEnabled())
-      vTaskDelay(1);
+void SpiNorFlash::WaitWhileBusy() {
+  if (!busy) {
+    return;
+  }
 
-    spi.WriteCmdAndBuffer(cmd, cmdSize, b, toWrite);
+  // Don't poll the status register before the operation is likely to be completed
+  TickType_t elapsed = xTaskGetTickCount() - busyStartTime;
+  if (elapsed < busyDuration) {
+    vTaskDelay(busyDuration - elapsed);
+  }
 
-    while (WriteInProgress())
-      vTaskDelay(1);
+  uint8_t nbPolls = 0;
+  TickType_t delay = 1;
+  while (WriteInProgress()) {
+    if (busyDuration == 0 && nbPolls < maxBusyPolls) {
+      // A page program is shorter than a tick : sleeping would at least double its duration
+      nrf_delay_us(busyPollIntervalUs);
+      nbPolls++;
+    } else {
+      vTaskDelay(delay);
+      delay = std::min(static_cast<TickType_t>(delay * 2), maxPollDelay);
+    }
+  }
+  busy = false;
 
-    addr += toWrite;
-    b += toWrite;
-    len -= toWrite;
+  // The status of a program is overwritten by the next program or erase : it's checked after each page
+  if (programming) {
+    programming = false;
+    programFailed = programFailed || ProgramFailed();
   }
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include <cstddef>
 #include <cstdint>
+#include "drivers/SpiMaster.h"
 
 namespace Pinetime {
   namespace Drivers {
@@ -26,9 +27,31 @@ namespace Pinetime {
       bool WriteEnabled();
       uint8_t ReadConfigurationRegister();
       void Read(uint32_t address, uint8_t* buffer, size_t size);
+      // Starts reading size bytes at address into buffer and returns immediately : the data is received by DMA
+      // while the calling task keeps running. WaitRead() must be called by the same task before using buffer
+      // and before any other access to the flash memory.
+      void StartRead(uint32_t address, uint8_t* buffer, size_t size);
+      void WaitRead();
+      // Programs buffer and waits until the data is written. A failure is reported by the next call to Sync().
+      // buffer is copied to the page buffer before the transfer : it can be in the flash memory of the MCU, which
+      // EasyDMA can't read.
       void Write(uint32_t address, const uint8_t* buffer, size_t size);
+      // Copies buffer in the write-behind queue and returns as soon as possible : consecutive writes are gathered
+      // in a page buffer, and each page is programmed while the caller keeps running. Erases, and reads of the
+      // pending data, wait for the pending writes. Sync() must be called to make sure that the data is written.
+      void WriteBehind(uint32_t address, const uint8_t* buffer, size_t size);
+      // Programs the pending writes and waits until they are completed. Returns false if a program failed since
+      // the previous call.
+      bool Sync();
       void WriteEnable();
       void SectorErase(uint32_t sectorAddress);
+      void BlockErase32K(uint32_t blockAddress);
+      void BlockErase64K(uint32_t blockAddress);
+      // Erases the largest block (64KB, 32KB or 4KB sector) that starts at address and fits in size bytes,
+      // and returns the size of this block. address and size must be multiples of the sector size.
+      size_t EraseLargestBlock(uint32_t address, size_t size);
+      // Erases [address, address + size[ with as few erase operations as possible
+      void EraseRange(uint32_t address, size_t size);
       uint8_t ReadSecurityRegister();
       bool ProgramFailed();
       bool EraseFailed();
@@ -48,14 +71,45 @@ namespace Pinetime {
         ReadConfigurationRegister = 0x15,
         SectorErase = 0x20,
         ReadSecurityRegister = 0x2B,
+        BlockErase32K = 0x52,
         ReadIdentification = 0x9F,
         ReleaseFromDeepPowerDown = 0xAB,
-        DeepPowerDown = 0xB9
+        DeepPowerDown = 0xB9,
+        BlockErase64K = 0xD8
       };
       static constexpr uint16_t pageSize = 256;
+      static constexpr uint32_t sectorSize = 0x1000;
+      static constexpr uint32_t block32KSize = 0x8000;
+      static constexpr uint32_t block64KSize = 0x10000;
+      // Typical durations of the internal operations of the flash memory
+      static constexpr uint32_t pageProgramTimeUs = 700;
+      static constexpr uint32_t sectorEraseTimeUs = 45000;
+      static constexpr uint32_t block32KEraseTimeUs = 150000;
+      static constexpr uint32_t block64KEraseTimeUs = 250000;
+
+      void Erase(Commands command, uint32_t address, uint32_t expectedDurationUs);
+      void ProgramWriteBuffer();
+      void SetBusy(uint32_t expectedDurationUs);
+      void WaitWhileBusy();
 
       Spi& spi;
       Identification device_id;
+
+      static constexpr uint8_t readCommandSize = 4;
+      uint8_t readCommand[readCommandSize];
+      SpiMaster::Transaction readTransaction;
+      bool readPending = false;
+
+      // Taken by the operations that access the flash memory : the write-behind queue is shared by all the tasks
+      SemaphoreHandle_t mutex = nullptr;
+      uint8_t writeBuffer[pageSize];
+      uint32_t writeBufferAddress = 0;
+      size_t writeBufferSize = 0;
+      bool busy = false;
+      bool programming = false;
+      bool programFailed = false;
+      TickType_t busyStartTime = 0;
+      TickType_t busyDuration = 0;
     };
   }
 }
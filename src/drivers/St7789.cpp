@@ -31,17 +31,19 @@ void St7789::Init() {
 }
 
 void St7789::WriteCommand(uint8_t cmd) {
-  nrf_gpio_pin_clear(pinDataCommand);
-  WriteSpi(&cmd, 1);
+  SpiMaster::Transaction transaction;
+  transaction.pinDataCommand = pinDataCommand;
+  transaction.command = &cmd;
+  transaction.commandSize = 1;
+  spi.Transfer(transaction);
 }
 
-void St7789::WriteData(uint8_t data) {
-  nrf_gpio_pin_set(pinDataCommand);
-  WriteSpi(&data, 1);
-}
-
-void St7789::WriteSpi(const uint8_t* data, size_t size) {
-  spi.Write(data, size);
+void St7789::WriteData(const uint8_t* data, size_t size) {
+  SpiMaster::Transaction transaction;
+  transaction.pinDataCommand = pinDataCommand;
+  transaction.txData = data;
+  transaction.txDataSize = size;
+  spi.Transfer(transaction);
 }
 
 void St7789::SoftwareReset() {
@@ -57,14 +59,23 @@ void St7789::SleepIn() {
   WriteCommand(static_cast<uint8_t>(Commands::SleepIn));
 }
 
+void St7789::SetColorFormat(ColorFormats format) {
+  colorFormat = format;
+}
+
 void St7789::ColMod() {
-  WriteCommand(static_cast<uint8_t>(Commands::ColMod));
-  WriteData(0x55);
+  CommandBatch batch;
+  batch.AddCommand(Commands::ColMod);
+  // [4 .. 6] = RGB interface color format, 101 = 65K
+  // [0 .. 2] = Control interface color format, 011 = 12 bits/pixel, 101 = 16 bits/pixel
+  batch.AddParameter(static_cast<uint8_t>((colorFormat == ColorFormats::Rgb444) ? 0x53 : 0x55));
+  batch.Send(spi, pinDataCommand);
   nrf_delay_ms(10);
 }
 
 void St7789::MemoryDataAccessControl() {
-  WriteCommand(static_cast<uint8_t>(Commands::MemoryDataAccessControl));
+  CommandBatch batch;
+  batch.AddCommand(Commands::MemoryDataAccessControl);
 #ifdef DRIVER_DISPLAY_MIRROR
   // [7] = MY = Page Address Order, 0 = Top to bottom, 1 = Bottom to top
   // [6] = MX = Column Address Order, 0 = Left to right, 1 = Right to left
@@ -73,26 +84,27 @@ void St7789::MemoryDataAccessControl() {
   // [3] = RGB = RGB/BGR Order, 0 = RGB, 1 = BGR
   // [2] = MH = Display Data Latch Order, 0 = LCD refresh from left to right, 1 = Right to left
   // [0 .. 1] = Unused
-  WriteData(0b01000000);
+  batch.AddParameter(static_cast<uint8_t>(0b01000000));
 #else
-  WriteData(0x00);
+  batch.AddParameter(static_cast<uint8_t>(0x00));
 #endif
+  batch.Send(spi, pinDataCommand);
 }
 
 void St7789::ColumnAddressSet() {
-  WriteCommand(static_cast<uint8_t>(Commands::ColumnAddressSet));
-  WriteData(0x00);
-  WriteData(0x00);
-  WriteData(Width >> 8u);
-  WriteData(Width & 0xffu);
+  CommandBatch batch;
+  batch.AddCommand(Commands::ColumnAddressSet);
+  batch.AddParameter(static_cast<uint16_t>(0));
+  batch.AddParameter(Width);
+  batch.Send(spi, pinDataCommand);
 }
 
 void St7789::RowAddressSet() {
-  WriteCommand(static_cast<uint8_t>(Commands::RowAddressSet));
-  WriteData(0x00);
-  WriteData(0x00);
-  WriteData(320u >> 8u);
-  WriteData(320u & 0xffu);
+  CommandBatch batch;
+  batch.AddCommand(Commands::RowAddressSet);
+  batch.AddParameter(static_cast<uint16_t>(0));
+  batch.AddParameter(Height);
+  batch.Send(spi, pinDataCommand);
 }
 
 void St7789::DisplayInversionOn() {
@@ -110,19 +122,15 @@ void St7789::DisplayOn() {
 }
 
 void St7789::SetAddrWindow(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
-  WriteCommand(static_cast<uint8_t>(Commands::ColumnAddressSet));
-  WriteData(x0 >> 8);
-  WriteData(x0 & 0xff);
-  WriteData(x1 >> 8);
-  WriteData(x1 & 0xff);
-
-  WriteCommand(static_cast<uint8_t>(Commands::RowAddressSet));
-  WriteData(y0 >> 8);
-  WriteData(y0 & 0xff);
-  WriteData(y1 >> 8);
-  WriteData(y1 & 0xff);
-
-  WriteToRam();
+  CommandBatch batch;
+  batch.AddCommand(Commands::ColumnAddressSet);
+  batch.AddParameter(x0);
+  batch.AddParameter(x1);
+  batch.AddCommand(Commands::RowAddressSet);
+  batch.AddParameter(y0);
+  batch.AddParameter(y1);
+  batch.AddCommand(Commands::WriteToRam);
+  batch.Send(spi, pinDataCommand);
 }
 
 void St7789::WriteToRam() {
@@ -132,8 +140,10 @@ void St7789::WriteToRam() {
 void St7789::SetVdv() {
   // By default there is a large step from pixel brightness zero to one.
   // After experimenting with VCOMS, VRH and VDV, this was found to produce good results.
-  WriteCommand(static_cast<uint8_t>(Commands::VdvSet));
-  WriteData(0x10);
+  CommandBatch batch;
+  batch.AddCommand(Commands::VdvSet);
+  batch.AddParameter(static_cast<uint8_t>(0x10));
+  batch.Send(spi, pinDataCommand);
 }
 
 void St7789::DisplayOff() {
@@ -142,20 +152,20 @@ void St7789::DisplayOff() {
 }
 
 void St7789::VerticalScrollDefinition(uint16_t topFixedLines, uint16_t scrollLines, uint16_t bottomFixedLines) {
-  WriteCommand(static_cast<uint8_t>(Commands::VerticalScrollDefinition));
-  WriteData(topFixedLines >> 8u);
-  WriteData(topFixedLines & 0x00ffu);
-  WriteData(scrollLines >> 8u);
-  WriteData(scrollLines & 0x00ffu);
-  WriteData(bottomFixedLines >> 8u);
-  WriteData(bottomFixedLines & 0x00ffu);
+  CommandBatch batch;
+  batch.AddCommand(Commands::VerticalScrollDefinition);
+  batch.AddParameter(topFixedLines);
+  batch.AddParameter(scrollLines);
+  batch.AddParameter(bottomFixedLines);
+  batch.Send(spi, pinDataCommand);
 }
 
 void St7789::VerticalScrollStartAddress(uint16_t line) {
   verticalScrollingStartAddress = line;
-  WriteCommand(static_cast<uint8_t>(Commands::VerticalScrollStartAddress));
-  WriteData(line >> 8u);
-  WriteData(line & 0x00ffu);
+  CommandBatch batch;
+  batch.AddCommand(Commands::VerticalScrollStartAddress);
+  batch.AddParameter(line);
+  batch.Send(spi, pinDataCommand);
 }
 
 void St7789::Uninit() {
@@ -167,15 +177,39 @@ void St7789::DrawPixel(uint16_t x, uint16_t y, uint32_t color) {
   }
 
   SetAddrWindow(x, y, x + 1, y + 1);
-
-  nrf_gpio_pin_set(pinDataCommand);
-  WriteSpi(reinterpret_cast<const uint8_t*>(&color), 2);
+  WriteData(reinterpret_cast<const uint8_t*>(&color), 2);
 }
 
 void St7789::DrawBuffer(uint16_t x, uint16_t y, uint16_t width, uint16_t height, const uint8_t* data, size_t size) {
+  // SetAddrWindow() waits for its own transactions, which are queued after the previous DrawBuffer() transaction :
+  // drawBufferTransaction is not in use anymore when it returns.
+  SetAddrWindow(x, y, x + width - 1, y + height - 1);
+
+  // The buffer is sent asynchronously, the calling task is notified once it's done
+  drawBufferTransaction = SpiMaster::Transaction {};
+  drawBufferTransaction.pinDataCommand = pinDataCommand;
+  drawBufferTransaction.txData = data;
+  drawBufferTransaction.txDataSize = size;
+  drawBufferTransaction.taskToNotify = xTaskGetCurrentTaskHandle();
+  spi.Submit(drawBufferTransaction);
+}
+
+void St7789::FillArea(uint16_t x,
+                      uint16_t y,
+                      uint16_t width,
+                      uint16_t height,
+                      const uint8_t* pattern,
+                      size_t patternSize,
+                      size_t size) {
   SetAddrWindow(x, y, x + width - 1, y + height - 1);
-  nrf_gpio_pin_set(pinDataCommand);
-  WriteSpi(data, size);
+
+  drawBufferTransaction = SpiMaster::Transaction {};
+  drawBufferTransaction.pinDataCommand = pinDataCommand;
+  drawBufferTransaction.txData = pattern;
+  drawBufferTransaction.txDataSize = size;
+  drawBufferTransaction.txDataPatternSize = patternSize;
+  drawBufferTransaction.taskToNotify = xTaskGetCurrentTaskHandle();
+  spi.Submit(drawBufferTransaction);
 }
 
 void St7789::HardwareReset() {
@@ -197,3 +231,30 @@ void St7789::Wakeup() {
   DisplayOn();
   NRF_LOG_INFO("[LCD] Wakeup")
 }
+
+void St7789::CommandBatch::AddCommand(Commands command) {
+  ASSERT(size < SpiMaster::maxCommandWithParametersSize);
+  buffer[size++] = static_cast<uint8_t>(command);
+}
+
+void St7789::CommandBatch::AddParameter(uint8_t parameter) {
+  ASSERT(size < SpiMaster::maxCommandWithParametersSize);
+  parametersMask |= (1U << size);
+  buffer[size++] = parameter;
+}
+
+void St7789::CommandBatch::AddParameter(uint16_t parameter) {
+  AddParameter(static_cast<uint8_t>(parameter >> 8u));
+  AddParameter(static_cast<uint8_t>(parameter & 0xffu));
+}
+
+void St7789::CommandBatch::Send(Spi& spi, uint8_t pinDataCommand) const {
+  // The SPI master switches the data/command pin between the commands and their parameters,
+  // the whole batch costs a single transaction instead of one per byte.
+  SpiMaster::Transaction transaction;
+  transaction.pinDataCommand = pinDataCommand;
+  transaction.command = buffer;
+  transaction.commandSize = size;
+  transaction.commandParametersMask = parametersMask;
+  spi.Transfer(transaction);
+}
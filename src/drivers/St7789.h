@@ -1,6 +1,7 @@
 #pragma once
 #include <cstddef>
 #include <cstdint>
+#include "drivers/SpiMaster.h"
 
 namespace Pinetime {
   namespace Drivers {
@@ -8,6 +9,9 @@ namespace Pinetime {
 
     class St7789 {
     public:
+      // Rgb565 : 2 bytes per pixel. Rgb444 : 2 pixels packed in 3 bytes.
+      enum class ColorFormats : uint8_t { Rgb565, Rgb444 };
+
       explicit St7789(Spi& spi, uint8_t pinDataCommand);
       St7789(const St7789&) = delete;
       St7789& operator=(const St7789&) = delete;
@@ -16,12 +20,16 @@ namespace Pinetime {
 
       void Init();
       void Uninit();
+      // Format of the data sent by DrawBuffer(). Must be set before Init().
+      void SetColorFormat(ColorFormats format);
       void DrawPixel(uint16_t x, uint16_t y, uint32_t color);
 
       void VerticalScrollDefinition(uint16_t topFixedLines, uint16_t scrollLines, uint16_t bottomFixedLines);
       void VerticalScrollStartAddress(uint16_t line);
 
       void DrawBuffer(uint16_t x, uint16_t y, uint16_t width, uint16_t height, const uint8_t* data, size_t size);
+      // Same as DrawBuffer(), but sends the same pattern (a few pixels of a single color) until size bytes are sent
+      void FillArea(uint16_t x, uint16_t y, uint16_t width, uint16_t height, const uint8_t* pattern, size_t patternSize, size_t size);
 
       void Sleep();
       void Wakeup();
@@ -30,6 +38,8 @@ namespace Pinetime {
       Spi& spi;
       uint8_t pinDataCommand;
       uint8_t verticalScrollingStartAddress = 0;
+      ColorFormats colorFormat = ColorFormats::Rgb565;
+      SpiMaster::Transaction drawBufferTransaction;
 
       void HardwareReset();
       void SoftwareReset();
@@ -46,7 +56,6 @@ namespace Pinetime {
       void SetAddrWindow(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1);
       void SetVdv();
       void WriteCommand(uint8_t cmd);
-      void WriteSpi(const uint8_t* data, size_t size);
 
       enum class Commands : uint8_t {
         SoftwareReset = 0x01,
@@ -65,9 +74,23 @@ namespace Pinetime {
         ColMod = 0x3a,
         VdvSet = 0xc4,
       };
-      void WriteData(uint8_t data);
+      void WriteData(const uint8_t* data, size_t size);
       void ColumnAddressSet();
 
+      // Builds a sequence of commands and their parameters that is sent in a single SPI transaction
+      class CommandBatch {
+      public:
+        void AddCommand(Commands command);
+        void AddParameter(uint8_t parameter);
+        void AddParameter(uint16_t parameter);
+        void Send(Spi& spi, uint8_t pinDataCommand) const;
+
+      private:
+        uint8_t buffer[SpiMaster::maxCommandWithParametersSize];
+        size_t size = 0;
+        uint32_t parametersMask = 0;
+      };
+
       static constexpr uint16_t Width = 240;
       static constexpr uint16_t Height = 320;
       void RowAddressSet();
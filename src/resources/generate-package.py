@@ -6,15 +6,66 @@ import json
 import shutil
 import typing
 import os.path
+import struct
+import zlib
 import argparse
 import subprocess
 from zipfile import ZipFile
 
+PACK_FILENAME = 'resources.pack'
+PACK_PATH = '/resources.pack'
+PACK_MAGIC = 0x31505249  # "IRP1"
+PACK_VERSION = 2
+PACK_HEADER = struct.Struct('<IHHHHII')
+PACK_ENTRY = struct.Struct('<IIII')
+
+def path_hash(path):
+    # FNV-1a, same as ResourcePack::Hash()
+    h = 0x811c9dc5
+    for b in path.encode('utf-8'):
+        h = ((h ^ b) * 0x01000193) & 0xffffffff
+    return h
+
+def write_pack(output, resources):
+    """Writes the resources (list of (path in the watch FS, local file)) in a single pack file.
+
+    Layout (little endian) : header, directory (hash table of nb_buckets entries : hash and CRC32 of the path,
+    offset and size of the resource, offset 0 for an empty bucket), then the resources aligned on 4 bytes.
+    """
+    nb_buckets = 4
+    while nb_buckets < 2 * len(resources):
+        nb_buckets *= 2
+    offset = PACK_HEADER.size + nb_buckets * PACK_ENTRY.size
+
+    buckets = [(0, 0, 0, 0)] * nb_buckets
+    hashes = {}
+    data = bytearray()
+    for path, local_file in resources:
+        h = path_hash(path)
+        if h in hashes:
+            sys.exit(f'Error: {path} and {hashes[h]} have the same hash, rename one of them.')
+        hashes[h] = path
+        with open(local_file, 'rb') as fd:
+            content = fd.read()
+        bucket = h % nb_buckets
+        while buckets[bucket][2] != 0:
+            bucket = (bucket + 1) % nb_buckets
+        buckets[bucket] = (h, zlib.crc32(path.encode('utf-8')), offset + len(data), len(content))
+        data += content
+        data += b'\0' * (-len(data) % 4)
+
+    directory = b''.join(PACK_ENTRY.pack(*entry) for entry in buckets)
+    pack_size = offset + len(data)
+    header = PACK_HEADER.pack(PACK_MAGIC, PACK_VERSION, nb_buckets, len(resources), 0, pack_size, zlib.crc32(directory))
+    with open(output, 'wb') as fd:
+        fd.write(header + directory + data)
+
 def main():
     ap = argparse.ArgumentParser(description='auto generate LVGL font files from fonts')
     ap.add_argument('--config', '-c', type=str, action='append', help='config file to use')
     ap.add_argument('--obsolete', type=str, help='List of obsolete files')
     ap.add_argument('--output', type=str, help='output file name')
+    ap.add_argument('--pack', action='store_true', help='put all the resources in a single indexed file')
     args = ap.parse_args()
 
     for config_file in args.config:
@@ -32,6 +83,7 @@ def main():
 
     zf = ZipFile(args.output, mode='w')
     resource_files = []
+    packed_resources = []
 
     for config_file in args.config:
         with open(config_file, 'r') as fd:
@@ -40,16 +92,28 @@ def main():
         resource_names = set(data.keys())
         for name in resource_names:
             resource = data[name]
+            path = name + '.bin'
+            if not os.path.exists(path):
+                path = os.path.join(os.path.dirname(sys.argv[0]), path)
+
+            if args.pack:
+                packed_resources.append((resource['target_path'] + name+'.bin', path))
+                continue
+
             resource_files.append({
                 "filename": name+'.bin',
                 "path": resource['target_path'] + name+'.bin'
             })
-
-            path = name + '.bin'
-            if not os.path.exists(path):
-                path = os.path.join(os.path.dirname(sys.argv[0]), path)
             zf.write(path)
 
+    if args.pack:
+        write_pack(PACK_FILENAME, sorted(packed_resources))
+        resource_files.append({
+            "filename": PACK_FILENAME,
+            "path": PACK_PATH
+        })
+        zf.write(PACK_FILENAME)
+
     if args.obsolete:
         obsolete_file_path = os.path.join(os.path.dirname(sys.argv[0]), args.obsolete)
         with open(obsolete_file_path, 'r') as fd:
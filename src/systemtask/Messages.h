@@ -33,6 +33,7 @@ namespace Pinetime {
       LowBattery,
       StartFileTransfer,
       StopFileTransfer,
+      ExportHistory,
       BleRadioEnableToggle
     };
   }
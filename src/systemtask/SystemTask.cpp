@@ -5,6 +5,7 @@
 #include "BootloaderVersion.h"
 #include "components/battery/BatteryController.h"
 #include "components/ble/BleController.h"
+#include "components/heartrate/HeartRateController.h"
 #include "displayapp/TouchEvents.h"
 #include "drivers/Cst816s.h"
 #include "drivers/St7789.h"
@@ -20,6 +21,7 @@
 #include <memory>
 #include <algorithm>
 #include <cstring>
+#include <limits>
 
 using namespace Pinetime::System;
 
@@ -70,6 +72,8 @@ SystemTask::SystemTask(Drivers::SpiMaster& spi,
                        Pinetime::Applications::DisplayApp& displayApp,
                        Pinetime::Applications::HeartRateTask& heartRateApp,
                        Pinetime::Controllers::FS& fs,
+                       Pinetime::Controllers::KeyValueStore& keyValueStore,
+                       Pinetime::Controllers::TimeSeries& timeSeries,
                        Pinetime::Controllers::TouchHandler& touchHandler,
                        Pinetime::Controllers::ButtonHandler& buttonHandler)
   : spi {spi},
@@ -94,6 +98,8 @@ SystemTask::SystemTask(Drivers::SpiMaster& spi,
     displayApp {displayApp},
     heartRateApp(heartRateApp),
     fs {fs},
+    keyValueStore {keyValueStore},
+    timeSeriesController {timeSeries},
     touchHandler {touchHandler},
     buttonHandler {buttonHandler},
     nimbleController(*this,
@@ -104,7 +110,9 @@ SystemTask::SystemTask(Drivers::SpiMaster& spi,
                      spiNorFlash,
                      heartRateController,
                      motionController,
-                     fs) {
+                     fs,
+                     keyValueStore,
+                     timeSeries) {
 }
 
 void SystemTask::Start() {
@@ -133,6 +141,8 @@ void SystemTask::Work() {
   spiNorFlash.Wakeup();
 
   fs.Init();
+  keyValueStore.Init();
+  timeSeriesController.Init();
 
   nimbleController.Init();
   lcd.Init();
@@ -237,6 +247,7 @@ void SystemTask::Work() {
 
           xTimerStart(dimTimer, 0);
           spiNorFlash.Wakeup();
+          timeSeriesController.Flush();
           lcd.Wakeup();
 
           displayApp.PushMessage(Pinetime::Applications::Display::Messages::GoToRunning);
@@ -248,6 +259,10 @@ void SystemTask::Work() {
 
           state = SystemTaskState::Running;
           isDimmed = false;
+          if (historyExportPending) {
+            historyExportPending = false;
+            PushMessage(Messages::ExportHistory);
+          }
           break;
         case Messages::TouchWakeUp: {
           if (touchHandler.GetNewTouchInfo()) {
@@ -341,6 +356,16 @@ void SystemTask::Work() {
           xTimerStart(dimTimer, 0);
           // TODO add intent of fs access icon or something
           break;
+        case Messages::ExportHistory:
+          // The samples are read from the external flash memory, which sleeps with the rest of the system
+          if (state == SystemTaskState::Running) {
+            timeSeriesController.Flush();
+            nimbleController.history().SendExport();
+          } else {
+            historyExportPending = true;
+            GoToRunning();
+          }
+          break;
         case Messages::OnTouchEvent:
           if (touchHandler.GetNewTouchInfo()) {
             touchHandler.UpdateLvglTouchPoint();
@@ -368,6 +393,7 @@ void SystemTask::Work() {
           HandleButtonAction(action);
         } break;
         case Messages::OnDisplayTaskSleeping:
+          timeSeriesController.Flush();
           if (BootloaderVersion::IsValid()) {
             // First versions of the bootloader do not expose their version and cannot initialize the SPI NOR FLASH
             // if it's in sleep mode. Avoid bricked device by disabling sleep mode on these versions.
@@ -382,6 +408,9 @@ void SystemTask::Work() {
           }
 
           state = SystemTaskState::Sleeping;
+          if (historyExportPending) {
+            GoToRunning();
+          }
           break;
         case Messages::OnNewDay:
           // We might be sleeping (with TWI device disabled.
@@ -422,9 +451,12 @@ void SystemTask::Work() {
           break;
         case Messages::MeasureBatteryTimerExpired:
           batteryController.MeasureVoltage();
+          RecordSamples();
           break;
         case Messages::BatteryPercentageUpdated:
           nimbleController.NotifyBatteryLevel(batteryController.PercentRemaining());
+          RecordSample(Controllers::TimeSeries::Series::Battery, batteryController.PercentRemaining());
+          FlushTimeSeries();
           break;
         case Messages::LowBattery: {
           Pinetime::Controllers::NotificationManager::Notification notif;
@@ -477,6 +509,41 @@ void SystemTask::Work() {
 #pragma clang diagnostic pop
 }
 
+void SystemTask::RecordSamples() {
+  uint32_t steps = motionController.NbSteps();
+  if (hasLastSampledSteps) {
+    // The step counter is reset every day
+    RecordSample(Controllers::TimeSeries::Series::Steps, (steps >= lastSampledSteps) ? steps - lastSampledSteps : steps);
+  }
+  lastSampledSteps = steps;
+  hasLastSampledSteps = true;
+
+  if (heartRateController.State() == Controllers::HeartRateController::States::Running && heartRateController.HeartRate() > 0) {
+    RecordSample(Controllers::TimeSeries::Series::HeartRate, heartRateController.HeartRate());
+  }
+  FlushTimeSeries();
+}
+
+void SystemTask::RecordSample(Controllers::TimeSeries::Series series, int32_t value) {
+  auto time = std::chrono::duration_cast<std::chrono::seconds>(dateTimeController.CurrentDateTime().time_since_epoch());
+  timeSeriesController.Append(series, time.count(), static_cast<int16_t>(std::min<int32_t>(value, std::numeric_limits<int16_t>::max())));
+}
+
+void SystemTask::FlushTimeSeries() {
+  if (state == SystemTaskState::Running || state == SystemTaskState::GoingToSleep) {
+    timeSeriesController.Flush();
+  } else if (state == SystemTaskState::Sleeping && timeSeriesController.NeedsFlush()) {
+    // The samples are written before the queue overflows, even if the watch doesn't wake up
+    spi.Wakeup();
+    spiNorFlash.Wakeup();
+    timeSeriesController.Flush();
+    if (BootloaderVersion::IsValid()) {
+      spiNorFlash.Sleep();
+    }
+    spi.Sleep();
+  }
+}
+
 void SystemTask::UpdateMotion() {
   if (state == SystemTaskState::GoingToSleep || state == SystemTaskState::WakingUp) {
     return;
@@ -19,6 +19,8 @@
 #include "components/timer/TimerController.h"
 #include "components/alarm/AlarmController.h"
 #include "components/fs/FS.h"
+#include "components/kvstore/KeyValueStore.h"
+#include "components/timeseries/TimeSeries.h"
 #include "touchhandler/TouchHandler.h"
 #include "buttonhandler/ButtonHandler.h"
 #include "buttonhandler/ButtonActions.h"
@@ -79,6 +81,8 @@ namespace Pinetime {
                  Pinetime::Applications::DisplayApp& displayApp,
                  Pinetime::Applications::HeartRateTask& heartRateApp,
                  Pinetime::Controllers::FS& fs,
+                 Pinetime::Controllers::KeyValueStore& keyValueStore,
+                 Pinetime::Controllers::TimeSeries& timeSeries,
                  Pinetime::Controllers::TouchHandler& touchHandler,
                  Pinetime::Controllers::ButtonHandler& buttonHandler);
 
@@ -94,6 +98,10 @@ namespace Pinetime {
         return nimbleController;
       };
 
+      Pinetime::Controllers::TimeSeries& timeSeries() {
+        return timeSeriesController;
+      };
+
       bool IsSleeping() const {
         return state == SystemTaskState::Sleeping || state == SystemTaskState::WakingUp;
       }
@@ -126,6 +134,8 @@ namespace Pinetime {
       Pinetime::Applications::DisplayApp& displayApp;
       Pinetime::Applications::HeartRateTask& heartRateApp;
       Pinetime::Controllers::FS& fs;
+      Pinetime::Controllers::KeyValueStore& keyValueStore;
+      Pinetime::Controllers::TimeSeries& timeSeriesController;
       Pinetime::Controllers::TouchHandler& touchHandler;
       Pinetime::Controllers::ButtonHandler& buttonHandler;
       Pinetime::Controllers::NimbleController nimbleController;
@@ -148,6 +158,14 @@ namespace Pinetime {
       void GoToRunning();
       void UpdateMotion();
       bool stepCounterMustBeReset = false;
+      void RecordSamples();
+      void RecordSample(Controllers::TimeSeries::Series series, int32_t value);
+      void FlushTimeSeries();
+      // A chunk of the history export is requested while the system isn't running
+      bool historyExportPending = false;
+      // The steps are recorded as the number of steps since the previous sample
+      bool hasLastSampledSteps = false;
+      uint32_t lastSampledSteps = 0;
       static constexpr TickType_t batteryMeasurementPeriod = pdMS_TO_TICKS(10 * 60 * 1000);
 
       SystemMonitor monitor;
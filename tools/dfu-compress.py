@@ -0,0 +1,301 @@
+#!/usr/bin/env python3
+
+# Compresses a firmware image (the .bin file of the DFU package) for the compressed transfer of the DFU service
+# (see doc/ble.md).
+#
+# The image is split in blocks of 4096 bytes (the last one may be shorter), and each block is compressed on its
+# own in the heatshrink format (LZSS, window of 2^9 bytes, back-references of up to 2^4 bytes), padded to a byte.
+# The compressed stream is the concatenation of the blocks : a transfer resumed from the offset N of the image
+# starts with the block N / 4096.
+#
+# With --delta, the output is a patch that rebuilds the image from the running firmware (the .bin file of the DFU
+# package installed on the watch), compressed as a single stream. The patch starts with the size and the CRC of the
+# running firmware, as little-endian 32 and 16-bit integers. It's followed by records of four little-endian 32-bit
+# integers : an offset in the running firmware, the length of a copy, of a diff and of an extra. The copy is the bytes
+# of the running firmware at the offset. The diff follows the record : its bytes are added to the next bytes of the
+# running firmware. The extra follows the diff, and is copied to the image. The records are found as in bsdiff.
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+WINDOW_BITS = 9
+LOOKAHEAD_BITS = 4
+BLOCK_SIZE = 4096
+
+# A back-reference shorter than this takes more bits than the literals it replaces
+MIN_MATCH = 2
+# A run of unchanged bytes shorter than this takes less space in a diff than in a record of its own
+MIN_COPY = 64
+
+
+class BitWriter:
+    def __init__(self):
+        self.data = bytearray()
+        self.current = 0
+        self.count = 0
+
+    def write(self, value, bits):
+        for bit in range(bits - 1, -1, -1):
+            self.current = (self.current << 1) | ((value >> bit) & 1)
+            self.count += 1
+            if self.count == 8:
+                self.data.append(self.current)
+                self.current = 0
+                self.count = 0
+
+    def flush(self):
+        if self.count > 0:
+            self.data.append(self.current << (8 - self.count))
+            self.current = 0
+            self.count = 0
+        return bytes(self.data)
+
+
+def compress_block(block):
+    window = 1 << WINDOW_BITS
+    max_match = 1 << LOOKAHEAD_BITS
+    writer = BitWriter()
+    # Positions of each pair of bytes, the most recent last
+    positions = {}
+    i = 0
+
+    def index(position):
+        if position + 1 < len(block):
+            positions.setdefault(block[position:position + 2], []).append(position)
+
+    while i < len(block):
+        best_length = 0
+        best_distance = 0
+        for candidate in reversed(positions.get(block[i:i + 2], [])):
+            if i - candidate > window:
+                break
+            length = 2
+            while length < max_match and i + length < len(block) and block[candidate + length] == block[i + length]:
+                length += 1
+            if length > best_length:
+                best_length = length
+                best_distance = i - candidate
+                if length == max_match:
+                    break
+
+        if best_length >= MIN_MATCH:
+            writer.write(0, 1)
+            writer.write(best_distance - 1, WINDOW_BITS)
+            writer.write(best_length - 1, LOOKAHEAD_BITS)
+        else:
+            best_length = 1
+            writer.write(1, 1)
+            writer.write(block[i], 8)
+
+        for position in range(i, i + best_length):
+            index(position)
+        i += best_length
+
+    return writer.flush()
+
+
+def decompress_block(data, size):
+    # Same algorithm as the firmware, used to check the output
+    output = bytearray()
+    bit = 0
+
+    def read(bits):
+        nonlocal bit
+        value = 0
+        for _ in range(bits):
+            value = (value << 1) | ((data[bit // 8] >> (7 - bit % 8)) & 1)
+            bit += 1
+        return value
+
+    while len(output) < size:
+        if read(1):
+            output.append(read(8))
+        else:
+            distance = read(WINDOW_BITS) + 1
+            count = read(LOOKAHEAD_BITS) + 1
+            for _ in range(count):
+                output.append(output[-distance] if distance <= len(output) else 0)
+    return bytes(output[:size]), (bit + 7) // 8
+
+
+def crc16(data):
+    # CRC-16/CCITT-FALSE, as in the init packet
+    crc = 0xffff
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+        crc &= 0xffff
+    return crc
+
+
+def match_length(old, old_start, new, new_start):
+    length = 0
+    while old[old_start + length:old_start + length + 64] == new[new_start + length:new_start + length + 64] and \
+            old_start + length + 64 <= len(old) and new_start + length + 64 <= len(new):
+        length += 64
+    while old_start + length < len(old) and new_start + length < len(new) and \
+            old[old_start + length] == new[new_start + length]:
+        length += 1
+    return length
+
+
+def add_records(patch, position, diff, extra):
+    # The long runs of zeros of the diff, where the bytes don't change, are copied instead of being sent
+    starts = [0] + [match.start() for match in re.finditer(b'\x00{%d,}' % MIN_COPY, diff) if match.start() > 0]
+    ends = starts[1:] + [len(diff)]
+    for start, end in zip(starts, ends):
+        piece = diff[start:end]
+        copy_length = len(piece) - len(piece.lstrip(b'\x00'))
+        extra_length = len(extra) if end == len(diff) else 0
+        patch += struct.pack('<IIII', position + start, copy_length, len(piece) - copy_length, extra_length)
+        patch += piece[copy_length:]
+    patch += extra
+
+
+def make_patch(old, new):
+    # The main loop of bsdiff, with a hash of the sequences of 8 bytes of old instead of its suffix array
+    key_size = 8
+    positions = {}
+    for position in range(len(old) - key_size + 1):
+        positions.setdefault(old[position:position + key_size], []).append(position)
+
+    def search(scan):
+        best_length, best_position = 0, 0
+        for position in positions.get(new[scan:scan + key_size], [])[-32:]:
+            length = match_length(old, position, new, scan)
+            if length > best_length:
+                best_length, best_position = length, position
+        return best_length, best_position
+
+    patch = bytearray(struct.pack('<IH', len(old), crc16(old)))
+    scan = length = last_scan = last_position = last_offset = 0
+    position = 0
+    while scan < len(new):
+        old_score = 0
+        scan += length
+        scsc = scan
+        while scan < len(new):
+            length, position = search(scan)
+            while scsc < scan + length:
+                if scsc + last_offset < len(old) and old[scsc + last_offset] == new[scsc]:
+                    old_score += 1
+                scsc += 1
+            if (length == old_score and length != 0) or length > old_score + key_size:
+                break
+            if scan + last_offset < len(old) and old[scan + last_offset] == new[scan]:
+                old_score -= 1
+            scan += 1
+
+        if length != old_score or scan == len(new):
+            # Extends the previous match forwards and this one backwards, where more than half of the bytes match
+            score = best = length_forward = 0
+            i = 0
+            while last_scan + i < scan and last_position + i < len(old):
+                if old[last_position + i] == new[last_scan + i]:
+                    score += 1
+                i += 1
+                if score * 2 - i > best * 2 - length_forward:
+                    best, length_forward = score, i
+
+            length_backward = 0
+            if scan < len(new):
+                score = best = 0
+                i = 1
+                while scan >= last_scan + i and position >= i:
+                    if old[position - i] == new[scan - i]:
+                        score += 1
+                    if score * 2 - i > best * 2 - length_backward:
+                        best, length_backward = score, i
+                    i += 1
+
+            if last_scan + length_forward > scan - length_backward:
+                overlap = (last_scan + length_forward) - (scan - length_backward)
+                score = best = split = 0
+                for i in range(overlap):
+                    if new[last_scan + length_forward - overlap + i] == old[last_position + length_forward - overlap + i]:
+                        score += 1
+                    if new[scan - length_backward + i] == old[position - length_backward + i]:
+                        score -= 1
+                    if score > best:
+                        best, split = score, i + 1
+                length_forward += split - overlap
+                length_backward -= split
+
+            extra_length = (scan - length_backward) - (last_scan + length_forward)
+            diff = bytes((new[last_scan + i] - old[last_position + i]) & 0xff for i in range(length_forward))
+            extra = new[last_scan + length_forward:last_scan + length_forward + extra_length]
+            add_records(patch, last_position, diff, extra)
+
+            last_scan = scan - length_backward
+            last_position = position - length_backward
+            last_offset = position - scan
+    return bytes(patch)
+
+
+def apply_patch(old, patch, size):
+    # Same algorithm as the firmware, used to check the output
+    old_size, old_crc = struct.unpack_from('<IH', patch)
+    if old_size != len(old) or old_crc != crc16(old):
+        return None
+    image = bytearray()
+    offset = 6
+    while len(image) < size:
+        position, copy_length, diff_length, extra_length = struct.unpack_from('<IIII', patch, offset)
+        offset += 16
+        image += old[position:position + copy_length]
+        position += copy_length
+        image += bytes((patch[offset + i] + old[position + i]) & 0xff for i in range(diff_length))
+        offset += diff_length
+        image += patch[offset:offset + extra_length]
+        offset += extra_length
+    return bytes(image)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compress a firmware image, or make a patch, for the DFU transfer.')
+    parser.add_argument('input', help='firmware image (.bin)')
+    parser.add_argument('output', help='compressed stream')
+    parser.add_argument('--delta', metavar='RUNNING', help='make a patch against the running firmware image (.bin)')
+    args = parser.parse_args()
+
+    with open(args.input, 'rb') as f:
+        image = f.read()
+
+    if args.delta:
+        with open(args.delta, 'rb') as f:
+            running = f.read()
+        patch = make_patch(running, image)
+        stream = compress_block(patch)
+        # Round trip, the same way the firmware decompresses and applies the patch
+        decompressed, consumed = decompress_block(stream, len(patch))
+        if apply_patch(running, decompressed, len(image)) != image or consumed != len(stream):
+            sys.exit('Error: the patch does not rebuild the image')
+        summary = f'patch against {os.path.basename(args.delta)}'
+    else:
+        blocks = [compress_block(image[offset:offset + BLOCK_SIZE]) for offset in range(0, len(image), BLOCK_SIZE)]
+        stream = b''.join(blocks)
+
+        # Round trip, the same way the firmware decompresses the stream
+        offset = 0
+        decompressed = bytearray()
+        for start in range(0, len(image), BLOCK_SIZE):
+            block, consumed = decompress_block(stream[offset:], min(BLOCK_SIZE, len(image) - start))
+            decompressed += block
+            offset += consumed
+        if decompressed != image or offset != len(stream):
+            sys.exit('Error: the compressed stream does not decompress to the image')
+        summary = f'{len(blocks)} blocks'
+
+    with open(args.output, 'wb') as f:
+        f.write(stream)
+
+    print(f'{os.path.basename(args.input)} : {len(image)} bytes, compressed to {len(stream)} bytes '
+          f'({100 * len(stream) / len(image):.1f} %), {summary}')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,243 @@
+// Benchmarks the file system of InfiniTime (littlefs on the external SPI NOR flash memory) and the key-value store
+// on the host : FS, FlashCache, KeyValueStore and the drivers Spi and SpiNorFlash are the sources of the firmware,
+// running on a simulated flash memory (tools/host-stubs/FakeNorFlash.h). The simulated time, bus time, wait time
+// and the operations of the flash memory are reported for each scenario.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <lvgl/lvgl.h>
+#include "FakeNorFlash.h"
+#include "HostTime.h"
+#include "components/fs/FS.h"
+#include "components/kvstore/KeyValueStore.h"
+#include "drivers/Spi.h"
+#include "drivers/SpiNorFlash.h"
+
+using Pinetime::Controllers::FS;
+using Pinetime::Controllers::KeyValueStore;
+using Pinetime::Drivers::FakeNorFlash;
+
+// FS registers its drivers in LVGL, which isn't used here
+void lv_fs_drv_init(lv_fs_drv_t* drv) {
+  *drv = {};
+}
+
+void lv_fs_drv_register(lv_fs_drv_t* /*drv*/) {
+}
+
+namespace {
+  class Measure {
+  public:
+    Measure(const char* scenario, const FakeNorFlash& memory)
+      : scenario {scenario},
+        memory {memory},
+        start {memory.GetStatistics()},
+        startTime {HostTime::Now()},
+        startWaitTime {HostTime::WaitTime()} {
+    }
+
+    ~Measure() {
+      const auto& end = memory.GetStatistics();
+      std::printf("  %-20s %9.1f ms  bus %9.1f ms  wait %9.1f ms  %7u transactions  %5u programs  %4u erases\n",
+                  scenario,
+                  (HostTime::Now() - startTime) / 1000.0,
+                  (end.busTimeUs - start.busTimeUs) / 1000.0,
+                  (HostTime::WaitTime() - startWaitTime) / 1000.0,
+                  end.transactions - start.transactions,
+                  end.pagePrograms - start.pagePrograms,
+                  end.erases - start.erases);
+    }
+
+  private:
+    const char* scenario;
+    const FakeNorFlash& memory;
+    FakeNorFlash::Statistics start;
+    uint64_t startTime;
+    uint64_t startWaitTime;
+  };
+
+  void Check(int result, const char* operation) {
+    if (result < 0) {
+      std::fprintf(stderr, "%s failed : %d\n", operation, result);
+      std::exit(1);
+    }
+  }
+
+  void WriteFile(FS& fs, const char* path, size_t size, size_t chunkSize) {
+    std::vector<uint8_t> data(chunkSize);
+    lfs_file_t file;
+    Check(fs.FileOpen(&file, path, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC), path);
+    for (size_t written = 0; written < size; written += chunkSize) {
+      for (auto& byte : data) {
+        byte = static_cast<uint8_t>(std::rand());
+      }
+      Check(fs.FileWrite(&file, data.data(), std::min(chunkSize, size - written)), path);
+    }
+    Check(fs.FileClose(&file), path);
+  }
+
+  void ReadFile(FS& fs, const char* path, size_t chunkSize) {
+    std::vector<uint8_t> data(chunkSize);
+    lfs_file_t file;
+    Check(fs.FileOpen(&file, path, LFS_O_RDONLY), path);
+    while (fs.FileRead(&file, data.data(), chunkSize) > 0) {
+    }
+    Check(fs.FileClose(&file), path);
+  }
+
+  void WriteValue(KeyValueStore& store, KeyValueStore::Keys key, size_t size) {
+    std::vector<uint8_t> value(size);
+    for (auto& byte : value) {
+      byte = static_cast<uint8_t>(std::rand());
+    }
+    if (!store.Write(key, value.data(), size)) {
+      std::fprintf(stderr, "write of the key %d failed\n", static_cast<int>(key));
+      std::exit(1);
+    }
+  }
+
+  void ReadValue(KeyValueStore& store, KeyValueStore::Keys key, size_t size) {
+    std::vector<uint8_t> value(size);
+    if (store.Read(key, value.data(), size) != size) {
+      std::fprintf(stderr, "read of the key %d failed\n", static_cast<int>(key));
+      std::exit(1);
+    }
+  }
+
+  // Runs the scenarios on an erased flash memory, and returns the number of commands ignored by the memory
+  uint32_t Run(const FakeNorFlash::CostModel& costModel) {
+    FakeNorFlash memory {costModel};
+    Pinetime::Drivers::SpiMaster spiMaster {Pinetime::Drivers::SpiMaster::SpiModule::SPI0, {}};
+    Pinetime::Drivers::Spi spi {spiMaster, 0, Pinetime::Drivers::SpiMaster::Priority::Normal};
+    Pinetime::Drivers::SpiNorFlash flash {spi};
+    flash.Init();
+    std::srand(0);
+
+    {
+      FS fs {flash};
+      KeyValueStore store {fs};
+      {
+        // The file system is formatted at the first mount
+        Measure measure {"first boot", memory};
+        fs.Init();
+        store.Init();
+      }
+      {
+        // Fonts and images sent by the companion app, by chunks of the size of a BLE packet
+        Measure measure {"resource install", memory};
+        Check(fs.DirCreate("/fonts"), "mkdir");
+        Check(fs.DirCreate("/images"), "mkdir");
+        for (int i = 0; i < 3; i++) {
+          WriteFile(fs, ("/fonts/font" + std::to_string(i) + ".bin").c_str(), 20000, 240);
+        }
+        for (int i = 0; i < 10; i++) {
+          WriteFile(fs, ("/images/image" + std::to_string(i) + ".bin").c_str(), 8000, 240);
+        }
+      }
+    }
+
+    FS fs {flash};
+    KeyValueStore store {fs};
+    {
+      Measure measure {"boot", memory};
+      fs.Init();
+      store.Init();
+    }
+    {
+      Measure measure {"settings save x20", memory};
+      for (int i = 0; i < 20; i++) {
+        WriteValue(store, KeyValueStore::Keys::Settings, 48);
+      }
+    }
+    {
+      Measure measure {"settings load x20", memory};
+      for (int i = 0; i < 20; i++) {
+        ReadValue(store, KeyValueStore::Keys::Settings, 48);
+      }
+    }
+    {
+      // The same values in a file, as written by the versions before the key-value store
+      Measure measure {"settings file x20", memory};
+      for (int i = 0; i < 20; i++) {
+        WriteFile(fs, "/settings.dat", 48, 48);
+        ReadFile(fs, "/settings.dat", 48);
+      }
+    }
+    {
+      // NimbleController writes the bond on disconnection, reads and deletes it at startup
+      Measure measure {"bond persist x10", memory};
+      for (int i = 0; i < 10; i++) {
+        WriteValue(store, KeyValueStore::Keys::Bond, 180);
+        ReadValue(store, KeyValueStore::Keys::Bond, 180);
+        store.Delete(KeyValueStore::Keys::Bond);
+      }
+    }
+    {
+      // lv_font_load() reads the tables of a font sequentially
+      Measure measure {"font load", memory};
+      ReadFile(fs, "/fonts/font0.bin", 64);
+    }
+    {
+      // Glyphs and image lines read at random positions
+      Measure measure {"random reads x200", memory};
+      lfs_file_t file;
+      uint8_t data[256];
+      Check(fs.FileOpen(&file, "/fonts/font1.bin", LFS_O_RDONLY), "open");
+      for (int i = 0; i < 200; i++) {
+        Check(fs.FileSeek(&file, std::rand() % 19000), "seek");
+        Check(fs.FileRead(&file, data, 16 + (std::rand() % 240)), "read");
+      }
+      Check(fs.FileClose(&file), "close");
+    }
+    {
+      Measure measure {"directory walk", memory};
+      lfs_dir_t dir;
+      lfs_info info;
+      for (const char* path : {"/", "/fonts", "/images"}) {
+        Check(fs.DirOpen(path, &dir), "dir open");
+        while (fs.DirRead(&dir, &info) > 0) {
+        }
+        Check(fs.DirClose(&dir), "dir close");
+      }
+    }
+
+    const auto& cacheStatistics = fs.GetCacheStatistics();
+    std::printf("  max erases of a sector : %u, page cache : %u hits, %u misses, %u prefetches, %u bypasses\n",
+                memory.MaxSectorErases(),
+                cacheStatistics.hits,
+                cacheStatistics.misses,
+                cacheStatistics.prefetches,
+                cacheStatistics.bypasses);
+    return memory.GetStatistics().errors;
+  }
+}
+
+int main(int argc, char** argv) {
+  FakeNorFlash::CostModel costModel;
+  if (argc > 1) {
+    // Usage : flash-sim [byte time (ns)] [transaction overhead (µs)] [page program (µs)] [sector erase (µs)]
+    uint32_t* parameters[] = {&costModel.byteTimeNs,
+                              &costModel.transactionOverheadUs,
+                              &costModel.pageProgramTimeUs,
+                              &costModel.sectorEraseTimeUs};
+    for (int i = 1; i < argc && i <= 4; i++) {
+      *parameters[i - 1] = static_cast<uint32_t>(std::strtoul(argv[i], nullptr, 0));
+    }
+  }
+
+  std::printf("littlefs parameters of FS.cpp, %u ns per byte, %u µs per transaction, %u µs per page program, %u µs per erase\n",
+              costModel.byteTimeNs,
+              costModel.transactionOverheadUs,
+              costModel.pageProgramTimeUs,
+              costModel.sectorEraseTimeUs);
+  const uint32_t errors = Run(costModel);
+  if (errors > 0) {
+    // The driver sent commands that the memory ignored : the measures are wrong, and so is the driver
+    std::fprintf(stderr, "%u commands ignored by the flash memory\n", errors);
+    return 1;
+  }
+  return 0;
+}
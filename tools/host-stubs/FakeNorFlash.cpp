@@ -0,0 +1,210 @@
+#include "FakeNorFlash.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include "HostTime.h"
+
+using namespace Pinetime::Drivers;
+
+namespace {
+  FakeNorFlash* connectedMemory = nullptr;
+
+  constexpr size_t addressSize = 3;
+  constexpr uint8_t statusWriteInProgress = 0x01;
+  constexpr uint8_t statusWriteEnabled = 0x02;
+  // Identification of the memory of the PineTime (XTX XT25F32B)
+  constexpr uint8_t identification[] = {0x0B, 0x40, 0x16};
+}
+
+// Only the memory is connected to the bus of the host : the transactions are completed as soon as they're submitted
+SpiMaster::SpiMaster(const SpiMaster::SpiModule spi, const SpiMaster::Parameters& params) : spi {spi}, params {params} {
+}
+
+bool SpiMaster::Init() {
+  return true;
+}
+
+bool SpiMaster::Submit(SpiMaster::Transaction& transaction) {
+  FakeNorFlash::Transfer(transaction);
+  return true;
+}
+
+void SpiMaster::Sleep() {
+}
+
+void SpiMaster::Wakeup() {
+}
+
+FakeNorFlash::FakeNorFlash() : FakeNorFlash(CostModel {}) {
+}
+
+FakeNorFlash::FakeNorFlash(const CostModel& costModel)
+  : costModel {costModel}, memory(memorySize, 0xff), sectorErases(memorySize / sectorSize, 0) {
+  connectedMemory = this;
+}
+
+FakeNorFlash::~FakeNorFlash() {
+  if (connectedMemory == this) {
+    connectedMemory = nullptr;
+  }
+}
+
+void FakeNorFlash::Transfer(const SpiMaster::Transaction& transaction) {
+  assert(connectedMemory != nullptr);
+  connectedMemory->Receive(transaction);
+}
+
+void FakeNorFlash::Receive(const SpiMaster::Transaction& transaction) {
+  // The bytes sent by the master : the command, then the data (or its pattern, repeated)
+  std::vector<uint8_t> mosi(transaction.command, transaction.command + transaction.commandSize);
+  for (size_t i = 0; i < transaction.txDataSize; i++) {
+    const size_t index = (transaction.txDataPatternSize > 0) ? (i % transaction.txDataPatternSize) : i;
+    mosi.push_back(transaction.txData[index]);
+  }
+  if (transaction.rxData != nullptr) {
+    std::memset(transaction.rxData, 0xff, transaction.rxDataSize);
+  }
+
+  const uint64_t duration = costModel.transactionOverheadUs + ((mosi.size() + transaction.rxDataSize) * costModel.byteTimeNs) / 1000;
+  statistics.busTimeUs += duration;
+  statistics.transactions++;
+  // The command is executed when CS is released, at the end of the transaction
+  HostTime::Advance(duration);
+  Execute(mosi, transaction.rxData, transaction.rxDataSize);
+}
+
+uint32_t FakeNorFlash::Address(const std::vector<uint8_t>& mosi) const {
+  return ((mosi[1] << 16) | (mosi[2] << 8) | mosi[3]) % memorySize;
+}
+
+bool FakeNorFlash::Busy() const {
+  return HostTime::Now() < busyUntil;
+}
+
+void FakeNorFlash::Execute(const std::vector<uint8_t>& mosi, uint8_t* miso, size_t misoSize) {
+  if (mosi.empty()) {
+    return;
+  }
+  const auto command = static_cast<Commands>(mosi[0]);
+  auto reply = [miso, misoSize](const uint8_t* data, size_t size) {
+    // A register is sent again and again while CS is asserted
+    for (size_t i = 0; i < misoSize; i++) {
+      miso[i] = data[i % size];
+    }
+  };
+
+  if (deepPowerDown) {
+    if (command == Commands::ReleaseFromDeepPowerDown) {
+      deepPowerDown = false;
+    } else {
+      statistics.errors++;
+    }
+    return;
+  }
+
+  // Only the status registers can be read while a program or an erase is in progress
+  if (Busy() && command != Commands::ReadStatusRegister && command != Commands::ReadSecurityRegister) {
+    statistics.errors++;
+    return;
+  }
+
+  switch (command) {
+    case Commands::ReadStatusRegister: {
+      const uint8_t status = (Busy() ? statusWriteInProgress : 0) | (writeEnabled ? statusWriteEnabled : 0);
+      reply(&status, 1);
+    } break;
+    case Commands::ReadSecurityRegister:
+      reply(&securityRegister, 1);
+      break;
+    case Commands::ReadConfigurationRegister: {
+      const uint8_t configuration = 0;
+      reply(&configuration, 1);
+    } break;
+    case Commands::ReadIdentification:
+      reply(identification, sizeof(identification));
+      break;
+    case Commands::WriteEnable:
+      writeEnabled = true;
+      break;
+    case Commands::WriteDisable:
+      writeEnabled = false;
+      break;
+    case Commands::DeepPowerDown:
+      deepPowerDown = true;
+      break;
+    case Commands::ReleaseFromDeepPowerDown:
+      // The identification follows 3 dummy bytes
+      reply(identification + 2, 1);
+      break;
+    case Commands::Read:
+      if (mosi.size() < 1 + addressSize) {
+        statistics.errors++;
+        break;
+      }
+      for (size_t i = 0; i < misoSize; i++) {
+        // The address wraps around at the end of the memory
+        miso[i] = memory[(Address(mosi) + i) % memorySize];
+      }
+      statistics.readBytes += misoSize;
+      break;
+    case Commands::PageProgram:
+      if (!writeEnabled || mosi.size() < 1 + addressSize || mosi.size() > 1 + addressSize + pageSize) {
+        statistics.errors++;
+        break;
+      }
+      Program(Address(mosi), mosi.data() + 1 + addressSize, mosi.size() - 1 - addressSize);
+      break;
+    case Commands::SectorErase:
+    case Commands::BlockErase32K:
+    case Commands::BlockErase64K:
+      if (!writeEnabled || mosi.size() != 1 + addressSize) {
+        statistics.errors++;
+        break;
+      }
+      if (command == Commands::SectorErase) {
+        Erase(Address(mosi), sectorSize, costModel.sectorEraseTimeUs);
+      } else if (command == Commands::BlockErase32K) {
+        Erase(Address(mosi), 0x8000, costModel.block32KEraseTimeUs);
+      } else {
+        Erase(Address(mosi), 0x10000, costModel.block64KEraseTimeUs);
+      }
+      break;
+    default:
+      statistics.errors++;
+      break;
+  }
+}
+
+void FakeNorFlash::Program(uint32_t address, const uint8_t* data, size_t size) {
+  writeEnabled = false;
+  busyUntil = HostTime::Now() + costModel.pageProgramTimeUs;
+  statistics.pagePrograms++;
+  if (failNextProgram) {
+    failNextProgram = false;
+    securityRegister |= securityProgramFailed;
+    return;
+  }
+  securityRegister &= ~securityProgramFailed;
+
+  const uint32_t page = address & ~(pageSize - 1);
+  for (size_t i = 0; i < size; i++) {
+    // Programming can only clear bits, and the address wraps around at the end of the page
+    memory[page + ((address + i) & (pageSize - 1))] &= data[i];
+  }
+  statistics.programmedBytes += size;
+}
+
+void FakeNorFlash::Erase(uint32_t address, size_t size, uint32_t durationUs) {
+  writeEnabled = false;
+  busyUntil = HostTime::Now() + durationUs;
+  address &= ~(size - 1);
+  std::fill(memory.begin() + address, memory.begin() + address + size, 0xff);
+  for (size_t sector = address / sectorSize; sector < (address + size) / sectorSize; sector++) {
+    sectorErases[sector]++;
+  }
+  statistics.erases++;
+}
+
+uint32_t FakeNorFlash::MaxSectorErases() const {
+  return *std::max_element(sectorErases.begin(), sectorErases.end());
+}
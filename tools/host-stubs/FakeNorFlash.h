@@ -0,0 +1,110 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "drivers/SpiMaster.h"
+
+namespace Pinetime {
+  namespace Drivers {
+    // Host stand-in of the SPI NOR flash memory of the PineTime (4MB, 256 bytes pages, 4KB sectors). The transactions
+    // that the SpiMaster of the host receives from the drivers of the firmware (Spi, SpiNorFlash) are decoded the way
+    // the memory does : reads, page programs (which can only clear bits, and wrap around in the page), erases, and
+    // the status, security and identification registers.
+    //
+    // The time spent on the bus and the duration of the programs and erases advance the simulated time (see
+    // HostTime.h). The memory ignores the commands sent while it's busy, or without write enable, and counts them as
+    // errors.
+    class FakeNorFlash {
+    public:
+      struct CostModel {
+        // 8MHz SPI bus
+        uint32_t byteTimeNs = 1000;
+        // CS, DMA setup, interrupt and task switch
+        uint32_t transactionOverheadUs = 15;
+        uint32_t pageProgramTimeUs = 700;
+        uint32_t sectorEraseTimeUs = 45000;
+        uint32_t block32KEraseTimeUs = 150000;
+        uint32_t block64KEraseTimeUs = 250000;
+      };
+
+      struct Statistics {
+        uint64_t busTimeUs = 0;
+        uint32_t transactions = 0;
+        uint32_t readBytes = 0;
+        uint32_t programmedBytes = 0;
+        uint32_t pagePrograms = 0;
+        uint32_t erases = 0;
+        // Commands ignored by the memory : sent while it was busy or in deep power-down, or without write enable
+        uint32_t errors = 0;
+      };
+
+      static constexpr size_t memorySize = 0x400000;
+      static constexpr size_t pageSize = 256;
+      static constexpr size_t sectorSize = 0x1000;
+
+      // The memory is connected to the SpiMaster of the host until it's destroyed. A new memory is erased.
+      FakeNorFlash();
+      explicit FakeNorFlash(const CostModel& costModel);
+      ~FakeNorFlash();
+      FakeNorFlash(const FakeNorFlash&) = delete;
+      FakeNorFlash& operator=(const FakeNorFlash&) = delete;
+      FakeNorFlash(FakeNorFlash&&) = delete;
+      FakeNorFlash& operator=(FakeNorFlash&&) = delete;
+
+      // Called by SpiMaster::Submit()
+      static void Transfer(const SpiMaster::Transaction& transaction);
+
+      uint8_t* Memory() {
+        return memory.data();
+      }
+
+      const Statistics& GetStatistics() const {
+        return statistics;
+      }
+
+      // Highest number of erases of a single sector since the memory was created
+      uint32_t MaxSectorErases() const;
+
+      // The next page program fails : the page isn't written, and the P_FAIL bit of the security register is set
+      void FailNextProgram() {
+        failNextProgram = true;
+      }
+
+    private:
+      enum class Commands : uint8_t {
+        PageProgram = 0x02,
+        Read = 0x03,
+        WriteDisable = 0x04,
+        ReadStatusRegister = 0x05,
+        WriteEnable = 0x06,
+        ReadConfigurationRegister = 0x15,
+        SectorErase = 0x20,
+        ReadSecurityRegister = 0x2B,
+        BlockErase32K = 0x52,
+        ReadIdentification = 0x9F,
+        ReleaseFromDeepPowerDown = 0xAB,
+        DeepPowerDown = 0xB9,
+        BlockErase64K = 0xD8
+      };
+
+      static constexpr uint8_t securityProgramFailed = 0x20;
+
+      void Receive(const SpiMaster::Transaction& transaction);
+      void Execute(const std::vector<uint8_t>& mosi, uint8_t* miso, size_t misoSize);
+      uint32_t Address(const std::vector<uint8_t>& mosi) const;
+      void Program(uint32_t address, const uint8_t* data, size_t size);
+      void Erase(uint32_t address, size_t size, uint32_t durationUs);
+      bool Busy() const;
+
+      CostModel costModel;
+      Statistics statistics;
+      std::vector<uint8_t> memory;
+      std::vector<uint32_t> sectorErases;
+      uint64_t busyUntil = 0;
+      bool writeEnabled = false;
+      bool deepPowerDown = false;
+      bool failNextProgram = false;
+      uint8_t securityRegister = 0;
+    };
+  }
+}
@@ -0,0 +1,22 @@
+#pragma once
+// Host stand-in of the FreeRTOS headers for the tools built on Linux (see tools/flash-sim and tools/host-tests).
+// The code runs in a single task : the semaphores are always available, and the delays advance the simulated
+// time of HostTime.h instead of blocking.
+
+#include <cstddef>
+#include <cstdint>
+#include <nrf.h>
+#include <nrf_assert.h>
+
+using BaseType_t = long;
+using UBaseType_t = unsigned long;
+using TickType_t = uint32_t;
+using TaskHandle_t = void*;
+using SemaphoreHandle_t = void*;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define portMAX_DELAY 0xffffffffU
+#define configTICK_RATE_HZ 1024
+#define pdMS_TO_TICKS(ms) ((TickType_t) (((TickType_t) (ms) * (TickType_t) configTICK_RATE_HZ) / (TickType_t) 1000))
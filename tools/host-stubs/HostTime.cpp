@@ -0,0 +1,47 @@
+#include "HostTime.h"
+#include <FreeRTOS.h>
+#include <task.h>
+#include <libraries/delay/nrf_delay.h>
+
+namespace {
+  uint64_t now = 0;
+  uint64_t waitTime = 0;
+
+  uint64_t TickStart(uint64_t tick) {
+    return ((tick * 1000000) + configTICK_RATE_HZ - 1) / configTICK_RATE_HZ;
+  }
+
+  void Wait(uint64_t until) {
+    if (until > now) {
+      waitTime += until - now;
+      now = until;
+    }
+  }
+}
+
+uint64_t HostTime::Now() {
+  return now;
+}
+
+void HostTime::Advance(uint64_t us) {
+  now += us;
+}
+
+uint64_t HostTime::WaitTime() {
+  return waitTime;
+}
+
+TickType_t xTaskGetTickCount() {
+  return static_cast<TickType_t>((now * configTICK_RATE_HZ) / 1000000);
+}
+
+void vTaskDelay(TickType_t ticks) {
+  // The task is woken up by the tick interrupt
+  if (ticks > 0) {
+    Wait(TickStart(static_cast<uint64_t>(xTaskGetTickCount()) + ticks));
+  }
+}
+
+void nrf_delay_us(uint32_t us) {
+  Wait(now + us);
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <cstdint>
+
+// Simulated time of the host tools, in µs. It advances when the code waits (vTaskDelay(), nrf_delay_us()) and when
+// a simulated peripheral is busy (see FakeNorFlash) : the code itself runs in no time.
+namespace HostTime {
+  uint64_t Now();
+  void Advance(uint64_t us);
+  // Time spent in vTaskDelay() and nrf_delay_us() since the start
+  uint64_t WaitTime();
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+
+inline void nrf_gpio_cfg_output(uint32_t /*pin*/) {
+}
+
+inline void nrf_gpio_cfg_default(uint32_t /*pin*/) {
+}
+
+inline void nrf_gpio_pin_set(uint32_t /*pin*/) {
+}
+
+inline void nrf_gpio_pin_clear(uint32_t /*pin*/) {
+}
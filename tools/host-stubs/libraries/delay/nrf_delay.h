@@ -0,0 +1,9 @@
+#pragma once
+#include <cstdint>
+
+// Busy waits advance the simulated time (see HostTime.h)
+void nrf_delay_us(uint32_t us);
+
+inline void nrf_delay_ms(uint32_t ms) {
+  nrf_delay_us(ms * 1000);
+}
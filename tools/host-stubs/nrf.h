@@ -0,0 +1,17 @@
+#pragma once
+// Host stand-in of the device header : the peripherals are opaque, and the Cortex-M4 intrinsics used by the
+// firmware are computed in portable C++.
+
+#include <cstdint>
+
+struct NRF_SPIM_Type;
+
+// Reverses the bytes of each half word
+inline uint32_t __REV16(uint32_t value) {
+  return ((value & 0x00ff00ffU) << 8) | ((value >> 8) & 0x00ff00ffU);
+}
+
+// Adds the 16-bit lanes of a and b, each lane wraps around on its own
+inline uint32_t __UADD16(uint32_t a, uint32_t b) {
+  return ((a + b) & 0x0000ffffU) | (((a & 0xffff0000U) + (b & 0xffff0000U)) & 0xffff0000U);
+}
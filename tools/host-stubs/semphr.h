@@ -0,0 +1,31 @@
+#pragma once
+#include <FreeRTOS.h>
+
+// A single task uses the semaphores : they are never taken by someone else
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+  return reinterpret_cast<SemaphoreHandle_t>(1);
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+  return reinterpret_cast<SemaphoreHandle_t>(1);
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateBinary() {
+  return reinterpret_cast<SemaphoreHandle_t>(1);
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t /*semaphore*/, TickType_t /*ticksToWait*/) {
+  return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t /*semaphore*/) {
+  return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t /*semaphore*/, TickType_t /*ticksToWait*/) {
+  return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t /*semaphore*/) {
+  return pdTRUE;
+}
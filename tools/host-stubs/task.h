@@ -0,0 +1,9 @@
+#pragma once
+#include <FreeRTOS.h>
+
+TickType_t xTaskGetTickCount();
+void vTaskDelay(TickType_t ticks);
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return nullptr;
+}
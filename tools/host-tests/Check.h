@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdio>
+
+// Checks of the host tests : a failed check is printed, and the test returns the number of failures
+namespace HostTest {
+  inline int& Failures() {
+    static int failures = 0;
+    return failures;
+  }
+
+  inline bool Check(bool condition, const char* expression, const char* file, int line) {
+    if (!condition) {
+      std::printf("%s:%d: check failed : %s\n", file, line, expression);
+      Failures()++;
+    }
+    return condition;
+  }
+}
+
+#define CHECK(condition) HostTest::Check((condition), #condition, __FILE__, __LINE__)
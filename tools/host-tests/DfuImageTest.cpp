@@ -0,0 +1,358 @@
+// Transfers of firmware images through DfuImage, written by the driver of the firmware (SpiNorFlash) into a
+// simulated flash memory. The content of the DFU slot is compared to the image after each transfer. The compressed
+// images and the patches are made by dfu-streams.py with tools/dfu-compress.py.
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+#include "Check.h"
+#include "FakeNorFlash.h"
+#include "Streams.h"
+#include "components/ble/DfuImage.h"
+#include "components/kvstore/KeyValueStore.h"
+#include "components/utility/Crc16.h"
+#include "drivers/Spi.h"
+#include "drivers/SpiNorFlash.h"
+#include "HostTime.h"
+
+using Pinetime::Controllers::DfuImage;
+using Pinetime::Controllers::KeyValueStore;
+using Pinetime::Drivers::FakeNorFlash;
+
+namespace {
+  // The DFU slot in the external flash memory (see FS.h), and the size of an image
+  constexpr uint32_t slotAddress = 0x40000;
+  constexpr size_t slotSize = 475136;
+  // A checkpoint is saved at the end of each sector of the image, and each sector is compressed on its own
+  constexpr size_t checkpointInterval = 4096;
+  // The internal flash memory, where the running firmware starts
+  constexpr size_t internalMemorySize = 0x80000 - 0x8000;
+
+#ifdef DFU_READ_BACK
+  constexpr bool readBack = true;
+#else
+  constexpr bool readBack = false;
+#endif
+
+  std::mt19937 random {1};
+  std::map<KeyValueStore::Keys, std::vector<uint8_t>> values;
+
+  size_t Random(size_t min, size_t max) {
+    return std::uniform_int_distribution<size_t> {min, max}(random);
+  }
+
+  std::vector<uint8_t> RandomData(size_t size) {
+    std::vector<uint8_t> data(size);
+    for (auto& byte : data) {
+      byte = static_cast<uint8_t>(random());
+    }
+    return data;
+  }
+
+  // The CRC computed by DfuImage before Crc16 : CRC-16/CCITT-FALSE, one bit at a time
+  uint16_t BitwiseCrc(const uint8_t* data, size_t size) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < size; i++) {
+      crc = static_cast<uint8_t>(crc >> 8) | (crc << 8);
+      crc ^= data[i];
+      crc ^= static_cast<uint8_t>(crc & 0xFF) >> 4;
+      crc ^= (crc << 8) << 4;
+      crc ^= ((crc & 0xFF) << 4) << 1;
+    }
+    return crc;
+  }
+
+  // Packets of 20 bytes (legacy companion apps), or of random sizes up to the largest ATT MTU
+  size_t PacketSize(bool legacy) {
+    return legacy ? 20 : Random(1, 244);
+  }
+
+  void Send(DfuImage& image, const std::vector<uint8_t>& data, size_t from, size_t to, bool legacy) {
+    while (from < to) {
+      const size_t size = std::min(PacketSize(legacy), to - from);
+      image.Append(data.data() + from, size);
+      from += size;
+    }
+  }
+
+  bool SlotEquals(FakeNorFlash& memory, const std::vector<uint8_t>& image) {
+    return std::memcmp(memory.Memory() + slotAddress, image.data(), image.size()) == 0;
+  }
+
+  void TestCrc() {
+    for (int run = 0; run < 100; run++) {
+      const auto data = RandomData(Random(0, 5000));
+      // Computed by chunks, as the packets are received
+      uint16_t crc = 0xFFFF;
+      for (size_t offset = 0; offset < data.size();) {
+        const size_t size = std::min(Random(1, 300), data.size() - offset);
+        crc = Pinetime::Utility::Crc16(crc, data.data() + offset, size);
+        offset += size;
+      }
+      CHECK(crc == BitwiseCrc(data.data(), data.size()));
+    }
+    // Check value of CRC-16/CCITT-FALSE
+    const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    CHECK(Pinetime::Utility::Crc16(0xFFFF, check, sizeof(check)) == 0x29B1);
+  }
+
+  void TestTransfers(FakeNorFlash& memory, Pinetime::Drivers::SpiNorFlash& flash, KeyValueStore& store) {
+    for (int run = 0; run < 40; run++) {
+      const size_t size = (run == 0) ? slotSize : Random(1, 400000);
+      const auto image = RandomData(size);
+      const uint16_t crc = Pinetime::Utility::Crc16(0xFFFF, image.data(), size);
+      const bool legacy = (run % 2) == 1;
+
+      DfuImage dfuImage {flash, store};
+      dfuImage.Erase();
+      dfuImage.Init(size, crc, DfuImage::Encodings::Raw);
+      Send(dfuImage, image, 0, size, legacy);
+      CHECK(dfuImage.IsComplete());
+      CHECK(!dfuImage.HasFailed());
+
+      // The CRC is computed during the transfer : the image isn't read again, except its last page with DFU_READ_BACK
+      const uint32_t readBytes = memory.GetStatistics().readBytes;
+      CHECK(dfuImage.Validate());
+      const uint32_t validationReads = memory.GetStatistics().readBytes - readBytes;
+      CHECK(validationReads <= (readBack ? 256u : 0u));
+      CHECK(SlotEquals(memory, image));
+      if (size < slotSize) {
+        // The magic number at the end of the slot
+        uint32_t magic[4];
+        std::memcpy(magic, memory.Memory() + slotAddress + slotSize - sizeof(magic), sizeof(magic));
+        CHECK(magic[0] == 0xf395c277 && magic[1] == 0x7fefd260 && magic[2] == 0x0f505235 && magic[3] == 0x8079b62c);
+      }
+    }
+  }
+
+  // Starts a transfer the way DfuService does : the erase is deferred while the checkpoint may be for this image, and
+  // the companion that asks for the offset (Report Received Image Size) sends the image from there.
+  size_t Start(DfuImage& dfuImage, size_t size, uint16_t crc, bool resumeRequested) {
+    if (!dfuImage.HasCheckpoint(size) || dfuImage.ResumeOffset(size, crc) == 0) {
+      dfuImage.Erase();
+    }
+    const size_t offset = resumeRequested ? dfuImage.ResumeOffset(size, crc) : 0;
+    if (!resumeRequested || !dfuImage.Resume(size, crc, DfuImage::Encodings::Raw)) {
+      dfuImage.Init(size, crc, DfuImage::Encodings::Raw);
+    }
+    CHECK(dfuImage.Offset() == offset);
+    return offset;
+  }
+
+  void TestResume(FakeNorFlash& memory, Pinetime::Drivers::Spi& spi, KeyValueStore& store) {
+    for (int run = 0; run < 60; run++) {
+      const size_t size = Random(checkpointInterval + 1, 200000);
+      const auto image = RandomData(size);
+      const uint16_t crc = Pinetime::Utility::Crc16(0xFFFF, image.data(), size);
+      const bool legacy = (run % 2) == 1;
+      const bool resumeRequested = (run % 3) != 0;
+      // The link is lost, or the watch reboots and the data in the write-behind queue is lost too
+      const bool reboot = (run % 4) == 0;
+      const bool otherImage = (run % 5) == 0;
+
+      auto flash = std::make_unique<Pinetime::Drivers::SpiNorFlash>(spi);
+      flash->Init();
+      auto dfuImage = std::make_unique<DfuImage>(*flash, store);
+      Start(*dfuImage, size, crc, resumeRequested);
+      const size_t interruption = Random(0, size - 1);
+      Send(*dfuImage, image, 0, interruption, legacy);
+      // The last checkpoint before the interruption
+      const size_t checkpoint = interruption / checkpointInterval * checkpointInterval;
+      CHECK(dfuImage->ResumeOffset(size, crc) == checkpoint);
+      CHECK(dfuImage->ResumeOffset(size, crc ^ 0x0100) == 0);
+
+      if (reboot) {
+        HostTime::Advance(1000000);
+        dfuImage.reset();
+        flash = std::make_unique<Pinetime::Drivers::SpiNorFlash>(spi);
+        flash->Init();
+        dfuImage = std::make_unique<DfuImage>(*flash, store);
+      }
+
+      if (otherImage) {
+        // Another image of the same size is sent (and interrupted too) : its checkpoint replaces the first one
+        const auto other = RandomData(size);
+        const uint16_t otherCrc = Pinetime::Utility::Crc16(0xFFFF, other.data(), size);
+        Start(*dfuImage, size, otherCrc, resumeRequested);
+        Send(*dfuImage, other, 0, Random(0, size - 1), legacy);
+        CHECK(!dfuImage->HasCheckpoint(size) || dfuImage->ResumeOffset(size, crc) == 0);
+      }
+
+      // The data before the checkpoint isn't erased or sent again. Without the request of the offset, the same data
+      // is written again over the one already programmed.
+      const uint32_t erases = memory.GetStatistics().erases;
+      const size_t offset = Start(*dfuImage, size, crc, resumeRequested);
+      CHECK(offset == ((resumeRequested && !otherImage) ? checkpoint : 0));
+      CHECK((memory.GetStatistics().erases != erases) == (otherImage || checkpoint == 0));
+      Send(*dfuImage, image, offset, size, legacy);
+      CHECK(dfuImage->Validate());
+      CHECK(SlotEquals(memory, image));
+      // Valid or not, the image isn't resumed again
+      CHECK(!dfuImage->HasCheckpoint(size));
+    }
+  }
+
+  // Interrupted at a random offset of the stream : the transfer continues from the block of the checkpoint
+  void TestCompressed(FakeNorFlash& memory,
+                      Pinetime::Drivers::SpiNorFlash& flash,
+                      KeyValueStore& store,
+                      const std::vector<HostTest::Stream>& streams) {
+    for (const auto& stream : streams) {
+      if (stream.delta) {
+        continue;
+      }
+      for (int run = 0; run < 10; run++) {
+        const size_t size = stream.image.size();
+        const uint16_t crc = Pinetime::Utility::Crc16(0xFFFF, stream.image.data(), size);
+        const bool legacy = (run % 2) == 1;
+
+        DfuImage dfuImage {flash, store};
+        dfuImage.Erase();
+        dfuImage.Init(size, crc, DfuImage::Encodings::Compressed);
+        Send(dfuImage, stream.stream, 0, Random(0, stream.stream.size()), legacy);
+        const size_t offset = dfuImage.ResumeOffset(size, crc);
+        if (!dfuImage.Resume(size, crc, DfuImage::Encodings::Compressed)) {
+          dfuImage.Init(size, crc, DfuImage::Encodings::Compressed);
+        }
+        CHECK(dfuImage.Offset() == offset);
+        Send(dfuImage, stream.stream, stream.blockOffsets[offset / checkpointInterval], stream.stream.size(), legacy);
+        CHECK(dfuImage.IsComplete());
+        CHECK(!dfuImage.HasFailed());
+        CHECK(dfuImage.Validate());
+        CHECK(SlotEquals(memory, stream.image));
+      }
+    }
+  }
+
+  // The patches are applied to the running firmware in a fake internal flash memory
+  void TestDelta(FakeNorFlash& memory,
+                 Pinetime::Drivers::SpiNorFlash& flash,
+                 KeyValueStore& store,
+                 const std::vector<HostTest::Stream>& streams) {
+    for (const auto& stream : streams) {
+      if (!stream.delta) {
+        continue;
+      }
+      std::vector<uint8_t> internalMemory(internalMemorySize, 0xFF);
+      std::copy(stream.running.begin(), stream.running.end(), internalMemory.begin());
+      const size_t size = stream.image.size();
+      const uint16_t crc = Pinetime::Utility::Crc16(0xFFFF, stream.image.data(), size);
+
+      for (int run = 0; run < 10; run++) {
+        DfuImage dfuImage {flash, store, internalMemory.data()};
+        dfuImage.Erase();
+        dfuImage.Init(size, crc, DfuImage::Encodings::Delta);
+        Send(dfuImage, stream.stream, 0, stream.stream.size(), (run % 2) == 1);
+        CHECK(dfuImage.IsComplete());
+        CHECK(!dfuImage.HasFailed());
+        CHECK(dfuImage.Validate());
+        CHECK(SlotEquals(memory, stream.image));
+      }
+
+      // A patch is always sent from the beginning
+      DfuImage interrupted {flash, store, internalMemory.data()};
+      interrupted.Erase();
+      interrupted.Init(size, crc, DfuImage::Encodings::Delta);
+      Send(interrupted, stream.stream, 0, Random(0, stream.stream.size() - 1), false);
+      CHECK(!interrupted.Resume(size, crc, DfuImage::Encodings::Delta));
+
+      // Another firmware is running : the patch fails at its header, and nothing is written
+      internalMemory[Random(0, stream.running.size() - 1)] ^= 0x01;
+      DfuImage otherFirmware {flash, store, internalMemory.data()};
+      otherFirmware.Erase();
+      otherFirmware.Init(size, crc, DfuImage::Encodings::Delta);
+      Send(otherFirmware, stream.stream, 0, stream.stream.size(), false);
+      CHECK(otherFirmware.HasFailed());
+      CHECK(otherFirmware.Offset() == 0);
+      CHECK(!otherFirmware.Validate());
+    }
+  }
+
+  void TestBadImages(FakeNorFlash& memory, Pinetime::Drivers::SpiNorFlash& flash, KeyValueStore& store) {
+    for (int run = 0; run < 10; run++) {
+      const size_t size = Random(1000, 100000);
+      const auto image = RandomData(size);
+      const uint16_t crc = Pinetime::Utility::Crc16(0xFFFF, image.data(), size);
+
+      // Not the CRC of the init packet
+      DfuImage wrongCrc {flash, store};
+      wrongCrc.Erase();
+      wrongCrc.Init(size, crc ^ 0x0100, DfuImage::Encodings::Raw);
+      Send(wrongCrc, image, 0, size, false);
+      CHECK(!wrongCrc.Validate());
+
+      // A page that fails to be programmed : the failure is reported at the next sync
+      DfuImage programFailure {flash, store};
+      programFailure.Erase();
+      programFailure.Init(size, crc, DfuImage::Encodings::Raw);
+      const size_t failureOffset = Random(0, size - 1);
+      Send(programFailure, image, 0, failureOffset, false);
+      memory.FailNextProgram();
+      Send(programFailure, image, failureOffset, size, false);
+      CHECK(programFailure.HasFailed());
+
+      // A bit stuck at 0 in the flash memory : the data received is right, only the read back finds the error
+      DfuImage stuckBit {flash, store};
+      stuckBit.Erase();
+      size_t offset = Random(0, size - 1);
+      while ((image[offset] & 0x01) == 0) {
+        offset = (offset + 1) % size;
+      }
+      memory.Memory()[slotAddress + offset] &= 0xfe;
+      stuckBit.Init(size, crc, DfuImage::Encodings::Raw);
+      Send(stuckBit, image, 0, size, false);
+      CHECK(stuckBit.Validate() == !readBack);
+    }
+  }
+}
+
+// The values of DfuImage are kept in RAM, the key-value store itself isn't tested here
+KeyValueStore::KeyValueStore(Pinetime::Controllers::FS& fs) : fs {fs} {
+}
+
+size_t KeyValueStore::Read(Keys key, void* value, size_t size) {
+  const auto& data = values[key];
+  std::memcpy(value, data.data(), std::min(size, data.size()));
+  return data.size();
+}
+
+bool KeyValueStore::Write(Keys key, const void* value, size_t size) {
+  values[key].assign(static_cast<const uint8_t*>(value), static_cast<const uint8_t*>(value) + size);
+  return true;
+}
+
+void KeyValueStore::Delete(Keys key) {
+  values[key].clear();
+}
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    std::printf("Usage : %s DIRECTORY (the output of dfu-streams.py)\n", argv[0]);
+    return 1;
+  }
+  const auto streams = HostTest::ReadStreams(argv[1]);
+  CHECK(!streams.empty());
+
+  FakeNorFlash memory;
+  Pinetime::Drivers::SpiMaster spiMaster {Pinetime::Drivers::SpiMaster::SpiModule::SPI0, {}};
+  Pinetime::Drivers::Spi spi {spiMaster, 0, Pinetime::Drivers::SpiMaster::Priority::Normal};
+  Pinetime::Drivers::SpiNorFlash flash {spi};
+  flash.Init();
+  // The file system isn't used by the values kept in RAM
+  KeyValueStore store {*reinterpret_cast<Pinetime::Controllers::FS*>(&memory)};
+
+  TestCrc();
+  TestTransfers(memory, flash, store);
+  TestBadImages(memory, flash, store);
+  TestResume(memory, spi, store);
+  TestCompressed(memory, flash, store, streams);
+  TestDelta(memory, flash, store, streams);
+
+  // The driver must wait for the memory, and enable the writes before each program and erase
+  CHECK(memory.GetStatistics().errors == 0);
+  std::printf("DfuImage%s : %d failures\n", readBack ? " (DFU_READ_BACK)" : "", HostTest::Failures());
+  return (HostTest::Failures() == 0) ? 0 : 1;
+}
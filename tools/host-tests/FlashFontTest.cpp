@@ -0,0 +1,252 @@
+// Glyphs of random fonts in the binary format of lv_font_conv, made by flash-fonts.py, drawn through FlashFont. The
+// files are kept in RAM behind the lv_fs functions, and the LVGL heap is the heap of the host.
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Check.h"
+#include "Streams.h"
+#include "displayapp/FlashFont.h"
+
+namespace FlashFont = Pinetime::Components::FlashFont;
+
+namespace {
+  std::map<std::string, std::vector<uint8_t>> files;
+  int openFiles = 0;
+  std::map<void*, size_t> allocations;
+  // The fonts loaded by lv_font_load()
+  lv_font_t loadedFont;
+  int loadedFonts = 0;
+
+  struct OpenFile {
+    const std::vector<uint8_t>* data;
+    uint32_t position;
+  };
+
+  size_t HeapUsed() {
+    size_t used = 0;
+    for (const auto& allocation : allocations) {
+      used += allocation.second;
+    }
+    return used;
+  }
+
+  struct Font {
+    std::vector<uint8_t> data;
+    std::string expected;
+    std::vector<uint8_t> variant;
+    std::string variantExpected;
+  };
+
+  std::vector<Font> ReadFonts(const std::string& directory) {
+    std::vector<Font> fonts;
+    std::ifstream list {directory + "/fonts.txt"};
+    std::string line;
+    while (std::getline(list, line)) {
+      std::istringstream fields {line};
+      std::string names[4];
+      fields >> names[0] >> names[1] >> names[2] >> names[3];
+      const auto expected = HostTest::ReadFile(directory + "/" + names[1]);
+      const auto variantExpected = HostTest::ReadFile(directory + "/" + names[3]);
+      fonts.push_back({HostTest::ReadFile(directory + "/" + names[0]),
+                       {expected.begin(), expected.end()},
+                       HostTest::ReadFile(directory + "/" + names[2]),
+                       {variantExpected.begin(), variantExpected.end()}});
+    }
+    return fonts;
+  }
+
+  // Compares the glyphs of the font with the expected file, and returns the size of its largest bitmap
+  size_t CheckGlyphs(const lv_font_t* font, const std::string& expected) {
+    std::istringstream lines {expected};
+    int lineHeight, baseLine;
+    lines >> lineHeight >> baseLine;
+    CHECK(font->line_height == lineHeight && font->base_line == baseLine);
+
+    size_t maxBitmapSize = 0;
+    uint32_t letter, next;
+    std::string advanceWidth;
+    while (lines >> letter >> next >> advanceWidth) {
+      lv_font_glyph_dsc_t dsc;
+      const bool found = font->get_glyph_dsc(font, &dsc, letter, next);
+      if (advanceWidth == "-") {
+        CHECK(!found);
+        continue;
+      }
+      int boxWidth, boxHeight, offsetX, offsetY;
+      std::string bitmap;
+      lines >> boxWidth >> boxHeight >> offsetX >> offsetY >> bitmap;
+      // A negative advance width (kerning of a narrow glyph) wraps around, as with lv_font_get_glyph_dsc_fmt_txt()
+      const auto expectedAdvanceWidth = static_cast<uint16_t>(std::stoi(advanceWidth));
+      if (!CHECK(found) || !CHECK(dsc.adv_w == expectedAdvanceWidth && dsc.box_w == boxWidth && dsc.box_h == boxHeight &&
+                                  dsc.ofs_x == offsetX && dsc.ofs_y == offsetY)) {
+        continue;
+      }
+      const uint8_t* data = font->get_glyph_bitmap(font, letter);
+      if (!CHECK(data != nullptr) || bitmap == ".") {
+        continue;
+      }
+      maxBitmapSize = std::max(maxBitmapSize, bitmap.size() / 2);
+      for (size_t i = 0; i < bitmap.size() / 2; i++) {
+        if (!CHECK(data[i] == std::stoi(bitmap.substr(2 * i, 2), nullptr, 16))) {
+          break;
+        }
+      }
+    }
+    return maxBitmapSize;
+  }
+
+  void TestFonts(const std::vector<Font>& fonts) {
+    for (size_t i = 1; i < fonts.size(); i++) {
+      // Two fonts in use share the caches
+      files["R:/a"] = fonts[i].data;
+      files["R:/b"] = fonts[i - 1].data;
+      lv_font_t* a = FlashFont::Acquire("R:/a");
+      lv_font_t* b = FlashFont::Acquire("R:/b");
+      if (!CHECK(a != nullptr && a != &loadedFont && b != nullptr && b != &loadedFont)) {
+        continue;
+      }
+      const size_t maxBitmapSizes = CheckGlyphs(a, fonts[i].expected) + CheckGlyphs(b, fonts[i - 1].expected);
+      // The bitmap cache holds the largest bitmaps of 6 glyphs of each font
+      CHECK(HeapUsed() >= 6 * maxBitmapSizes);
+      FlashFont::Release(b);
+
+      // A released font keeps its slot and its glyphs
+      FlashFont::Release(a);
+      CHECK(openFiles == 0);
+      CHECK(allocations.empty());
+      CHECK(FlashFont::Acquire("R:/a") == a);
+      CheckGlyphs(a, fonts[i].expected);
+      FlashFont::Release(a);
+
+      // Replaced by a file of the same size : the glyphs of the previous one aren't used
+      files["R:/a"] = fonts[i].variant;
+      CHECK(FlashFont::Acquire("R:/a") == a);
+      CheckGlyphs(a, fonts[i].variantExpected);
+      FlashFont::Release(a);
+    }
+    CHECK(openFiles == 0);
+    CHECK(allocations.empty());
+  }
+
+  void TestLoadedFonts(const std::vector<Font>& fonts, const std::string& directory) {
+    // No file
+    CHECK(FlashFont::Acquire("R:/missing") == nullptr);
+
+    // Compressed fonts and long paths are loaded in RAM by LVGL
+    files["R:/compressed"] = HostTest::ReadFile(directory + "/compressed.bin");
+    lv_font_t* compressed = FlashFont::Acquire("R:/compressed");
+    CHECK(compressed == &loadedFont);
+    FlashFont::Release(compressed);
+    const std::string longPath = "R:/" + std::string(40, 'f');
+    files[longPath] = fonts[0].data;
+    lv_font_t* longPathFont = FlashFont::Acquire(longPath.c_str());
+    CHECK(longPathFont == &loadedFont);
+    FlashFont::Release(longPathFont);
+
+    // All the slots are in use
+    std::vector<lv_font_t*> acquired;
+    for (size_t i = 0; i < 4; i++) {
+      const std::string path = "R:/" + std::to_string(i);
+      files[path] = fonts[i].data;
+      acquired.push_back(FlashFont::Acquire(path.c_str()));
+      CHECK(acquired.back() != nullptr && acquired.back() != &loadedFont);
+    }
+    files["R:/4"] = fonts[4].data;
+    lv_font_t* fifth = FlashFont::Acquire("R:/4");
+    CHECK(fifth == &loadedFont);
+    FlashFont::Release(fifth);
+    for (size_t i = 0; i < acquired.size(); i++) {
+      CheckGlyphs(acquired[i], fonts[i].expected);
+      FlashFont::Release(acquired[i]);
+    }
+
+    CHECK(loadedFonts == 0);
+    CHECK(openFiles == 0);
+    CHECK(allocations.empty());
+  }
+}
+
+lv_fs_res_t lv_fs_open(lv_fs_file_t* file, const char* path, lv_fs_mode_t /*mode*/) {
+  const auto found = files.find(path);
+  if (found == files.end()) {
+    return LV_FS_RES_NOT_EX;
+  }
+  file->file_d = new OpenFile {&found->second, 0};
+  openFiles++;
+  return LV_FS_RES_OK;
+}
+
+lv_fs_res_t lv_fs_close(lv_fs_file_t* file) {
+  delete static_cast<OpenFile*>(file->file_d);
+  openFiles--;
+  return LV_FS_RES_OK;
+}
+
+lv_fs_res_t lv_fs_seek(lv_fs_file_t* file, uint32_t position) {
+  static_cast<OpenFile*>(file->file_d)->position = position;
+  return LV_FS_RES_OK;
+}
+
+lv_fs_res_t lv_fs_size(lv_fs_file_t* file, uint32_t* size) {
+  *size = static_cast<OpenFile*>(file->file_d)->data->size();
+  return LV_FS_RES_OK;
+}
+
+lv_fs_res_t lv_fs_read(lv_fs_file_t* file, void* buffer, uint32_t size, uint32_t* read) {
+  auto* openFile = static_cast<OpenFile*>(file->file_d);
+  const size_t fileSize = openFile->data->size();
+  *read = (openFile->position >= fileSize) ? 0 : std::min<uint32_t>(size, fileSize - openFile->position);
+  std::copy_n(openFile->data->data() + openFile->position, *read, static_cast<uint8_t*>(buffer));
+  openFile->position += *read;
+  return LV_FS_RES_OK;
+}
+
+lv_font_t* lv_font_load(const char* /*path*/) {
+  loadedFonts++;
+  return &loadedFont;
+}
+
+void lv_font_free(lv_font_t* font) {
+  CHECK(font == &loadedFont);
+  loadedFonts--;
+}
+
+void* lv_mem_alloc(size_t size) {
+  void* data = std::malloc(size);
+  allocations[data] = size;
+  return data;
+}
+
+void* lv_mem_realloc(void* data, size_t size) {
+  allocations.erase(data);
+  data = std::realloc(data, size);
+  allocations[data] = size;
+  return data;
+}
+
+void lv_mem_free(const void* data) {
+  allocations.erase(const_cast<void*>(data));
+  std::free(const_cast<void*>(data));
+}
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    std::printf("Usage : %s DIRECTORY (the output of flash-fonts.py)\n", argv[0]);
+    return 1;
+  }
+  const auto fonts = ReadFonts(argv[1]);
+  if (!CHECK(fonts.size() >= 5)) {
+    return 1;
+  }
+
+  TestFonts(fonts);
+  TestLoadedFonts(fonts, argv[1]);
+
+  std::printf("FlashFont : %zu fonts, %d failures\n", fonts.size(), HostTest::Failures());
+  return (HostTest::Failures() == 0) ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+// Decompression of the streams made by tools/dfu-compress.py, with the input and the output split at random sizes :
+// the fields of the stream are split at any bit, and the back-references at any byte.
+
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "Check.h"
+#include "Streams.h"
+#include "components/utility/HeatshrinkDecoder.h"
+
+using Pinetime::Utility::HeatshrinkDecoder;
+
+namespace {
+  // The size of the blocks of a compressed image
+  constexpr size_t blockSize = 4096;
+  constexpr size_t bufferSize = 256;
+
+  std::mt19937 random {1};
+  HeatshrinkDecoder decoder;
+
+  size_t Random(size_t min, size_t max) {
+    return std::uniform_int_distribution<size_t> {min, max}(random);
+  }
+
+  // Decodes size bytes of output from the input at offset, in pieces of at most maxInput and maxOutput bytes.
+  // Returns the offset of the input after the last byte read.
+  size_t Decode(const std::vector<uint8_t>& input,
+                size_t offset,
+                std::vector<uint8_t>& output,
+                size_t size,
+                size_t maxInput,
+                size_t maxOutput) {
+    const size_t end = output.size() + size;
+    uint8_t buffer[bufferSize];
+    while (output.size() < end) {
+      const size_t inputSize = std::min(Random(1, maxInput), input.size() - offset);
+      const size_t outputSize = std::min(Random(1, maxOutput), end - output.size());
+      size_t produced;
+      const size_t consumed = decoder.Decode(input.data() + offset, inputSize, buffer, outputSize, produced);
+      output.insert(output.end(), buffer, buffer + produced);
+      offset += consumed;
+      if (consumed == 0 && produced == 0) {
+        // The stream ends before size bytes
+        break;
+      }
+    }
+    return offset;
+  }
+
+  void TestStreams(const std::vector<HostTest::Stream>& streams) {
+    for (const auto& stream : streams) {
+      for (int run = 0; run < 20; run++) {
+        // Bytes one at a time, pieces of up to the whole stream, and packets of up to the largest ATT MTU
+        const size_t maxInput = (run == 0) ? 1 : (run == 1) ? stream.stream.size() : Random(1, 244);
+        const size_t maxOutput = (run == 0) ? 1 : Random(1, bufferSize);
+        std::vector<uint8_t> output;
+        size_t offset = 0;
+        decoder.Reset();
+        if (stream.delta) {
+          // A patch is a single stream
+          offset = Decode(stream.stream, offset, output, stream.decompressed.size(), maxInput, maxOutput);
+        } else {
+          // The decoder starts again at each block, at the next byte of the stream
+          for (size_t block = 0; block < stream.blockOffsets.size(); block++) {
+            CHECK(offset == stream.blockOffsets[block]);
+            decoder.Reset();
+            const size_t size = std::min(blockSize, stream.image.size() - block * blockSize);
+            offset = Decode(stream.stream, offset, output, size, maxInput, maxOutput);
+          }
+        }
+        CHECK(output == stream.decompressed);
+        // The padding of the last byte is read with its last field
+        CHECK(offset == stream.stream.size());
+      }
+    }
+  }
+
+  // Any input is decoded the same way, whatever its split : the references before the start of the stream read zeros
+  void TestRandomInput() {
+    for (int run = 0; run < 200; run++) {
+      std::vector<uint8_t> input(Random(1, 2000));
+      for (auto& byte : input) {
+        byte = static_cast<uint8_t>(random());
+      }
+      const size_t size = Random(1, 5000);
+      std::vector<uint8_t> whole;
+      decoder.Reset();
+      Decode(input, 0, whole, size, input.size(), bufferSize);
+      std::vector<uint8_t> split;
+      decoder.Reset();
+      Decode(input, 0, split, size, Random(1, 20), Random(1, 20));
+      CHECK(whole == split);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    std::printf("Usage : %s DIRECTORY (the output of dfu-streams.py)\n", argv[0]);
+    return 1;
+  }
+  const auto streams = HostTest::ReadStreams(argv[1]);
+  CHECK(!streams.empty());
+
+  TestStreams(streams);
+  TestRandomInput();
+
+  std::printf("HeatshrinkDecoder : %zu streams, %d failures\n", streams.size(), HostTest::Failures());
+  return (HostTest::Failures() == 0) ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+// The fill and blend callbacks of the display driver compared with the software rendering of LVGL : a plain fill of
+// the area, and lv_color_mix() applied on each pixel. The intrinsics of the Cortex-M4 are the portable ones of
+// tools/host-stubs/nrf.h.
+
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "Check.h"
+#include "displayapp/LittleVglGpu.h"
+
+namespace LittleVglGpu = Pinetime::Components::LittleVglGpu;
+
+namespace {
+  constexpr lv_coord_t maxWidth = 240;
+
+  std::mt19937 random {1};
+  lv_disp_drv_t displayDriver;
+
+  size_t Random(size_t min, size_t max) {
+    return std::uniform_int_distribution<size_t> {min, max}(random);
+  }
+
+  lv_color_t RandomColor() {
+    lv_color_t color;
+    color.full = static_cast<uint16_t>(random());
+    return color;
+  }
+
+  std::vector<uint16_t> RandomPixels(size_t size) {
+    std::vector<uint16_t> pixels(size);
+    for (auto& pixel : pixels) {
+      pixel = static_cast<uint16_t>(random());
+    }
+    return pixels;
+  }
+
+  // The buffers are word aligned : pixels are skipped at their start to test the unaligned ones
+  lv_color_t* Pixels(std::vector<uint16_t>& pixels, size_t skipped) {
+    return reinterpret_cast<lv_color_t*>(pixels.data()) + skipped;
+  }
+
+  void TestFill() {
+    for (int run = 0; run < 20000; run++) {
+      const lv_coord_t width = Random(1, maxWidth);
+      const lv_coord_t height = Random(1, 10);
+      const size_t skipped = Random(0, 1);
+      auto buffer = RandomPixels(skipped + width * height);
+      auto expected = buffer;
+
+      lv_area_t area;
+      area.x1 = Random(0, width - 1);
+      area.x2 = Random(area.x1, width - 1);
+      area.y1 = Random(0, height - 1);
+      area.y2 = Random(area.y1, height - 1);
+      const lv_color_t color = RandomColor();
+
+      for (lv_coord_t y = area.y1; y <= area.y2; y++) {
+        for (lv_coord_t x = area.x1; x <= area.x2; x++) {
+          Pixels(expected, skipped)[y * width + x] = color;
+        }
+      }
+      LittleVglGpu::Fill(&displayDriver, Pixels(buffer, skipped), width, &area, color);
+      // Nothing is written outside of the area
+      CHECK(buffer == expected);
+    }
+  }
+
+  void TestBlend() {
+    for (int run = 0; run < 20000; run++) {
+      const uint32_t length = (run < 100) ? run : Random(0, maxWidth);
+      const size_t destSkipped = Random(0, 1);
+      const size_t srcSkipped = Random(0, 1);
+      const auto opa = static_cast<lv_opa_t>(Random(0, 255));
+      auto dest = RandomPixels(destSkipped + length + 2);
+      auto src = RandomPixels(srcSkipped + length);
+      auto expected = dest;
+
+      for (uint32_t i = 0; i < length; i++) {
+        Pixels(expected, destSkipped)[i] = lv_color_mix(Pixels(src, srcSkipped)[i], Pixels(expected, destSkipped)[i], opa);
+      }
+      LittleVglGpu::Blend(&displayDriver, Pixels(dest, destSkipped), Pixels(src, srcSkipped), length, opa);
+      CHECK(dest == expected);
+    }
+  }
+
+  // Every pair of values of each component, for every opacity : the bits of the index give the components of the
+  // source and destination pixels, and each pair of values of a component appears once
+  void TestAllComponents() {
+    constexpr size_t nbPixels = 4096;
+    std::vector<uint16_t> src(nbPixels);
+    std::vector<uint16_t> dest(nbPixels);
+    for (size_t i = 0; i < nbPixels; i++) {
+      lv_color_t& s = Pixels(src, 0)[i];
+      lv_color_t& d = Pixels(dest, 0)[i];
+      LV_COLOR_SET_R(s, (i >> 2) & 0x1f);
+      LV_COLOR_SET_R(d, (i >> 7) & 0x1f);
+      LV_COLOR_SET_G(s, i & 0x3f);
+      LV_COLOR_SET_G(d, (i >> 6) & 0x3f);
+      LV_COLOR_SET_B(s, (i >> 7) & 0x1f);
+      LV_COLOR_SET_B(d, i & 0x1f);
+    }
+
+    for (int opa = 0; opa <= 255; opa++) {
+      auto blended = dest;
+      LittleVglGpu::Blend(&displayDriver, Pixels(blended, 0), Pixels(src, 0), nbPixels, static_cast<lv_opa_t>(opa));
+      size_t differences = 0;
+      for (size_t i = 0; i < nbPixels; i++) {
+        if (Pixels(blended, 0)[i].full != lv_color_mix(Pixels(src, 0)[i], Pixels(dest, 0)[i], opa).full) {
+          differences++;
+        }
+      }
+      CHECK(differences == 0);
+    }
+  }
+}
+
+int main() {
+  TestFill();
+  TestBlend();
+  TestAllComponents();
+
+  std::printf("LittleVglGpu : %d failures\n", HostTest::Failures());
+  return (HostTest::Failures() == 0) ? 0 : 1;
+}
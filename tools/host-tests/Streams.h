@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// The compressed streams and the patches made by dfu-streams.py with the functions of tools/dfu-compress.py
+namespace HostTest {
+  struct Stream {
+    bool delta;
+    // Empty for a compressed stream
+    std::vector<uint8_t> running;
+    std::vector<uint8_t> image;
+    std::vector<uint8_t> stream;
+    // The decompressed stream : the image, or the patch
+    std::vector<uint8_t> decompressed;
+    // Offsets in the compressed stream of the blocks of the image
+    std::vector<size_t> blockOffsets;
+  };
+
+  inline std::vector<uint8_t> ReadFile(const std::string& path) {
+    std::ifstream file {path, std::ios::binary};
+    return {std::istreambuf_iterator<char> {file}, std::istreambuf_iterator<char> {}};
+  }
+
+  inline std::vector<Stream> ReadStreams(const std::string& directory) {
+    std::vector<Stream> streams;
+    std::ifstream list {directory + "/streams.txt"};
+    std::string line;
+    while (std::getline(list, line)) {
+      std::istringstream fields {line};
+      std::string type, name;
+      Stream stream;
+      fields >> type;
+      stream.delta = (type == "delta");
+      if (stream.delta) {
+        fields >> name;
+        stream.running = ReadFile(directory + "/" + name);
+      }
+      fields >> name;
+      stream.image = ReadFile(directory + "/" + name);
+      fields >> name;
+      stream.stream = ReadFile(directory + "/" + name);
+      if (stream.delta) {
+        fields >> name;
+        stream.decompressed = ReadFile(directory + "/" + name);
+      } else {
+        stream.decompressed = stream.image;
+      }
+      size_t offset;
+      while (fields >> offset) {
+        stream.blockOffsets.push_back(offset);
+      }
+      streams.push_back(std::move(stream));
+    }
+    return streams;
+  }
+}
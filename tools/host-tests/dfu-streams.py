@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+
+# Makes the inputs of the tests of the compressed and delta transfers with the functions of tools/dfu-compress.py :
+# images that look like code (a few sequences repeated with changes), their compressed streams, and patches between
+# versions of an image. The list of the files is written to streams.txt :
+#   compressed IMAGE STREAM OFFSET...   the offsets in the stream of the blocks of the image
+#   delta RUNNING IMAGE STREAM PATCH
+
+import importlib.util
+import os
+import random
+import sys
+
+spec = importlib.util.spec_from_file_location('dfu_compress',
+                                              os.path.join(os.path.dirname(__file__), '..', 'dfu-compress.py'))
+dfu_compress = importlib.util.module_from_spec(spec)
+spec.loader.exec_module(dfu_compress)
+
+
+def make_image(size):
+    sequences = [bytes(random.getrandbits(8) for _ in range(random.randint(4, 32))) for _ in range(64)]
+    image = bytearray()
+    while len(image) < size:
+        sequence = bytearray(random.choice(sequences))
+        if random.random() < 0.3:
+            sequence[random.randrange(len(sequence))] = random.getrandbits(8)
+        image += sequence
+    return bytes(image[:size])
+
+
+def make_version(running):
+    # Functions added, removed and changed : the code after them moves, and the addresses in it change
+    image = bytearray()
+    position = 0
+    while position < len(running):
+        length = random.randint(1, 20000)
+        piece = bytearray(running[position:position + length])
+        change = random.random()
+        if change < 0.2:
+            for _ in range(random.randint(1, 10)):
+                index = random.randrange(len(piece))
+                piece[index] = (piece[index] + random.randint(1, 4)) & 0xff
+        elif change < 0.3:
+            piece = make_image(random.randint(1, 2000)) + piece
+        elif change < 0.4:
+            piece = piece[random.randint(0, len(piece)):]
+        image += piece
+        position += length
+    return bytes(image)
+
+
+def write(directory, name, data):
+    with open(os.path.join(directory, name), 'wb') as f:
+        f.write(data)
+    return name
+
+
+def compressed(directory, index, image):
+    offsets = []
+    stream = bytearray()
+    for start in range(0, len(image), dfu_compress.BLOCK_SIZE):
+        offsets.append(len(stream))
+        stream += dfu_compress.compress_block(image[start:start + dfu_compress.BLOCK_SIZE])
+    files = [write(directory, f'compressed-{index}.bin', image), write(directory, f'compressed-{index}.hs', stream)]
+    return ' '.join(['compressed'] + files + [str(offset) for offset in offsets])
+
+
+def delta(directory, index, running, image):
+    patch = dfu_compress.make_patch(running, image)
+    files = [write(directory, f'delta-{index}.running', running), write(directory, f'delta-{index}.bin', image),
+             write(directory, f'delta-{index}.hs', dfu_compress.compress_block(patch)),
+             write(directory, f'delta-{index}.patch', patch)]
+    return ' '.join(['delta'] + files)
+
+
+def main():
+    directory = sys.argv[1]
+    os.makedirs(directory, exist_ok=True)
+    random.seed(1)
+    lines = []
+
+    # Less than a block, exactly a block, and blocks with a shorter last one
+    for index, size in enumerate([1, 100, 4096, 4097, 20000, 65536, 150001]):
+        lines.append(compressed(directory, index, make_image(size)))
+    # Data that can't be compressed
+    lines.append(compressed(directory, len(lines), bytes(random.getrandbits(8) for _ in range(30000))))
+
+    for index in range(6):
+        running = make_image(random.randint(20000, 150000))
+        lines.append(delta(directory, index, running, make_version(running)))
+    # The same image, and an image that has nothing in common with the running one
+    running = make_image(50000)
+    lines.append(delta(directory, 6, running, running))
+    lines.append(delta(directory, 7, running, make_image(40000)))
+
+    with open(os.path.join(directory, 'streams.txt'), 'w') as f:
+        f.write('\n'.join(lines) + '\n')
+
+
+if __name__ == '__main__':
+    main()
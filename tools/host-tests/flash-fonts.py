@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+
+# Makes the inputs of the FlashFont test : random fonts in the binary format of lv_font_conv, with every option of
+# the format (bits per pixel, sizes of the fields, formats of the cmaps, of the loca table and of the kerning), and
+# the descriptions and the bitmaps LVGL expects for their glyphs. The list of the files is written to fonts.txt :
+#   FONT EXPECTED VARIANT VARIANT_EXPECTED
+# The variant of a font has the same size, other glyph positions and other bitmaps.
+#
+# An expected file starts with the line height and the base line of the font, followed by a line per glyph :
+#   LETTER NEXT ADV_W BOX_W BOX_H OFS_X OFS_Y BITMAP    the bitmap in hexadecimal, '.' if it's empty
+#   LETTER NEXT -                                       the font has no glyph for LETTER
+
+import os
+import random
+import struct
+import sys
+
+
+def pack_bits(fields):
+    # The fields of a glyph are packed MSB first, and its bitmap is padded to a byte
+    bits = ''.join(format(value & ((1 << size) - 1), f'0{size}b') for value, size in fields if size)
+    bits += '0' * (-len(bits) % 8)
+    return bytes(int(bits[i:i + 8], 2) for i in range(0, len(bits), 8))
+
+
+def table(name, data):
+    data += b'\0' * (-len(data) % 4)
+    return struct.pack('<I', 8 + len(data)) + name + data
+
+
+class Font:
+    def __init__(self):
+        self.bpp = random.choice([1, 2, 4, 8])
+        self.xy_bits = random.randint(3, 7)
+        self.wh_bits = random.randint(3, 7)
+        self.advance_bits = random.choice([0, 6, 9, 12])
+        self.advance_format = random.choice([0, 1])
+        self.loca_format = random.choice([0, 1])
+        self.glyph_id_format = random.choice([0, 1])
+        self.kern_format = random.choice([None, 0, 3])
+        self.kerning_scale = random.choice([8, 16, 20])
+        self.default_advance = random.randint(1, 30)
+        self.ascent = random.randint(5, 100)
+        self.descent = -random.randint(0, 30)
+
+        # A range of ASCII, and sparse code points
+        self.ascii = list(range(0x20, 0x20 + random.randint(3, 40)))
+        self.sparse = sorted(random.sample(range(0x100, 0x400), random.randint(1, 30)))
+        self.codes = self.ascii + self.sparse
+        self.ids = {code: index + 1 for index, code in enumerate(self.codes)}
+        count = len(self.codes) + 1
+
+        self.glyphs = []
+        for _ in self.codes:
+            width = random.randint(0, (1 << self.wh_bits) - 1) if random.random() > 0.1 else 0
+            height = random.randint(0, (1 << self.wh_bits) - 1)
+            if width * height * self.bpp > 8 * 1500:
+                width = height = 10
+            self.glyphs.append([0, 0, 0, width, height, None])
+        self.new_glyphs()
+
+        self.cmap_formats = (random.choice([0, 2]), random.choice([1, 3]))
+        self.kerning = {}
+        if self.kern_format == 0:
+            self.pairs = sorted(set((random.randint(1, count - 1), random.randint(1, count - 1)) for _ in range(60)))
+            self.pair_values = [random.randint(-128, 127) for _ in self.pairs]
+            self.kerning = dict(zip(self.pairs, self.pair_values))
+        elif self.kern_format == 3:
+            rows, columns = random.randint(1, 5), random.randint(1, 5)
+            self.classes = (rows, columns, [random.randint(0, rows) for _ in range(count)],
+                            [random.randint(0, columns) for _ in range(count)])
+            self.class_values = [random.randint(-128, 127) for _ in range(rows * columns)]
+            left, right = self.classes[2], self.classes[3]
+            for a in range(count):
+                for b in range(count):
+                    if left[a] and right[b]:
+                        self.kerning[(a, b)] = self.class_values[(left[a] - 1) * columns + right[b] - 1]
+
+    def new_glyphs(self):
+        # The sizes of the glyphs don't change : the size of the file is the same
+        limit = 1 << (self.xy_bits - 1)
+        for glyph in self.glyphs:
+            glyph[0] = random.randint(0, (1 << self.advance_bits) - 1) if self.advance_bits else self.default_advance
+            glyph[1] = random.randint(-limit, limit - 1)
+            glyph[2] = random.randint(-limit, limit - 1)
+            glyph[5] = [random.randint(0, (1 << self.bpp) - 1) for _ in range(glyph[3] * glyph[4])]
+
+    def bitmap(self, glyph):
+        return pack_bits([(pixel, self.bpp) for pixel in glyph[5]])
+
+    def binary(self, compression=0):
+        glyf = bytearray(b'\0')
+        offsets = [8]
+        for advance, x, y, width, height, pixels in self.glyphs:
+            offsets.append(8 + len(glyf))
+            glyf += pack_bits([(advance, self.advance_bits), (x, self.xy_bits), (y, self.xy_bits),
+                               (width, self.wh_bits), (height, self.wh_bits)] + [(p, self.bpp) for p in pixels])
+        loca = struct.pack('<I', len(offsets)) + b''.join(
+            struct.pack('<H' if self.loca_format == 0 else '<I', offset) for offset in offsets)
+
+        # The ASCII range as a tiny or a full format 0 or 2 subtable, the sparse code points as format 1 or 3
+        subtables = []
+        if self.cmap_formats[0] == 2:
+            subtables.append((self.ascii[0], len(self.ascii), 1, 0, 2, b''))
+        else:
+            subtables.append((self.ascii[0], len(self.ascii), 1, len(self.ascii), 0, bytes(range(len(self.ascii)))))
+        data = b''.join(struct.pack('<H', code - self.sparse[0]) for code in self.sparse)
+        if self.cmap_formats[1] == 1:
+            data += b''.join(struct.pack('<H', index) for index in range(len(self.sparse)))
+        subtables.append((self.sparse[0], self.sparse[-1] - self.sparse[0], 1 + len(self.ascii), len(self.sparse),
+                          self.cmap_formats[1], data))
+        headers = b''
+        datas = b''
+        for start, length, glyph_id, entries, format, data in subtables:
+            offset = 12 + 16 * len(subtables) + len(datas) if data else 0
+            headers += struct.pack('<IIHHHBB', offset, start, length, glyph_id, entries, format, 0)
+            datas += data + b'\0' * (-len(data) % 4)
+        cmap = struct.pack('<I', len(subtables)) + headers + datas
+
+        kern = b''
+        if self.kern_format == 0:
+            id_format = 'B' if self.glyph_id_format == 0 else 'H'
+            kern = table(b'kern', struct.pack('<BBBBI', 0, 0, 0, 0, len(self.pairs)) +
+                         b''.join(struct.pack('<' + id_format * 2, *pair) for pair in self.pairs) +
+                         struct.pack(f'<{len(self.pair_values)}b', *self.pair_values))
+        elif self.kern_format == 3:
+            rows, columns, left, right = self.classes
+            kern = table(b'kern', struct.pack('<BBBBHBB', 3, 0, 0, 0, len(left), rows, columns) + bytes(left) +
+                         bytes(right) + struct.pack(f'<{len(self.class_values)}b', *self.class_values))
+
+        head = struct.pack('<IHHHhHhHhhHHBBBBBBBBBBhH', 1, 4 if kern else 3, 20, self.ascent, self.descent,
+                           self.ascent, self.descent, 0, self.descent, self.ascent, self.default_advance,
+                           self.kerning_scale, self.loca_format, self.glyph_id_format, self.advance_format, self.bpp,
+                           self.xy_bits, self.wh_bits, self.advance_bits, compression, 0, 0, -2, 1)
+        return table(b'head', head) + table(b'cmap', cmap) + table(b'loca', loca) + table(b'glyf', bytes(glyf)) + kern
+
+    def expected(self):
+        lines = [f'{self.ascent - self.descent} {-self.descent}']
+        # Letters that aren't in the font too
+        letters = self.codes + [0x1f, 0x500]
+        for _ in range(400):
+            letter = random.choice(letters)
+            next = random.choice(letters + [0])
+            if letter not in self.ids:
+                lines.append(f'{letter} {next} -')
+                continue
+            glyph = self.glyphs[self.ids[letter] - 1]
+            advance, x, y, width, height, _ = glyph
+            advance = advance * 16 if self.advance_format == 0 else advance
+            kerning = self.kerning.get((self.ids[letter], self.ids[next]), 0) if next in self.ids else 0
+            # Same rounding as lv_font_get_glyph_dsc_fmt_txt()
+            advance_width = (advance + ((kerning * self.kerning_scale) >> 4) + 8) >> 4
+            lines.append(f'{letter} {next} {advance_width} {width} {height} {x} {y} {self.bitmap(glyph).hex() or "."}')
+        return '\n'.join(lines) + '\n'
+
+
+def write(directory, name, data):
+    with open(os.path.join(directory, name), 'wb' if isinstance(data, bytes) else 'w') as f:
+        f.write(data)
+    return name
+
+
+def main():
+    directory = sys.argv[1]
+    os.makedirs(directory, exist_ok=True)
+    random.seed(1)
+    lines = []
+    for index in range(100):
+        font = Font()
+        files = [write(directory, f'font-{index}.bin', font.binary()),
+                 write(directory, f'font-{index}.txt', font.expected())]
+        font.new_glyphs()
+        files += [write(directory, f'font-{index}-variant.bin', font.binary()),
+                  write(directory, f'font-{index}-variant.txt', font.expected())]
+        lines.append(' '.join(files))
+    # Loaded by lv_font_load()
+    write(directory, 'compressed.bin', Font().binary(compression=1))
+
+    with open(os.path.join(directory, 'fonts.txt'), 'w') as f:
+        f.write('\n'.join(lines) + '\n')
+
+
+if __name__ == '__main__':
+    main()